@@ -0,0 +1,70 @@
+#include "benchmarkUtils.h"
+#include <concurrentAllocator.h>
+#include <slabAllocator.h>
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using babycpp::memory::ConcurrentSlabAllocator;
+using babycpp::memory::SlabAllocator;
+using babycpp::memory::ThreadLocalSlabAllocator;
+
+// every thread does the same amount of work, so with perfect scaling the
+// time per allocation divides by the thread count
+static const uint32_t ALLOCATIONS_PER_THREAD = 1 << 20;
+static const int RUNS = 5;
+// a mix of the sizes of the AST nodes
+static const uint32_t SIZES[] = {16, 24, 32, 48, 64, 40, 56, 24};
+
+// what sharing the single threaded allocator would require
+struct LockedSlabAllocator {
+  void *alloc(uint32_t byteSize, uint32_t alignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocator.alloc(byteSize, alignment);
+  }
+  void clear() { allocator.clear(); }
+  std::mutex mutex;
+  SlabAllocator allocator;
+};
+
+template <typename T> void allocate(T *allocator) {
+  void *last = nullptr;
+  for (uint32_t i = 0; i < ALLOCATIONS_PER_THREAD; ++i) {
+    last = allocator->alloc(SIZES[i & 7], 8);
+  }
+  babycpp::benchmark::doNotOptimize(last);
+}
+
+template <typename T>
+void benchmarkAllocator(const std::string &name, T *allocator,
+                        uint32_t threadCount) {
+  double best = babycpp::benchmark::bestOf(RUNS, [&]() {
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < threadCount; ++t) {
+      threads.emplace_back([allocator]() { allocate(allocator); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    allocator->clear();
+  });
+  babycpp::benchmark::report(name + " x" + std::to_string(threadCount), best,
+                             ALLOCATIONS_PER_THREAD *
+                                 static_cast<uint64_t>(threadCount));
+}
+
+int main() {
+  const uint32_t maxThreads =
+      std::max(1u, std::min(16u, std::thread::hardware_concurrency()));
+  for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+    LockedSlabAllocator locked;
+    benchmarkAllocator("locked slab allocator", &locked, threads);
+    ThreadLocalSlabAllocator threadLocal;
+    benchmarkAllocator("thread local slab allocator", &threadLocal, threads);
+    ConcurrentSlabAllocator concurrent;
+    benchmarkAllocator("concurrent slab allocator", &concurrent, threads);
+  }
+  return 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace babycpp {
+namespace benchmark {
+
+/**
+ * @brief runs the given function a number of times and returns the best
+ * run, in nanoseconds, taking the minimum filters most of the noise coming
+ * from the rest of the system
+ * @param runs: how many times to run the function
+ * @param func: function to time
+ * @return fastest run in nanoseconds
+ */
+template <typename F> double bestOf(int runs, F &&func) {
+  double best = 0.0;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    double elapsed =
+        std::chrono::duration<double, std::nano>(end - start).count();
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+/** @brief prints a single result line, time is divided by the item count */
+inline void report(const std::string &name, double nanoseconds,
+                   uint64_t items) {
+  std::cout << std::left << std::setw(40) << name << std::right
+            << std::setw(12) << std::fixed << std::setprecision(2)
+            << nanoseconds / static_cast<double>(items) << " ns/item"
+            << std::endl;
+}
+
+/** @brief keeps the compiler from optimizing away the benchmarked work */
+template <typename T> inline void doNotOptimize(T const &value) {
+#ifdef _MSC_VER
+  // no inline assembly on msvc x64, reading the sink back keeps the store
+  static volatile T sink;
+  sink = value;
+  (void)sink;
+#else
+  // the empty asm claims to read the value and to touch any memory
+  asm volatile("" : : "g"(&value) : "memory");
+#endif
+}
+
+} // namespace benchmark
+} // namespace babycpp
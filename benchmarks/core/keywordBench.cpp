@@ -0,0 +1,62 @@
+#include "benchmarkUtils.h"
+#include <lexer.h>
+
+#include <vector>
+
+using babycpp::lexer::KEYWORDS;
+using babycpp::lexer::Lexer;
+using babycpp::lexer::Token;
+
+// representative chunk of source, repeated to get a decent amount of tokens
+static const char *SOURCE =
+    "extern float sin(float x);\n"
+    "float* avg(float* data, int count)\n"
+    "{ float res = 0.0; for(int i = 0; i < count; i = i+1)\n"
+    "  { res = res + *data; data = data + 1;}\n return res / count; }\n"
+    "int foo(int a, int b){ if (a < b) { return a; } else { return b; } }\n"
+    "void* ptr = nullptr;\n";
+static const int SOURCE_REPEAT = 200;
+static const int RUNS = 20;
+
+int main() {
+  // collecting the slices the lexer feeds to the keyword check, which are
+  // all the identifiers, keywords and punctuations
+  std::string source;
+  for (int i = 0; i < SOURCE_REPEAT; ++i) {
+    source += SOURCE;
+  }
+  babycpp::diagnostic::Diagnostic diagnostic;
+  Lexer lex(&diagnostic);
+  lex.initFromString(source);
+  std::vector<llvm::StringRef> slices;
+  lex.gettok();
+  while (lex.currtok != Token::tok_eof && lex.currtok != Token::tok_no_match) {
+    if (lex.currtok != Token::tok_number) {
+      slices.push_back(lex.identifierStr);
+    }
+    lex.gettok();
+  }
+  std::cout << "keyword check over " << slices.size() << " tokens"
+            << std::endl;
+
+  double mapTime = babycpp::benchmark::bestOf(RUNS, [&]() {
+    int acc = 0;
+    for (auto slice : slices) {
+      auto iter = KEYWORDS.find(slice.str());
+      acc += iter != KEYWORDS.end() ? iter->second : Token::tok_no_match;
+    }
+    babycpp::benchmark::doNotOptimize(acc);
+  });
+  double hashTime = babycpp::benchmark::bestOf(RUNS, [&]() {
+    int acc = 0;
+    for (auto slice : slices) {
+      acc += babycpp::lexer::lookupKeyword(slice);
+    }
+    babycpp::benchmark::doNotOptimize(acc);
+  });
+
+  babycpp::benchmark::report("unordered_map KEYWORDS", mapTime, slices.size());
+  babycpp::benchmark::report("lookupKeyword perfect hash", hashTime,
+                             slices.size());
+  return 0;
+}
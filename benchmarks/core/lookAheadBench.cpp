@@ -0,0 +1,147 @@
+#include "benchmarkUtils.h"
+#include <lexer.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <vector>
+
+using babycpp::lexer::Lexer;
+using babycpp::lexer::MovableToken;
+using babycpp::lexer::Token;
+
+// counting every allocation the process does, the benchmark only reads the
+// counter around the measured loops
+static std::atomic<uint64_t> ALLOCATIONS{0};
+
+void *operator new(std::size_t size) {
+  ALLOCATIONS.fetch_add(1, std::memory_order_relaxed);
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+// a selection of the inputs used in parser_tests
+static const char *INPUTS[] = {
+    "float avg(float x){ return x *2.0;}",
+    "float meaningOfLife = computeMeaningOfLife(me);",
+    "float testFunc(float* a){ float res = *a;return res;}",
+    "float* testFunc(float* a){ float* res = a; return res;}",
+    "for ( int i = 0; i < 20 ; i= i+1){ x = x + i;} ",
+    "if ( 3 + 1) { int x = 1 +1 ;}else{ int x = 2 + 2;}",
+    " int* ptr = (int*) malloc(20);",
+    " void* ptr = (void*)floatPtr;",
+    "newFunction ( x,  y124, minusGravity )",
+    "x + 2.0 * (y+z)",
+    "int* myPtr = nullptr;",
+    " *myPtr = 20;",
+};
+static const int REPEAT = 2000;
+static const int RUNS = 10;
+// the parser looks ahead of at most three tokens
+static const int LOOK_AHEAD = 3;
+
+// replica of the previous look ahead, a temporary vector per call and
+// a deque the tokens get copied in and out of
+struct DequeLookAhead {
+  explicit DequeLookAhead(Lexer *inlex) : lex(inlex) {}
+  Lexer *lex;
+  std::deque<MovableToken> queue;
+
+  void gettok() {
+    if (!queue.empty()) {
+      const MovableToken &mov = queue.front();
+      lex->currtok = mov.token;
+      lex->identifierStr = mov.identifierStr;
+      lex->value = mov.value;
+      queue.pop_front();
+      return;
+    }
+    lex->gettok();
+  }
+  bool lookAhead(int count) {
+    int oldTok = lex->currtok;
+    std::vector<MovableToken> tempBuffer;
+    tempBuffer.reserve(count);
+    for (int t = 0; t < count; ++t) {
+      gettok();
+      if (lex->currtok == Token::tok_eof || lex->currtok == Token::tok_no_match) {
+        return false;
+      }
+      tempBuffer.emplace_back(MovableToken{lex->currtok, lex->identifierStr,
+                                           lex->identifierId, lex->value,
+                                           lex->lineNumber, lex->columnNumber});
+    }
+    for (int t = 0; t < count; ++t) {
+      queue.push_back(tempBuffer[t]);
+    }
+    lex->currtok = oldTok;
+    return true;
+  }
+};
+
+// the parser pattern, look ahead before consuming a token
+template <typename L> int walk(L &lexer, Lexer &lex) {
+  int acc = 0;
+  lexer.gettok();
+  while (lex.currtok != Token::tok_eof && lex.currtok != Token::tok_no_match) {
+    lexer.lookAhead(LOOK_AHEAD);
+    acc += lex.currtok;
+    lexer.gettok();
+  }
+  return acc;
+}
+
+struct RingLookAhead {
+  Lexer *lex;
+  void gettok() { lex->gettok(); }
+  bool lookAhead(int count) { return lex->lookAhead(count); }
+};
+
+template <typename L>
+void run(const char *name, std::vector<Lexer> &lexers, uint64_t tokens) {
+  uint64_t allocationsBefore = ALLOCATIONS.load();
+  double time = babycpp::benchmark::bestOf(RUNS, [&]() {
+    int acc = 0;
+    for (int r = 0; r < REPEAT; ++r) {
+      for (size_t i = 0; i < lexers.size(); ++i) {
+        lexers[i].initFromString(INPUTS[i]);
+        L wrapper{&lexers[i]};
+        acc += walk(wrapper, lexers[i]);
+      }
+    }
+    babycpp::benchmark::doNotOptimize(acc);
+  });
+  uint64_t allocations = ALLOCATIONS.load() - allocationsBefore;
+  babycpp::benchmark::report(name, time, tokens);
+  std::cout << "    allocations per run: " << allocations / RUNS << std::endl;
+}
+
+int main() {
+  babycpp::diagnostic::Diagnostic diagnostic;
+  std::vector<Lexer> lexers;
+  uint64_t tokens = 0;
+  for (const char *input : INPUTS) {
+    lexers.emplace_back(&diagnostic);
+    Lexer &lex = lexers.back();
+    lex.initFromString(input);
+    lex.gettok();
+    while (lex.currtok != Token::tok_eof &&
+           lex.currtok != Token::tok_no_match) {
+      ++tokens;
+      lex.gettok();
+    }
+  }
+  tokens *= REPEAT;
+  std::cout << "look ahead of " << LOOK_AHEAD << " over " << tokens
+            << " tokens" << std::endl;
+  // the initFromString copy is paid by both, so is the allocation count
+  run<DequeLookAhead>("deque look ahead", lexers, tokens);
+  run<RingLookAhead>("ring buffer look ahead", lexers, tokens);
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include "benchmarkUtils.h"
+#include <codegen.h>
+
+#include <string>
+
+using babycpp::codegen::Codegenerator;
+using babycpp::codegen::OptLevel;
+
+static const int FUNCTION_COUNT = 200;
+static const int RUNS = 3;
+
+// small helpers called by loop kernels, so inlining has something to do
+static std::string generateSource() {
+  std::string source;
+  for (int i = 0; i < FUNCTION_COUNT; ++i) {
+    const std::string id = std::to_string(i);
+    source += "float scale" + id + "(float x){ return x * 0.5 + 1.0;}\n";
+    source += "float kernel" + id +
+              "(float x, float y){ float res = 0.0;"
+              " for(int i = 0; i < 16; i = i + 1){"
+              " res = res + scale" + id + "(x) * y; x = x * 0.5;}"
+              " return res / 3.0;}\n";
+  }
+  return source;
+}
+
+int main() {
+  const std::string source = generateSource();
+  std::cout << "generating and optimizing " << 2 * FUNCTION_COUNT
+            << " functions, time per function" << std::endl;
+
+  const OptLevel levels[] = {OptLevel::O0, OptLevel::O1, OptLevel::O2,
+                             OptLevel::O3};
+  for (OptLevel level : levels) {
+    const std::string name = "O" + std::to_string(static_cast<int>(level));
+    uint64_t instructions = 0;
+    double functionMs = 0.0;
+    double moduleMs = 0.0;
+    double best = babycpp::benchmark::bestOf(RUNS, [&]() {
+      Codegenerator gen;
+      gen.optimizer.level = level;
+      gen.initFromString(source);
+      gen.generateModuleContent();
+      gen.optimizeModule();
+      instructions = 0;
+      for (llvm::Function &function : *gen.module) {
+        for (llvm::BasicBlock &block : function) {
+          instructions += block.size();
+        }
+      }
+      functionMs = gen.optimizer.stats.functionMilliseconds;
+      moduleMs = gen.optimizer.stats.moduleMilliseconds;
+      babycpp::benchmark::doNotOptimize(instructions);
+    });
+    babycpp::benchmark::report(name + " generate + optimize", best,
+                               2 * FUNCTION_COUNT);
+    std::cout << "    function passes " << functionMs << " ms, module passes "
+              << moduleMs << " ms, " << instructions << " instructions"
+              << std::endl;
+  }
+  return 0;
+}
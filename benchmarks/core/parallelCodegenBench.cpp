@@ -0,0 +1,67 @@
+#include "benchmarkUtils.h"
+#include <codegen.h>
+#include <parallelCodegen.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+using babycpp::codegen::Codegenerator;
+using babycpp::codegen::ExprAST;
+
+static const int FUNCTION_COUNT = 5000;
+static const int RUNS = 3;
+
+// independent kernels, like a batch compile would get
+static std::string generateSource() {
+  std::string source;
+  for (int i = 0; i < FUNCTION_COUNT; ++i) {
+    source += "float kernel" + std::to_string(i) +
+              "(float x, float y){ float res = 0.0;"
+              " for(int i = 0; i < 16; i = i + 1){"
+              " res = res + x * y - 1.0; x = x * 0.5;}"
+              " return res / 3.0;}\n";
+  }
+  return source;
+}
+
+int main() {
+  const std::string source = generateSource();
+  std::cout << "generating IR for " << FUNCTION_COUNT
+            << " functions, time per function" << std::endl;
+
+  // the AST is parsed once, only the IR generation is timed
+  Codegenerator gen;
+  gen.generateModuleContentParallel(source, 1);
+  std::vector<ExprAST *> statements;
+  for (auto &worker : gen.parseWorkers) {
+    statements.insert(statements.end(), worker->statements.begin(),
+                      worker->statements.end());
+  }
+
+  double best = babycpp::benchmark::bestOf(RUNS, [&]() {
+    Codegenerator sequential;
+    // same ids of the generator that parsed the AST
+    for (uint32_t id = 0; id < gen.lexer.symbols.size(); ++id) {
+      sequential.lexer.symbols.intern(gen.lexer.symbols.getName(id));
+    }
+    for (ExprAST *statement : statements) {
+      statement->codegen(&sequential);
+    }
+    babycpp::benchmark::doNotOptimize(sequential.module->size());
+  });
+  babycpp::benchmark::report("sequential", best, FUNCTION_COUNT);
+
+  const uint32_t maxThreads =
+      std::max(1u, std::min(16u, std::thread::hardware_concurrency()));
+  for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+    best = babycpp::benchmark::bestOf(RUNS, [&]() {
+      auto workers =
+          babycpp::codegen::generateInParallel(&gen, statements, threads);
+      babycpp::benchmark::doNotOptimize(workers.size());
+    });
+    babycpp::benchmark::report("parallel x" + std::to_string(threads), best,
+                               FUNCTION_COUNT);
+  }
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include "benchmarkUtils.h"
+#include <parallelParser.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+using babycpp::parser::ParseWorker;
+using babycpp::parser::SourceRange;
+
+static const int FUNCTION_COUNT = 20000;
+static const int RUNS = 5;
+
+// many independent functions, like the scripts generated by tools
+static std::string generateSource() {
+  std::string source;
+  for (int i = 0; i < FUNCTION_COUNT; ++i) {
+    source += "float func" + std::to_string(i) +
+              "(float* data, int count){ float res = 0.0;"
+              " for(int i = 0; i < count; i = i + 1){"
+              " res = res + *data * 2.0; data = data + 1;}"
+              " if (res > 10.0){ res = 10.0;} return res / 3.0;}\n";
+  }
+  return source;
+}
+
+int main() {
+  const std::string source = generateSource();
+  std::cout << "parsing " << FUNCTION_COUNT << " functions, "
+            << source.size() / 1024 << " KB, time per function" << std::endl;
+
+  // the baseline is a single worker on the calling thread, no splitting
+  // and no symbol remapping
+  double best = babycpp::benchmark::bestOf(RUNS, [&]() {
+    ParseWorker worker;
+    worker.parse(source, SourceRange{0, static_cast<uint32_t>(source.size()),
+                                     1});
+    babycpp::benchmark::doNotOptimize(worker.statements.size());
+  });
+  babycpp::benchmark::report("sequential", best, FUNCTION_COUNT);
+
+  const uint32_t maxThreads =
+      std::max(1u, std::min(16u, std::thread::hardware_concurrency()));
+  for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+    best = babycpp::benchmark::bestOf(RUNS, [&]() {
+      babycpp::symbol::SymbolTable symbols;
+      auto workers =
+          babycpp::parser::parseInParallel(source, threads, &symbols);
+      babycpp::benchmark::doNotOptimize(workers.size());
+    });
+    babycpp::benchmark::report("parallel x" + std::to_string(threads), best,
+                               FUNCTION_COUNT);
+  }
+  return 0;
+}
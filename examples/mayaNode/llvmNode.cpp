@@ -13,6 +13,15 @@ MObject LLVMNode::code;
 
 void *LLVMNode::creator() { return new LLVMNode(); }
 
+babycpp::jit::JITOptions LLVMNode::jitOptions() {
+  // edits compile quickly at O0, the function gets optimized once the
+  // node has been evaluated for a while
+  babycpp::jit::JITOptions options;
+  options.tiered = true;
+  options.hotThreshold = 100;
+  return options;
+}
+
 MStatus LLVMNode::initialize() {
   MFnNumericAttribute numFn;
   inputA = numFn.create("inputA", "ina", MFnNumericData::kFloat);
@@ -55,14 +64,15 @@ MStatus LLVMNode::compute(const MPlug &plug, MDataBlock &dataBlock) {
     // std::cout<<"is handle empty? "<<handle
     std::cout << "code is dirty!!!!" << std::endl;
 
-    babycpp::codegen::Codegenerator gen;
-
     MString mayaCode = dataBlock.inputValue(code).asString();
     std::string codeData{mayaCode.asChar()};
     if (codeData == "") {
       return MS::kSuccess;
     }
 
+    // starting from a clean session, the memory of the previous
+    // compilation gets reused
+    gen.reset();
     gen.initFromString(codeData);
     auto p = gen.parser.parseFunction();
     if (p == nullptr) {
@@ -6,6 +6,7 @@
 #include <maya/MFnDependencyNode.h>
 #include <maya/MTypeId.h>
 #include <jit.h>
+#include <codegen.h>
 
 
 //Class
@@ -29,7 +30,11 @@ public:
 	bool initialized = false;
 	float(*customFunction)(float, float) = nullptr;
 	
-	babycpp::jit::BabycppJIT jit;
+	// reused for every compilation, reset() recycles its memory
+	babycpp::codegen::Codegenerator gen;
+	// the code is compiled at every edit and run at every evaluation
+	static babycpp::jit::JITOptions jitOptions();
+	babycpp::jit::BabycppJIT jit{jitOptions()};
 	babycpp::jit::BabycppJIT::ModuleHandle handle;
 	bool isHandle = false;
 };
\ No newline at end of file
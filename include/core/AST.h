@@ -1,7 +1,10 @@
 #pragma once
 #include "lexer.h"
+#include "slabAllocator.h"
+#include "symbolTable.h"
 #include <string>
 
+#include <llvm/ADT/StringRef.h>
 #include <llvm/IR/Value.h>
 
 namespace babycpp {
@@ -26,12 +29,18 @@ struct ASTFlags {
  * declaration
  */
 struct Argument {
-  Argument(int datatype, std::string &argName, bool inIsPointer)
-      : type(datatype), name(argName), isPointer(inIsPointer) {}
+  Argument(int datatype, llvm::StringRef argName, bool inIsPointer,
+           symbol::SymbolId inNameId = symbol::INVALID_SYMBOL)
+      : type(datatype), name(argName), isPointer(inIsPointer),
+        nameId(inNameId) {}
   /**Token datatype , like tok_int etc*/
   int type;
-  std::string name;
+  /** name of the argument, once in a prototype this is a copy living
+   * in the factory memory, see FactoryAST::copyArray */
+  llvm::StringRef name;
   bool isPointer;
+  /** interned name, used to register the argument in the scope */
+  symbol::SymbolId nameId;
 };
 
 /**
@@ -53,8 +62,46 @@ enum NodeType {
   ToPointerAssigmentNode = 10,
   CastASTNode= 11,
 };
+/** size of arrays indexed by NodeType, index 0 is unused */
+const int NODE_TYPE_COUNT = CastASTNode + 1;
+
+/** @brief human readable name of the node type, used in diagnostics */
+inline const char *getNodeTypeName(int type) {
+  switch (type) {
+  case NumberNode:
+    return "NumberExprAST";
+  case VariableNode:
+    return "VariableExprAST";
+  case BinaryNode:
+    return "BinaryExprAST";
+  case CallNode:
+    return "CallExprAST";
+  case PrototypeNode:
+    return "PrototypeAST";
+  case FunctionNode:
+    return "FunctionAST";
+  case IfNode:
+    return "IfAST";
+  case ForNode:
+    return "ForAST";
+  case DereferenceNode:
+    return "DereferenceAST";
+  case ToPointerAssigmentNode:
+    return "ToPointerAssigmentAST";
+  case CastASTNode:
+    return "CastAST";
+  default:
+    return "UnknownAST";
+  }
+}
 
 struct Codegenerator;
+struct ExprAST;
+
+/** list of children of a node, allocated by the factory together with the
+ * nodes, so no node owns heap memory and tearing down the AST is a bulk
+ * free of the slabs */
+using ExprList = memory::ArenaArray<ExprAST *>;
 
 /**
  * @brief base class for all the AST nodes
@@ -64,20 +111,25 @@ struct ExprAST {
     flags.isReturn = false;
     flags.isDefinition = false;
     flags.isPointer = false;
+    flags.isNull = false;
   };
   ExprAST(int type) : datatype(type) {
     flags.isReturn = false;
     flags.isDefinition = false;
     flags.isPointer = false;
+    flags.isNull = false;
   }
   virtual ~ExprAST() = default;
   /**
    * @brief generates IR for the given node
+   * This is not virtual, the call is dispatched on the nodetype tag to
+   * the codegen of the concrete node by a VisitorAST, see visitorAST.h,
+   * every node type defines its own codegen with the same signature
    * @param gen : pointer to the generator to use to
    *              generate the needed IR
    * @return  *val last generated instruction from the IR
    */
-  virtual llvm::Value *codegen(Codegenerator *gen) = 0;
+  llvm::Value *codegen(Codegenerator *gen);
 
   /** what datatype the node represnts, 0 it means type is
    * not known */
@@ -94,7 +146,7 @@ struct NumberExprAST : public ExprAST {
     nodetype = NumberNode;
   }
   virtual ~NumberExprAST() = default;
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 
   Number val;
 };
@@ -111,17 +163,20 @@ struct NumberExprAST : public ExprAST {
  */
 struct VariableExprAST : public ExprAST {
   /** actual name of the variable in the source code, there
-   * is no mangling */
-  std::string name;
+   * is no mangling, slice of the lexer buffer */
+  llvm::StringRef name;
   /**If not none, this value holds the value to assign to the
    * variable */
   ExprAST *value;
-  explicit VariableExprAST(const std::string &name, ExprAST *invalue, int type)
-      : ExprAST(type), name{name}, value(invalue) {
+  /** interned name, used to resolve the variable in the scope */
+  symbol::SymbolId nameId;
+  explicit VariableExprAST(llvm::StringRef name, ExprAST *invalue, int type,
+                           symbol::SymbolId inNameId = symbol::INVALID_SYMBOL)
+      : ExprAST(type), name{name}, value(invalue), nameId(inNameId) {
     nodetype = VariableNode;
   }
   virtual ~VariableExprAST() = default;
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 };
 
 /** Represents a binary expression, with a lhr,rhs and the operator */
@@ -129,50 +184,61 @@ struct BinaryExprAST : public ExprAST {
   /** one of the supported operator, it is not a char, in this way
    * we can support varying length operators like >= or similar
    * although not supported yet */
-  std::string op;
+  llvm::StringRef op;
   /**left and right side of the binary, this can be anything,
    * function call or sub expression */
   ExprAST *lhs, *rhs;
-  explicit BinaryExprAST(std::string &op, ExprAST *lhs, ExprAST *rhs)
+  explicit BinaryExprAST(llvm::StringRef op, ExprAST *lhs, ExprAST *rhs)
       : ExprAST(), op(op), lhs(lhs), rhs(rhs) {
     nodetype = BinaryNode;
   }
 
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 };
 
 /**@brief Function invocation */
 struct CallExprAST : public ExprAST {
   /** name of the function to be called, not mangled*/
-  std::string callee;
+  llvm::StringRef callee;
   /** list of arguments node*/
-  std::vector<ExprAST *> args;
+  ExprList args;
+  /** interned name of the function to be called */
+  symbol::SymbolId calleeId;
 
-  explicit CallExprAST(const std::string &callee, std::vector<ExprAST *> &args)
-      : ExprAST(), callee(callee), args(args) {
+  explicit CallExprAST(llvm::StringRef callee, ExprList args,
+                       symbol::SymbolId inCalleeId = symbol::INVALID_SYMBOL)
+      : ExprAST(), callee(callee), args(args), calleeId(inCalleeId) {
     nodetype = CallNode;
   }
   virtual ~CallExprAST() = default;
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 };
 
 /**@brief defines the signature of a function */
 struct PrototypeAST : public ExprAST {
-  /** name of the function to be called, not mangled*/
-  std::string name;
+  /** name of the function to be called, not mangled. Differently from
+   * the other nodes this is a copy in the factory memory, prototypes
+   * outlive the source buffer since they are kept around to regenerate
+   * declarations */
+  llvm::StringRef name;
   /** Array of arguments of the function can be empty*/
-  std::vector<Argument> args;
+  memory::ArenaArray<Argument> args;
   /**This bool defines wheter is a forward declarsation for a
    * c function, regular forward declaration is not supported */
   bool isExtern = false;
+  /** interned name, needed to register the prototype in the code
+   * generator, can be left invalid for prototypes never looked up */
+  symbol::SymbolId nameId;
 
-  explicit PrototypeAST(int retType, const std::string &name,
-                        const std::vector<Argument> &args, bool externProto)
-      : ExprAST(retType), name(name), args(args), isExtern(externProto) {
+  explicit PrototypeAST(int retType, llvm::StringRef name,
+                        memory::ArenaArray<Argument> args, bool externProto,
+                        symbol::SymbolId inNameId = symbol::INVALID_SYMBOL)
+      : ExprAST(retType), name(name), args(args), isExtern(externProto),
+        nameId(inNameId) {
     nodetype = PrototypeNode;
   }
   virtual ~PrototypeAST() = default;
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 };
 
 /** @brief complete function definition, with a body and
@@ -182,67 +248,75 @@ struct FunctionAST : public ExprAST {
   PrototypeAST *proto;
   /** the body is defined by a series of statment, each of them
    * has its own AST node */
-  std::vector<ExprAST *> body;
+  ExprList body;
 
-  explicit FunctionAST(PrototypeAST *inproto, std::vector<ExprAST *> &inbody)
+  explicit FunctionAST(PrototypeAST *inproto, ExprList inbody)
       : ExprAST(), proto(inproto), body(inbody) {
     nodetype = FunctionNode;
   }
   virtual ~FunctionAST() = default;
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 };
 
 struct IfAST : public ExprAST {
   ExprAST *condition;
-  std::vector<ExprAST *> ifExpr;
-  std::vector<ExprAST *> elseExpr;
-  explicit IfAST(ExprAST *inCondition, std::vector<ExprAST *> inIfExpr,
-                 std::vector<ExprAST *> inElseExpr)
+  ExprList ifExpr;
+  ExprList elseExpr;
+  explicit IfAST(ExprAST *inCondition, ExprList inIfExpr,
+                 ExprList inElseExpr)
       : ExprAST(), condition(inCondition), ifExpr(inIfExpr),
         elseExpr(inElseExpr) {
     nodetype = IfNode;
   }
   virtual ~IfAST() = default;
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 };
 
 struct ForAST : public ExprAST {
   ExprAST *initialization;
   ExprAST *condition;
   ExprAST *increment;
-  std::vector<ExprAST *> body;
+  ExprList body;
   explicit ForAST(ExprAST *inInitialization, ExprAST *inCondition,
-                  ExprAST *inIncrement, std::vector<ExprAST *> inBody)
+                  ExprAST *inIncrement, ExprList inBody)
       : ExprAST(), initialization(inInitialization), condition(inCondition),
         increment(inIncrement), body(inBody) {
     nodetype = ForNode;
   }
   virtual ~ForAST() = default;
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 };
 
 struct DereferenceAST : public ExprAST {
-  std::string identifierName;
-  explicit DereferenceAST(const std::string &inIdentifierName)
-      : ExprAST(), identifierName(inIdentifierName) {
+  llvm::StringRef identifierName;
+  symbol::SymbolId identifierId;
+  explicit DereferenceAST(
+      llvm::StringRef inIdentifierName,
+      symbol::SymbolId inIdentifierId = symbol::INVALID_SYMBOL)
+      : ExprAST(), identifierName(inIdentifierName),
+        identifierId(inIdentifierId) {
     nodetype = DereferenceNode;
     flags.isPointer = true;
   }
   virtual ~DereferenceAST() = default;
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 };
 
 struct ToPointerAssigmentAST : public ExprAST {
 
-  std::string identifierName;
+  llvm::StringRef identifierName;
   ExprAST *rhs;
-  explicit ToPointerAssigmentAST(std::string inIdentifierName, ExprAST *inRhs)
-      : ExprAST(), identifierName(inIdentifierName), rhs(inRhs) {
+  symbol::SymbolId identifierId;
+  explicit ToPointerAssigmentAST(
+      llvm::StringRef inIdentifierName, ExprAST *inRhs,
+      symbol::SymbolId inIdentifierId = symbol::INVALID_SYMBOL)
+      : ExprAST(), identifierName(inIdentifierName), rhs(inRhs),
+        identifierId(inIdentifierId) {
     nodetype = ToPointerAssigmentNode;
     flags.isPointer = true;
   }
   virtual ~ToPointerAssigmentAST() = default;
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 };
 
 struct CastAST : public ExprAST {
@@ -255,7 +329,7 @@ struct CastAST : public ExprAST {
 	datatype = inDatatype;
   }
   virtual ~CastAST() = default;
-  llvm::Value *codegen(Codegenerator *gen) override;
+  llvm::Value *codegen(Codegenerator *gen);
 };
 
 } // namespace codegen
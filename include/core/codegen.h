@@ -7,8 +7,11 @@
 #include "diagnostic.h"
 #include "factoryAST.h"
 #include "lexer.h"
+#include "optimizer.h"
+#include "parallelParser.h"
 #include "parser.h"
 
+#include <llvm/ADT/StringMap.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
@@ -40,16 +43,53 @@ struct Codegenerator {
 
   void doLoadBuiltinFunctions();
   void setCurrentModule(std::shared_ptr<llvm::Module> mod);
+  /**
+   * @brief gets the generator ready for a brand new compilation
+   * All the AST nodes are released, the slabs are kept for the next
+   * parse, diagnostic and scope maps are cleared and a fresh module is
+   * installed. The LLVMContext and the symbol table survive, so
+   * recompiling costs only the parse and the code generation.
+   * Builtin functions get loaded again if they were loaded before.
+   * WARNING: nodes and llvm values of the previous compilation must not
+   * be used after this call, the previous module is left to whoever
+   * still holds it, like a jit
+   */
+  void reset();
   /**
    * @brief initializes the lexer with the given string
    * @param str: the source code on which to peform lexical
    * analysis
+   * @param tokenizeUpFront: if true the whole source is lexed in the
+   * token buffer before parsing starts, see Lexer::tokenize()
    */
-  inline void initFromString(const std::string &str) {
+  inline void initFromString(const std::string &str,
+                             bool tokenizeUpFront = false) {
     lexer.initFromString(str);
+    if (tokenizeUpFront) {
+      lexer.tokenize();
+    }
     // getting first token so the parser is ready to go
     lexer.gettok();
   };
+  /**
+   * @brief initializes the lexer with the content of a file, the file
+   * is mapped rather than copied in memory
+   * @param path: the source file on which to peform lexical analysis
+   * @param tokenizeUpFront: if true the whole source is lexed in the
+   * token buffer before parsing starts, see Lexer::tokenize()
+   * @return whether or not the file could be opened
+   */
+  inline bool initFromFile(const std::string &path,
+                           bool tokenizeUpFront = false) {
+    if (!lexer.initFromFile(path)) {
+      return false;
+    }
+    if (tokenizeUpFront) {
+      lexer.tokenize();
+    }
+    lexer.gettok();
+    return true;
+  };
   /**@brief utility function convert llvm values to
    * a the string representation
    * @param v: the value to be printed
@@ -83,7 +123,7 @@ struct Codegenerator {
    * @return :return alloca pointer
    */
   llvm::AllocaInst *createEntryBlockAlloca(llvm::Function *function,
-                                           const std::string &varName, int type,
+                                           llvm::StringRef varName, int type,
                                            bool isPointer);
 
   /**This function takes in two datatpes and figures out the result of
@@ -129,28 +169,72 @@ struct Codegenerator {
     int isPointer;
     int isNull;
   };
-  /// map holding variable names defined in the scope
-  std::unordered_map<std::string, llvm::AllocaInst *> namedValues;
-  std::unordered_map<std::string, Datatype> variableTypes;
+  /// map holding variable defined in the scope, keyed by the symbol
+  /// interned by the lexer, so resolving a name is just an index
+  symbol::SymbolMap<llvm::AllocaInst *> namedValues;
+  symbol::SymbolMap<Datatype> variableTypes;
   /**mapping from lexer types to LLCM types*/
   static const std::unordered_map<int, int> AST_LLVM_MAP;
   /** if we are in a scope that is the fucntion representing the
    * scope, nullptr otherwise */
 
   llvm::Function *currentScope = nullptr;
+  /** whether doLoadBuiltinFunctions() has been called, used by reset() */
+  bool builtinFunctionsLoaded = false;
+  /** optimization level and pass pipelines, at O0, the default, the IR is
+   * left untouched; above it every function is optimized once generated,
+   * inlining needs the whole module, see optimizeModule() */
+  Optimizer optimizer;
+  /** @brief runs the module pipeline of the optimizer on module, meant to
+   * be called once all the top level statements have been generated
+   * @return whether or not the module has been changed
+   */
+  inline bool optimizeModule() {
+    return optimizer.optimizeModule(module.get());
+  }
 
   void generateModuleContent();
+  /**
+   * @brief same as generateModuleContent but the top level statements
+   * are parsed concurrently, see parser::parseInParallel, the code is
+   * then generated in source order on the calling thread.
+   * The AST is owned by parseWorkers until reset(), prototypes of a call
+   * can be used by the following ones
+   * @param source: the whole source to compile
+   * @param workerCount: how many threads to parse with, 0 means one per
+   * core
+   * @param parallelCodegen: if true the IR is generated concurrently as
+   * well, each thread in its own context, and then linked in module, see
+   * generateInParallel in parallelCodegen.h
+   */
+  void generateModuleContentParallel(const std::string &source,
+                                     uint32_t workerCount = 0,
+                                     bool parallelCodegen = false);
+  /** workers of the parallel parses since the last reset(), they own
+   * their AST */
+  std::vector<std::unique_ptr<parser::ParseWorker>> parseWorkers;
   /**Utility function to check wheter a function is created or
    * needs to be generated from the proto
-   * @param name : function we need to get a handle to
+   * @param id : symbol of the function we need to get a handle to
    * @return , pointer to Function, null if not found
    */
-  llvm::Function *getFunction(const std::string &name, PrototypeAST** returnProto = nullptr);
+  llvm::Function *getFunction(symbol::SymbolId id,
+                              PrototypeAST **returnProto = nullptr);
+
+  /** @brief returns the given symbol, or interns the name if the node
+   * has been built by hand and never went through the lexer
+   * @param id : symbol carried by the AST node
+   * @param name : name of the node, used only when the id is not valid
+   */
+  inline symbol::SymbolId resolveSymbol(symbol::SymbolId id,
+                                        llvm::StringRef name) {
+    return id != symbol::INVALID_SYMBOL ? id : lexer.symbols.intern(name);
+  }
 
   /** This function keeps tracks of the proto crated, so we can
    * generate the corresponding function on the fly */
-  std::unordered_map<std::string, PrototypeAST *> functionProtos;
-  std::unordered_map<std::string, PrototypeAST *> builtInFunctions;
+  symbol::SymbolMap<PrototypeAST *> functionProtos;
+  symbol::SymbolMap<PrototypeAST *> builtInFunctions;
 };
 
 inline llvm::Type *getType(int type, Codegenerator *gen,
@@ -0,0 +1,195 @@
+#pragma once
+#include "AST.h"
+#include "parser.h"
+#include "symbolTable.h"
+
+#include <llvm/ADT/ArrayRef.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace babycpp {
+namespace codegen {
+
+/**
+ * @brief reference to a node of the CompactAST
+ * 32 bit value, the top 4 bits are the NodeType of the node and the
+ * remaining 28 bits the index in the array of that node type
+ */
+using NodeRef = uint32_t;
+/** value used for missing children, like a declaration with no value */
+const NodeRef INVALID_NODE = 0xFFFFFFFF;
+
+/** @brief contiguous range in one of the shared arrays of the CompactAST */
+struct IndexRange {
+  uint32_t first;
+  uint32_t count;
+};
+
+/** @brief ASTFlags packed in a byte */
+enum CompactFlags : uint8_t {
+  FLAG_RETURN = 1,
+  FLAG_DEFINITION = 2,
+  FLAG_POINTER = 4,
+  FLAG_NULL = 8,
+};
+
+// one record type per node type, only indices, ids and plain values so
+// the arrays can be copied and serialized as raw memory
+struct CompactNumber {
+  Number val;
+  uint8_t flags;
+};
+struct CompactVariable {
+  symbol::SymbolId name;
+  NodeRef value;
+  int32_t datatype;
+  uint8_t flags;
+};
+struct CompactBinary {
+  NodeRef lhs;
+  NodeRef rhs;
+  int32_t datatype;
+  parser::BinaryOp op;
+  uint8_t flags;
+};
+struct CompactCall {
+  symbol::SymbolId callee;
+  /** range in CompactAST::children */
+  IndexRange args;
+  int32_t datatype;
+  uint8_t flags;
+};
+struct CompactArgument {
+  symbol::SymbolId name;
+  int32_t datatype;
+  bool isPointer;
+};
+struct CompactPrototype {
+  symbol::SymbolId name;
+  /** range in CompactAST::arguments */
+  IndexRange args;
+  int32_t datatype;
+  bool isExtern;
+  uint8_t flags;
+};
+struct CompactFunction {
+  NodeRef proto;
+  /** range in CompactAST::children */
+  IndexRange body;
+  uint8_t flags;
+};
+struct CompactIf {
+  NodeRef condition;
+  IndexRange ifBody;
+  IndexRange elseBody;
+  uint8_t flags;
+};
+struct CompactFor {
+  NodeRef initialization;
+  NodeRef condition;
+  NodeRef increment;
+  IndexRange body;
+  uint8_t flags;
+};
+struct CompactDereference {
+  symbol::SymbolId name;
+  int32_t datatype;
+  uint8_t flags;
+};
+struct CompactToPointerAssigment {
+  symbol::SymbolId name;
+  NodeRef rhs;
+  int32_t datatype;
+  uint8_t flags;
+};
+struct CompactCast {
+  NodeRef rhs;
+  int32_t datatype;
+  uint8_t flags;
+};
+
+/**
+ * @brief index based, structure of arrays, representation of the AST
+ * Nodes of the same type live next to each other in a typed array,
+ * children are referenced by 32 bit NodeRef and lists of children are
+ * ranges in a shared array, names are the ids of a symbol::SymbolTable.
+ * Whole program passes walk a handful of dense arrays instead of chasing
+ * pointers across slabs, and the whole AST can be serialized by dumping
+ * the arrays. It coexists with the ExprAST tree, which can be converted
+ * with addRoot()
+ */
+struct CompactAST {
+  static const uint32_t KIND_SHIFT = 28;
+  static const uint32_t INDEX_MASK = (1u << KIND_SHIFT) - 1;
+
+  static inline NodeRef makeRef(NodeType kind, uint32_t index) {
+    return (static_cast<uint32_t>(kind) << KIND_SHIFT) | index;
+  }
+  static inline NodeType kindOf(NodeRef ref) {
+    return static_cast<NodeType>(ref >> KIND_SHIFT);
+  }
+  static inline uint32_t indexOf(NodeRef ref) { return ref & INDEX_MASK; }
+
+  /**
+   * @brief converts the given tree and appends it to the roots
+   * @param node: root of the tree to convert, usually a statement
+   * @param symbols: table the names are interned in when the node does
+   * not already carry an id, ids carried by the nodes must come from it
+   * @return reference to the converted root
+   */
+  NodeRef addRoot(ExprAST *node, symbol::SymbolTable *symbols);
+
+  /** @brief list of nodes stored in the children array */
+  inline llvm::ArrayRef<NodeRef> getChildren(IndexRange range) const {
+    return llvm::ArrayRef<NodeRef>(children.data() + range.first,
+                                   range.count);
+  }
+  /** @brief arguments of a prototype */
+  inline llvm::ArrayRef<CompactArgument> getArguments(IndexRange range) const {
+    return llvm::ArrayRef<CompactArgument>(arguments.data() + range.first,
+                                           range.count);
+  }
+  /** @brief total number of nodes, over all the types */
+  uint32_t getNodeCount() const;
+
+  /**
+   * @brief writes all the arrays in the buffer, the symbol ids are
+   * written as they are, the symbol table needs to be stored separately
+   * @param buffer: output, the data is appended to it
+   */
+  void serialize(std::vector<uint8_t> *buffer) const;
+  /**
+   * @brief replaces the content with the one of a serialized buffer
+   * References and ranges are checked against the arrays and cycles are
+   * rejected, on failure the CompactAST is left empty
+   * @param data: start of the serialized data
+   * @param size: size in bytes of the data
+   * @return false if the data is not a valid serialized CompactAST
+   */
+  bool deserialize(const uint8_t *data, size_t size);
+
+  void clear();
+
+  // data
+  std::vector<CompactNumber> numbers;
+  std::vector<CompactVariable> variables;
+  std::vector<CompactBinary> binaries;
+  std::vector<CompactCall> calls;
+  std::vector<CompactPrototype> prototypes;
+  std::vector<CompactFunction> functions;
+  std::vector<CompactIf> ifs;
+  std::vector<CompactFor> fors;
+  std::vector<CompactDereference> dereferences;
+  std::vector<CompactToPointerAssigment> toPointerAssigments;
+  std::vector<CompactCast> casts;
+  /** shared storage of the children lists */
+  std::vector<NodeRef> children;
+  /** shared storage of the prototypes arguments */
+  std::vector<CompactArgument> arguments;
+  /** top level statements, in the order they have been added */
+  std::vector<NodeRef> roots;
+};
+
+} // namespace codegen
+} // namespace babycpp
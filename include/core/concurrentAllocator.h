@@ -0,0 +1,143 @@
+#pragma once
+
+#include "allocator.h"
+#include "slabAllocator.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace babycpp {
+namespace memory {
+
+/**
+ * @brief allocator giving every thread its own SlabAllocator
+ * Threads never share slabs so the allocation path is the plain single
+ * threaded bump of SlabAllocator, the only synchronization happens the
+ * first time a thread allocates, to register its arena.
+ * WARNING: clear() is not safe to call while other threads are allocating
+ */
+struct ThreadLocalSlabAllocator : Allocator {
+  /**
+   * Constructor
+   * @param slabSizeInByte size of the slabs of every thread arena
+   */
+  explicit ThreadLocalSlabAllocator(int slabSizeInByte = SLAB_SIZE);
+  void *alloc(uint32_t byteSize) override {
+    return alloc(byteSize, DEFAULT_ALIGNMENT);
+  }
+  /**
+   * Allocates the requested amount of memory from the arena of the
+   * calling thread
+   * @param byteSize the size of the requested allocation in bytes
+   * @param alignment required alignment, must be a power of two
+   * @return pointer to the start of allocated memory
+   */
+  void *alloc(uint32_t byteSize, uint32_t alignment) {
+    return getThreadArena().alloc(byteSize, alignment);
+  }
+  /**
+   * @brief clears the arenas of all the threads, arenas are kept
+   * registered so threads can keep allocating afterwards
+   */
+  void clear() override;
+  /**
+   * @brief returns the arena of the calling thread, creating it if this
+   * is the first allocation of the thread
+   */
+  SlabAllocator &getThreadArena();
+  /** @return how many threads have an arena in this allocator */
+  uint32_t getArenaCount();
+  /** @return the counters of all the thread arenas summed up */
+  AllocatorStats getStats();
+
+  virtual ~ThreadLocalSlabAllocator() = default;
+
+private:
+  struct ThreadArena {
+    std::thread::id owner;
+    std::unique_ptr<SlabAllocator> arena;
+  };
+  SlabAllocator &registerThreadArena();
+
+  // unique per instance, the thread local cache is keyed on it rather
+  // than on the address, which can be reused by a later allocator
+  const uint64_t instanceId;
+  uint32_t slabSize;
+  std::mutex arenasMutex;
+  std::vector<ThreadArena> arenas;
+};
+
+/**
+ * @brief allocator shared by many threads without locks
+ * Threads bump an atomic offset in the current slab, when a slab is full
+ * the first thread taking the refill lock installs a new one and the others
+ * retry in it, so a refill never allocates more than one slab. Slabs are
+ * never reused while allocating, they stay alive until clear() or the
+ * destruction of the allocator.
+ * WARNING: clear() is not safe to call while other threads are allocating
+ */
+struct ConcurrentSlabAllocator : Allocator {
+  /**
+   * Constructor
+   * @param slabSizeInByte how big are the slabs in bytes
+   */
+  explicit ConcurrentSlabAllocator(int slabSizeInByte = SLAB_SIZE);
+  void *alloc(uint32_t byteSize) override {
+    return alloc(byteSize, DEFAULT_ALIGNMENT);
+  }
+  /**
+   * Allocates the requested amount of memory, safe to be called
+   * concurrently
+   * @param byteSize the size of the requested allocation in bytes
+   * @param alignment required alignment, must be a power of two
+   * @return pointer to the start of allocated memory, allocations that
+   *         would not fit in a slab get a dedicated block
+   */
+  void *alloc(uint32_t byteSize, uint32_t alignment);
+  /**
+   * @brief releases all the slabs but the current one, which is reset,
+   * and all the oversized blocks
+   */
+  void clear() override;
+  /** @return number of slabs currently alive */
+  uint32_t getSlabCount() const;
+
+  virtual ~ConcurrentSlabAllocator();
+
+private:
+  /**
+   * Slab with an atomic stack pointer, slabs are chained to the one they
+   * replaced so they can all be released
+   */
+  struct ConcurrentSlab {
+    char *data;
+    char *endp;
+    std::atomic<char *> rsp;
+    ConcurrentSlab *previous;
+  };
+  /** header of the blocks allocated for oversized requests */
+  struct OversizedBlock {
+    OversizedBlock *next;
+  };
+
+  ConcurrentSlab *createSlab(ConcurrentSlab *previous);
+  static void destroySlab(ConcurrentSlab *slab);
+  /**
+   * @brief installs a new slab after full, unless another thread already
+   * did it, in which case that slab is returned
+   */
+  ConcurrentSlab *refillSlab(ConcurrentSlab *full);
+  void *allocOversized(uint32_t byteSize, uint32_t alignment);
+
+  uint32_t slabSize;
+  std::atomic<ConcurrentSlab *> currentSlab;
+  // only taken when a slab is full, the bump stays lock free
+  std::mutex refillMutex;
+  std::atomic<OversizedBlock *> oversizedBlocks;
+};
+
+} // namespace memory
+} // namespace babycpp
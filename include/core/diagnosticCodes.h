@@ -1,4 +1,5 @@
 #pragma once
+#include <string>
 #include <unordered_map>
 
 namespace babycpp {
@@ -10,6 +11,8 @@ enum class IssueCode {
   NONE = -1,
 
   // 0-999 lexer codes
+  CANNOT_OPEN_SOURCE_FILE = 0,
+  NUMBER_LITERAL_OUT_OF_RANGE = 1,
 
   // 1000-1999 parser codes
   MISSING_OPEN_ROUND_OR_COMMA_IN_FUNC_CALL = 1000,
@@ -27,6 +30,7 @@ enum class IssueCode {
   CAST_ERROR = 1012,
   ERROR_IN_VOID_DATATYPE = 1013,
   CANNOT_GENERATE_RHS = 1014,
+  EXPRESSION_TOO_DEEP = 1015,
 
   // 2000-2999 code gen codes
   ERROR_RHS_VARIABLE_ASSIGMENT = 2000,
@@ -39,6 +43,7 @@ enum class IssueCode {
   ERROR_IN_FUNCTION_BODY= 2007,
   UNKNOWN_BIN_OPERATOR= 2008,
   POINTER_ARITHMETIC_ERROR= 2009,
+  MODULE_LINK_FAILURE = 2010,
 
 };
 
@@ -56,6 +61,8 @@ static const std::unordered_map<IssueType, std::string> issueTypeLookUp{
  */
 static const std::unordered_map<IssueCode, std::string> issueCodeLookUp{
 
+    {IssueCode::CANNOT_OPEN_SOURCE_FILE, "CANNOT_OPEN_SOURCE_FILE"},
+    {IssueCode::NUMBER_LITERAL_OUT_OF_RANGE, "NUMBER_LITERAL_OUT_OF_RANGE"},
     {IssueCode::MISSING_OPEN_ROUND_OR_COMMA_IN_FUNC_CALL,
      "MISSING_OPEN_ROUND_OR_COMMA_IN_FUNC_CALL"},
     {IssueCode::MISSING_ARG_IN_FUNC_CALL, "MISSING_ARG_IN_FUNC_CALL"},
@@ -80,6 +87,7 @@ static const std::unordered_map<IssueCode, std::string> issueCodeLookUp{
     {IssueCode::CAST_ERROR, "CAST_ERROR"},
     {IssueCode::ERROR_IN_VOID_DATATYPE, "ERROR_IN_VOID_DATATYPE"},
     {IssueCode::CANNOT_GENERATE_RHS, "CANNOT_GENERATE_RHS"},
+    {IssueCode::EXPRESSION_TOO_DEEP, "EXPRESSION_TOO_DEEP"},
     {IssueCode::UNDEFINED_FUNCTION, "UNDEFINED_FUNCTION"},
     {IssueCode::WRONG_ARGUMENTS_COUNT_IN_FUNC_CALL,
      "WRONG_ARGUMENTS_COUNT_IN_FUNC_CALL"},
@@ -89,6 +97,7 @@ static const std::unordered_map<IssueCode, std::string> issueCodeLookUp{
      "UNKNOWN_BIN_OPERATOR"},
     {IssueCode::POINTER_ARITHMETIC_ERROR,
      "POINTER_ARITHMETIC_ERROR"},
+    {IssueCode::MODULE_LINK_FAILURE, "MODULE_LINK_FAILURE"},
 
 };
 
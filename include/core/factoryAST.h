@@ -1,90 +1,279 @@
 #pragma once
 
-//#include "codegen.h"
+#include "AST.h"
 #include "slabAllocator.h"
+
+#include <llvm/ADT/StringRef.h>
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace babycpp {
+namespace memory {
 
-namespace codegen {
-struct ExprAST;
-struct VariableExprAST;
-struct NumberExprAST;
-struct BinaryExprAST;
-struct CallExprAST;
-struct PrototypeAST;
-struct FunctionAST;
-struct IfAST;
-} // namespace codegen
+struct FactoryAST;
+
+// maps the arguments given to the factory to what the node constructor
+// takes, std::vector children lists the parser builds are copied in
+// the slabs, everything else is forwarded as it is
+template <typename T> struct ArenaCopy {
+  template <typename U> static U &&apply(FactoryAST *, U &&value) {
+    return std::forward<U>(value);
+  }
+};
+template <typename T> struct ArenaCopy<std::vector<T>> {
+  template <typename U>
+  static ArenaArray<T> apply(FactoryAST *factory, const U &value);
+};
+
+/**
+ * @brief structural identity of a pure expression node, children are
+ * compared by address, which is enough since they are consed themselves
+ */
+struct ConsKey {
+  int nodetype;
+  /** literal, symbol, packed operator or cast type depending on the node */
+  uint64_t value;
+  const codegen::ExprAST *lhs;
+  const codegen::ExprAST *rhs;
+
+  bool operator==(const ConsKey &other) const {
+    return nodetype == other.nodetype && value == other.value &&
+           lhs == other.lhs && rhs == other.rhs;
+  }
+};
+struct ConsKeyHash {
+  size_t operator()(const ConsKey &key) const;
+};
 
-namespace memory {
 struct FactoryAST {
 
   explicit FactoryAST() = default;
-  ~FactoryAST() {
-    for (auto *ptr : ptrs) {
-      // calling destructor explicitely since we used placement new
-      ptr->~ExprAST();
-    }
-  };
+  // nodes and their children lists only hold slices and pointers in slab
+  // memory, there is no destructor to run, the allocator frees everything
+  // in bulk
+  ~FactoryAST() = default;
 
   // in general I am not a super fan of hardcore or complex templates
   // but I decided to experiment a little with it.
   // This is the inner function, a generic function getting an arbitrary
-  // number of arguments and forwarding them to the constructor
-  template <typename T, typename... Args> T *allocASTNode(Args... args) {
-    auto *ptr = new (allocator.alloc(sizeof(T))) T(args...);
-    ptrs.push_back(ptr);
-    return ptr;
+  // number of arguments and forwarding them to the constructor. Arguments
+  // are perfectly forwarded, nodes keep slices of the strings they are
+  // given so we cannot afford a by value copy in between
+  template <typename T, typename... Args> T *allocASTNode(Args &&... args) {
+    return constructASTNode<T>(
+        ArenaCopy<typename std::decay<Args>::type>::apply(
+            this, std::forward<Args>(args))...);
+  }
+
+  /**
+   * @brief copies the given elements in a contiguous array in slab memory
+   * @param values: elements to copy, they need to be trivially copyable
+   * @return the array, empty arrays do not allocate
+   */
+  template <typename T> ArenaArray<T> copyArray(const std::vector<T> &values) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "arena arrays are released without destructors");
+    ArenaArray<T> array;
+    array.count = static_cast<uint32_t>(values.size());
+    if (array.count != 0) {
+      array.data = static_cast<T *>(
+          allocator.alloc(sizeof(T) * array.count, alignof(T)));
+      ++stats.arrayCount;
+      stats.arrayBytes += sizeof(T) * array.count;
+      memcpy(array.data, values.data(), sizeof(T) * array.count);
+    }
+    return array;
+  }
+  /**
+   * @brief copies the arguments of a prototype, names included, so that
+   * they do not depend on the source buffer anymore
+   */
+  ArenaArray<codegen::Argument>
+  copyArray(const std::vector<codegen::Argument> &values) {
+    ArenaArray<codegen::Argument> array = copyArray<codegen::Argument>(values);
+    for (auto &arg : array) {
+      arg.name = copyString(arg.name);
+    }
+    return array;
+  }
+  /** @brief copies the string in slab memory, returning the slice to it */
+  llvm::StringRef copyString(llvm::StringRef str) {
+    if (str.empty()) {
+      return llvm::StringRef();
+    }
+    auto *data = static_cast<char *>(allocator.alloc(str.size(), 1));
+    stats.stringBytes += str.size();
+    memcpy(data, str.data(), str.size());
+    return llvm::StringRef(data, str.size());
   }
 
   // generating aliases for the different nodes
   template <typename... Args>
   codegen::VariableExprAST *allocVariableAST(Args &&... args) {
-    return allocASTNode<codegen::VariableExprAST>(args...);
+    return allocASTNode<codegen::VariableExprAST>(std::forward<Args>(args)...);
   }
   template <typename... Args>
-  codegen::NumberExprAST *allocNuberAST(Args... args) {
-    return allocASTNode<codegen::NumberExprAST>(args...);
+  codegen::NumberExprAST *allocNuberAST(Args &&... args) {
+    return allocASTNode<codegen::NumberExprAST>(std::forward<Args>(args)...);
   }
   template <typename... Args>
   codegen::BinaryExprAST *allocBinaryAST(Args &&... args) {
-    return allocASTNode<codegen::BinaryExprAST>(args...);
+    return allocASTNode<codegen::BinaryExprAST>(std::forward<Args>(args)...);
   }
   template <typename... Args>
   codegen::CallExprAST *allocCallexprAST(Args &&... args) {
-    return allocASTNode<codegen::CallExprAST>(args...);
+    return allocASTNode<codegen::CallExprAST>(std::forward<Args>(args)...);
   }
-  template <typename... Args>
-  codegen::PrototypeAST *allocPrototypeAST(Args &&... args) {
-    return allocASTNode<codegen::PrototypeAST>(args...);
+  // prototypes outlive the source buffer, the name is always copied
+  codegen::PrototypeAST *
+  allocPrototypeAST(int retType, llvm::StringRef name,
+                    const std::vector<codegen::Argument> &args,
+                    bool externProto,
+                    symbol::SymbolId nameId = symbol::INVALID_SYMBOL) {
+    return allocASTNode<codegen::PrototypeAST>(
+        retType, copyString(name), copyArray(args), externProto, nameId);
   }
   template <typename... Args>
   codegen::FunctionAST *allocFunctionAST(Args &&... args) {
-    return allocASTNode<codegen::FunctionAST>(args...);
+    return allocASTNode<codegen::FunctionAST>(std::forward<Args>(args)...);
   }
   template <typename... Args> codegen::IfAST *allocIfAST(Args &&... args) {
-    return allocASTNode<codegen::IfAST>(args...);
+    return allocASTNode<codegen::IfAST>(std::forward<Args>(args)...);
   }
   template <typename... Args> codegen::ForAST *allocForAST(Args &&... args) {
-    return allocASTNode<codegen::ForAST>(args...);
+    return allocASTNode<codegen::ForAST>(std::forward<Args>(args)...);
   }
   template <typename... Args>
   codegen::DereferenceAST *allocDereferenceAST(Args &&... args) {
-    return allocASTNode<codegen::DereferenceAST>(args...);
+    return allocASTNode<codegen::DereferenceAST>(std::forward<Args>(args)...);
   }
   template <typename... Args>
   codegen::ToPointerAssigmentAST *allocToPointerAssigmentAST(Args &&... args) {
-    return allocASTNode<codegen::ToPointerAssigmentAST>(args...);
+    return allocASTNode<codegen::ToPointerAssigmentAST>(
+        std::forward<Args>(args)...);
   }
   template <typename... Args>
   codegen::CastAST*allocCastAST(Args &&... args) {
-    return allocASTNode<codegen::CastAST>(args...);
+    return allocASTNode<codegen::CastAST>(std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief counts of what the factory allocated, on top of the
+   * counters of the allocator
+   */
+  struct Stats {
+    /** nodes allocated per type, indexed by codegen::NodeType */
+    uint64_t nodeCounts[codegen::NODE_TYPE_COUNT] = {};
+    uint64_t nodeBytes[codegen::NODE_TYPE_COUNT] = {};
+    /** children lists copied in the slabs and their size */
+    uint64_t arrayCount = 0;
+    uint64_t arrayBytes = 0;
+    /** names copied in the slabs */
+    uint64_t stringBytes = 0;
+    /** nodes returned from the cons table and the bytes they saved */
+    uint64_t consHits = 0;
+    uint64_t consBytesSaved = 0;
+  };
+  // HASH CONSING
+  // The cons functions build the pure expression nodes, numbers, variable
+  // reads, non assignment binary operations and casts of pure nodes. When
+  // hashConsing is enabled a structurally identical node built before is
+  // returned instead of a new one, so repeated subexpressions become a
+  // single shared node and the tree becomes a DAG. Shared nodes must not
+  // be modified, whoever needs to, like setting the return flag or the
+  // value of an assignment, has to unshare() them first. Without
+  // hashConsing they behave exactly like the alloc functions
+
+  codegen::NumberExprAST *consNumberAST(lexer::Number value);
+  codegen::VariableExprAST *consVariableAST(llvm::StringRef name,
+                                            symbol::SymbolId nameId);
+  codegen::BinaryExprAST *consBinaryAST(llvm::StringRef op,
+                                        codegen::ExprAST *lhs,
+                                        codegen::ExprAST *rhs);
+  codegen::CastAST *consCastAST(int datatype, bool isPointer,
+                                codegen::ExprAST *rhs);
+  /**
+   * @brief returns a node that can be modified safely, shared nodes get
+   * a shallow copy, their children stay shared
+   * @param node: the node we want to modify
+   * @return the node itself or its private copy
+   */
+  codegen::ExprAST *unshare(codegen::ExprAST *node);
+  /** @brief whether or not the node is in the cons table */
+  bool isConsed(const codegen::ExprAST *node) const;
+  /**
+   * @brief forgets the consed nodes, following nodes will not be shared
+   * with the previous ones. The parser does it at every function, the
+   * datatype of a variable read depends on the scope it is in
+   */
+  inline void clearConsTable() { consTable.clear(); }
+
+  /**
+   * @brief releases all the nodes at once, the slabs are kept by the
+   * allocator and reused by the next nodes, see SlabAllocator::clear()
+   */
+  void clear() {
+    clearConsTable();
+    allocator.clear();
   }
+  /**
+   * @brief restarts both the factory and the allocator counters, meant
+   * to be called before every compilation
+   */
+  void resetStats() {
+    stats = Stats();
+    allocator.resetStats();
+  }
+  /**
+   * @brief human readable report of the factory and allocator counters
+   * @return the multiline report
+   */
+  std::string dumpStats() const;
 
-  std::vector<codegen::ExprAST *> ptrs;
   SlabAllocator allocator;
+  Stats stats;
+  /** enables the sharing of structurally identical nodes, see cons */
+  bool hashConsing = false;
+
+private:
+  template <typename T, typename... Args>
+  T *consASTNode(const ConsKey &key, Args &&... args) {
+    if (!hashConsing) {
+      return allocASTNode<T>(std::forward<Args>(args)...);
+    }
+    auto found = consTable.find(key);
+    if (found != consTable.end()) {
+      ++stats.consHits;
+      stats.consBytesSaved += sizeof(T);
+      return static_cast<T *>(found->second);
+    }
+    T *node = allocASTNode<T>(std::forward<Args>(args)...);
+    consTable.emplace(key, node);
+    return node;
+  }
+
+  template <typename T, typename... Args> T *constructASTNode(Args &&... args) {
+    T *node = new (allocator.alloc(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+    ++stats.nodeCounts[node->nodetype];
+    stats.nodeBytes[node->nodetype] += sizeof(T);
+    return node;
+  }
+
+  std::unordered_map<ConsKey, codegen::ExprAST *, ConsKeyHash> consTable;
 };
 
+template <typename T>
+template <typename U>
+ArenaArray<T> ArenaCopy<std::vector<T>>::apply(FactoryAST *factory,
+                                                const U &value) {
+  return factory->copyArray(value);
+}
+
 } // namespace memory
 } // namespace babycpp
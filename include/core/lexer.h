@@ -1,8 +1,16 @@
 #pragma once
 #include "diagnostic.h"
+#include "symbolTable.h"
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <regex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace babycpp {
 namespace lexer {
@@ -12,9 +20,13 @@ namespace lexer {
 static const std::regex MAIN_REGEX(
     R"([ \t]*([[:alpha:]]\w*\b))"      // here we try to catch a common
                                        // identifier either
-    R"(|[ \t]*([\d.]+))"               // here we match digits
-    R"(|[ \t]*([\(\)\{\}\+-/\*;,<=]))" // parsing supported ascii
-    R"(|[ \t]*([\r\n|\r|\n]))"         // catching new line combinations
+    R"(|[ \t]*((?:0[xX][[:xdigit:]]+|[\d.]+(?:[eE][+-]?\d+)?)[uUlLfF]*))"
+    // here we match numbers, hex, exponent and suffixes included
+    // parsing supported ascii, multi char operators first so the longest
+    // operator wins
+    R"(|[ \t]*(<<=|>>=|[-+*/%&|^=!<>]=|&&|\|\||<<|>>)"
+    R"(|[\(\)\{\}\+-/\*;,<=>!&|^%]))"
+    R"(|[ \t]*([\r\n]))" // catching new line combinations
 
 );
 
@@ -97,7 +109,8 @@ struct Number {
 /**
  * @brief map defining keyword of the language
  * Maps keyword of the language from ascii representation to
- * their token representation
+ * their token representation, the lexer uses lookupKeyword which
+ * encodes the same set, the map is kept as the reference definition
  */
 static const std::unordered_map<std::string, Token> KEYWORDS{
     {"int", tok_int},         {"float", tok_float},
@@ -110,26 +123,251 @@ static const std::unordered_map<std::string, Token> KEYWORDS{
     {",", tok_comma},         {"=", tok_assigment_operator},
     {"return", tok_return},   {"if", tok_if},
     {"else", tok_else},       {"for", tok_for},
-    {"nullptr", tok_nullptr}, {"void", tok_void_ptr}};
+    {"nullptr", tok_nullptr}, {"void", tok_void_ptr},
+    {">", tok_operator},      {"%", tok_operator},
+    {"&", tok_operator},      {"|", tok_operator},
+    {"^", tok_operator},      {"!", tok_operator},
+    {"==", tok_operator},     {"!=", tok_operator},
+    {"<=", tok_operator},     {">=", tok_operator},
+    {"&&", tok_operator},     {"||", tok_operator},
+    {"<<", tok_operator},     {">>", tok_operator},
+    {"+=", tok_operator},     {"-=", tok_operator},
+    {"*=", tok_operator},     {"/=", tok_operator},
+    {"%=", tok_operator},     {"&=", tok_operator},
+    {"|=", tok_operator},     {"^=", tok_operator},
+    {"<<=", tok_operator},    {">>=", tok_operator}};
+
+/** @brief compile time comparison of a slice against a keyword literal */
+constexpr bool keywordEquals(const char *str, const char *keyword,
+                             size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    if (str[i] != keyword[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** @brief whether the char is one of the given null terminated set */
+constexpr bool isOneOf(char c, const char *set) {
+  for (; *set != 0; ++set) {
+    if (c == *set) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** @brief two chars operators, compound assignments, comparisons, logical
+ * operators and shifts */
+constexpr bool isTwoCharOperator(const char *str) {
+  return (str[1] == '=' && isOneOf(str[0], "-+*/%&|^=!<>")) ||
+         (str[0] == str[1] && isOneOf(str[0], "&|<>"));
+}
+
+/**
+ * @brief perfect hash over the KEYWORDS set
+ * Switches on the length first and the first character second, which
+ * leaves at most a single candidate to compare against, no hashing of
+ * the whole string and no allocation. Must be kept in sync with KEYWORDS,
+ * the lexer tests check the two agree
+ * @param str: pointer to the start of the slice to check
+ * @param len: length of the slice
+ * @return the keyword token or tok_no_match
+ */
+constexpr int lookupKeyword(const char *str, size_t len) {
+  switch (len) {
+  case 1:
+    switch (str[0]) {
+    case '+':
+    case '-':
+    case '*':
+    case '<':
+    case '/':
+    case '>':
+    case '%':
+    case '&':
+    case '|':
+    case '^':
+    case '!':
+      return tok_operator;
+    case '{':
+      return tok_open_curly;
+    case '}':
+      return tok_close_curly;
+    case '(':
+      return tok_open_round;
+    case ')':
+      return tok_close_round;
+    case ';':
+      return tok_end_statement;
+    case ',':
+      return tok_comma;
+    case '=':
+      return tok_assigment_operator;
+    default:
+      return tok_no_match;
+    }
+  case 2:
+    if (keywordEquals(str, "if", 2)) {
+      return tok_if;
+    }
+    return isTwoCharOperator(str) ? tok_operator : tok_no_match;
+  case 3:
+    switch (str[0]) {
+    case 'i':
+      return keywordEquals(str, "int", 3) ? tok_int : tok_no_match;
+    case 'f':
+      return keywordEquals(str, "for", 3) ? tok_for : tok_no_match;
+    case '<':
+      return keywordEquals(str, "<<=", 3) ? tok_operator : tok_no_match;
+    case '>':
+      return keywordEquals(str, ">>=", 3) ? tok_operator : tok_no_match;
+    default:
+      return tok_no_match;
+    }
+  case 4:
+    switch (str[0]) {
+    case 'e':
+      return keywordEquals(str, "else", 4) ? tok_else : tok_no_match;
+    case 'v':
+      return keywordEquals(str, "void", 4) ? tok_void_ptr : tok_no_match;
+    default:
+      return tok_no_match;
+    }
+  case 5:
+    return keywordEquals(str, "float", 5) ? tok_float : tok_no_match;
+  case 6:
+    switch (str[0]) {
+    case 's':
+      return keywordEquals(str, "string", 6) ? tok_string : tok_no_match;
+    case 'e':
+      return keywordEquals(str, "extern", 6) ? tok_extern : tok_no_match;
+    case 'r':
+      return keywordEquals(str, "return", 6) ? tok_return : tok_no_match;
+    default:
+      return tok_no_match;
+    }
+  case 7:
+    return keywordEquals(str, "nullptr", 7) ? tok_nullptr : tok_no_match;
+  default:
+    return tok_no_match;
+  }
+}
+
+inline int lookupKeyword(llvm::StringRef str) {
+  return lookupKeyword(str.data(), str.size());
+}
+
+static_assert(lookupKeyword("nullptr", 7) == tok_nullptr,
+              "keyword perfect hash out of sync");
+static_assert(lookupKeyword("floats", 6) == tok_no_match,
+              "keyword perfect hash out of sync");
 
 // aliases
 using Charmatch = std::match_results<const char *>;
 
+/**
+ * @brief defines which implementation the lexer uses to split the source
+ * REGEX is the original MAIN_REGEX based implementation, SCANNER is a hand
+ * written scanner driven by a character class table. The two are token for
+ * token compatible, the scanner avoids running the regex engine per token
+ */
+enum class LexerMode { REGEX = 0, SCANNER = 1 };
+
 /**
  * @brief struct used to perform look ahead in the lexer
  * This struct is used to save the status of a whole token
  * when gets read. In this way we can store the data whithout
- * actually moving the lexer pointer
+ * actually moving the lexer pointer. Names are slices of the lexer
+ * source so the struct is trivially copyable and cheap to move around
  */
 struct MovableToken {
   /// current type of token
   int token;
-  /// possible name associated with the token
-  std::string identifierStr;
+  /// possible name associated with the token, slice of the lexer source
+  llvm::StringRef identifierStr;
+  /// interned id of the name if the token is an identifier
+  symbol::SymbolId identifierId;
   /// possible value associated with the token
   Number value;
-  /// offset to add to the column number once we processed it
-  int columnOffset;
+  /// line the lexer is at once the token has been read
+  int lineNumber;
+  /// column the lexer is at once the token has been read
+  int32_t columnNumber;
+};
+
+/**
+ * @brief fixed capacity queue of looked ahead tokens
+ * The tokens live inline in the lexer, pushing and popping never
+ * allocates, the capacity is the maximum amount of tokens that can be
+ * looked ahead at once
+ */
+struct TokenRingBuffer {
+  static const uint32_t CAPACITY = 8;
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0,
+                "ring buffer capacity must be a power of two");
+
+  inline bool empty() const { return count == 0; }
+  inline bool full() const { return count == CAPACITY; }
+  inline uint32_t size() const { return count; }
+  inline void clear() {
+    head = 0;
+    count = 0;
+  }
+  /** @brief appends a token at the back, the buffer must not be full */
+  inline void push_back(const MovableToken &tok) {
+    assert(!full());
+    tokens[(head + count) & (CAPACITY - 1)] = tok;
+    ++count;
+  }
+  /** @brief removes the token at the front, the buffer must not be empty */
+  inline void pop_front() {
+    assert(!empty());
+    head = (head + 1) & (CAPACITY - 1);
+    --count;
+  }
+  inline const MovableToken &front() const { return tokens[head]; }
+  /** @brief access the i-th token ahead, zero being the next one */
+  inline const MovableToken &operator[](uint32_t i) const {
+    assert(i < count);
+    return tokens[(head + i) & (CAPACITY - 1)];
+  }
+
+  MovableToken tokens[CAPACITY];
+  uint32_t head = 0;
+  uint32_t count = 0;
+};
+
+/**
+ * @brief whole source lexed up front, stored as structure of arrays
+ * Every array is indexed by the token index, names are stored as offset
+ * and length in the source rather than as slices to keep the arrays
+ * compact. The last token is always tok_eof or tok_no_match
+ */
+struct TokenBuffer {
+  inline uint32_t size() const { return static_cast<uint32_t>(kinds.size()); }
+  inline void clear() {
+    kinds.clear();
+    offsets.clear();
+    lengths.clear();
+    ids.clear();
+    values.clear();
+    lines.clear();
+    columns.clear();
+  }
+  inline llvm::StringRef getString(const char *source, uint32_t i) const {
+    return llvm::StringRef(source + offsets[i], lengths[i]);
+  }
+
+  std::vector<int> kinds;
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> lengths;
+  std::vector<symbol::SymbolId> ids;
+  std::vector<Number> values;
+  /// line and column the lexer is at once the token has been read
+  std::vector<int> lines;
+  std::vector<int32_t> columns;
 };
 
 /**
@@ -140,12 +378,18 @@ struct MovableToken {
  */
 struct Lexer {
 
-  /** @brief default constructor */
-  explicit Lexer(diagnostic::Diagnostic *indiagnostic)
-      : expr(MAIN_REGEX), diagnostic(indiagnostic) {}
+  /** @brief default constructor
+   * @param indiagnostic: diagnostic used to report issues
+   * @param inmode: which implementation to use for lexing, defaults to
+   *                the table driven scanner
+   */
+  explicit Lexer(diagnostic::Diagnostic *indiagnostic,
+                 LexerMode inmode = LexerMode::SCANNER)
+      : expr(MAIN_REGEX), diagnostic(indiagnostic), mode(inmode) {}
   /** @brief  constructor
-   * @param reg: provide custom regex to apply on the string */
-  explicit Lexer(std::regex &reg) : expr(reg) {}
+   * @param reg: provide custom regex to apply on the string, forces
+   *             the lexer in regex mode */
+  explicit Lexer(std::regex &reg) : expr(reg), mode(LexerMode::REGEX) {}
 
   /**@brief this is the core method to provide data to the lexer
    * @param str: the string we are going to initialize the data
@@ -154,17 +398,29 @@ struct Lexer {
   // TODO(giordi) refactor name to be initFromString to be uniform
   // with codegen
   inline void initFromString(const std::string &str) {
+    fileBuffer.reset();
     data = str;
-    start = data.c_str();
-    lineNumber = 1;
-    columnNumber = 0;
-    lookAheadToken.clear();
+    resetSource(data.c_str());
   }
 
+  /**@brief initializes the lexer directly from a file on disk
+   * The file is memory mapped read only when the platform allows it
+   * (small files are read in one go), the lexer works straight on the
+   * mapping so no copy of the source is made. Tokens slice into the
+   * mapping which stays alive until the lexer is initialized again
+   * @param path: path of the source file to lex
+   * @return whether or not the file could be opened, on failure an
+   *         issue is pushed in the diagnostic and the lexer is left empty
+   */
+  bool initFromFile(const std::string &path);
+
   /** @brief process the next token and makes it available to
    *         be analized
    */
   void gettok();
+  /** @brief lexes the next token from the source, skipping the look
+   * ahead buffer */
+  void lexToken();
 
   /** @brief performas a look ahead withouth making the
    * the lexer pointer to move.
@@ -173,19 +429,79 @@ struct Lexer {
    * and if any token is in the cache it will be took from there
    * rather than be parsed. This method makes the process completely
    * transparent to the user. Once the token are looked ahead can be
-   * accessed from the deque "lookAheadToken"
-   * @param count: how many tokens we are going to look ahead
+   * accessed from the ring buffer "lookAheadToken", tokens already
+   * buffered are not lexed again
+   * @param count: how many tokens we are going to look ahead, at most
+   *               TokenRingBuffer::CAPACITY
    * @return bool, whether or not the look ahead was successiful.
    *               this might fail when the file ends before
    *               the specific amount of tokens are processed
    */
   bool lookAhead(int count);
 
+  /** @brief lexes the whole source up front in the token buffer
+   * From this point on gettok only reads from the buffer, lexing is not
+   * interleaved with parsing anymore and looking ahead of any amount of
+   * tokens is free. Must be called right after the lexer has been
+   * initialized, before any token is read
+   * @return whether or not the whole source lexed successfully, if not
+   *         the buffer ends with tok_no_match where lexing stopped
+   */
+  bool tokenize();
+  /** @brief goes back to the first token of the token buffer, so the
+   * same source can be parsed again without lexing it again */
+  inline void rewind() {
+    cursor = 0;
+    currtok = -1;
+    lineNumber = 1;
+    columnNumber = 0;
+  }
+  /** @brief how many tokens ahead of the current one can be peeked, near
+   * the end of the source this can be less than what lookAhead() asked
+   * for, the terminator is not counted */
+  inline uint32_t lookAheadSize() const {
+    if (!useTokenBuffer) {
+      return lookAheadToken.size();
+    }
+    return cursor + 1 < tokens.size() ? tokens.size() - 1 - cursor : 0;
+  }
+  /** @brief returns the i-th token ahead of the current one, zero being
+   * the next token. Reading from the token buffer any token up to the end
+   * can be accessed, otherwise only the tokens made available by a
+   * previous lookAhead() can. The token buffer must not be empty */
+  inline MovableToken peekToken(uint32_t i) const {
+    if (!useTokenBuffer) {
+      return lookAheadToken[i];
+    }
+    // past the end we keep returning the terminator like gettok does
+    uint32_t last = tokens.size() - 1;
+    uint32_t idx = cursor + i < last ? cursor + i : last;
+    return MovableToken{tokens.kinds[idx],  tokens.getString(tokenSource, idx),
+                        tokens.ids[idx],    tokens.values[idx],
+                        tokens.lines[idx],  tokens.columns[idx]};
+  }
+
+  /** @brief resets the lexing status to the beginning of the given buffer,
+   * which must be null terminated */
+  inline void resetSource(const char *buffer) {
+    start = buffer;
+    tokenSource = buffer;
+    lineNumber = 1;
+    columnNumber = 0;
+    lookAheadToken.clear();
+    tokens.clear();
+    cursor = 0;
+    useTokenBuffer = false;
+  }
+
   // lexed data
   /// the current active token
   int currtok = -1;
-  /// possible string value of the processed token
-  std::string identifierStr;
+  /// possible string value of the processed token, this is a slice into
+  /// the source and not a copy, it stays valid until the next init
+  llvm::StringRef identifierStr;
+  /// interned id of identifierStr, only valid for tok_identifier
+  symbol::SymbolId identifierId = symbol::INVALID_SYMBOL;
   /// possible value of the processed token if it is a numeric value
   Number value;
   /// current line number in the file
@@ -194,14 +510,33 @@ struct Lexer {
 
   // regex classes
   std::regex expr;
+  /// source buffer, every token and AST name slices into it so it must
+  /// outlive the AST generated from it
   std::string data;
+  /// mapped file when the lexer has been initialized from a file, data
+  /// is left empty in that case
+  std::unique_ptr<llvm::MemoryBuffer> fileBuffer;
   Charmatch matcher;
   /// pointer keeping track of where we are in the buffer
   const char *start = nullptr;
 
   /// buffer of processed tokens for when looking ahead
-  std::deque<MovableToken> lookAheadToken;
+  TokenRingBuffer lookAheadToken;
+  /// all the tokens of the source, filled by tokenize(), the vectors are
+  /// kept around so their memory is reused by the next tokenize()
+  TokenBuffer tokens;
+  /// start of the source the token offsets are relative to
+  const char *tokenSource = nullptr;
+  /// index of the next token to read from the token buffer
+  uint32_t cursor = 0;
+  /// whether gettok reads from the token buffer or lexes on demand
+  bool useTokenBuffer = false;
   diagnostic::Diagnostic *diagnostic;
+  /// implementation used to extract the tokens
+  LexerMode mode;
+  /// interner for all the identifiers met, it is not reset by
+  /// initFromString so ids stay stable across different sources
+  symbol::SymbolTable symbols;
 };
 
 } // namespace lexer
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <cstdint>
+#include <memory>
+
+namespace llvm {
+class PassManagerBuilder;
+} // namespace llvm
+
+namespace babycpp {
+namespace codegen {
+
+/** @brief how hard the optimizer works, same meaning of -O of a compiler */
+enum class OptLevel : uint32_t { O0 = 0, O1 = 1, O2 = 2, O3 = 3 };
+
+/** @brief what the optimizer did so far */
+struct OptimizationStats {
+  uint64_t functionsOptimized = 0;
+  uint64_t modulesOptimized = 0;
+  /** instructions of the optimized functions before and after */
+  uint64_t instructionsBefore = 0;
+  uint64_t instructionsAfter = 0;
+  /** instructions of the whole module before and after the module
+   * pipeline, the function pipeline might have already run */
+  uint64_t moduleInstructionsBefore = 0;
+  uint64_t moduleInstructionsAfter = 0;
+  /** time spent in the function and in the module pipelines */
+  double functionMilliseconds = 0.0;
+  double moduleMilliseconds = 0.0;
+
+  inline OptimizationStats &operator+=(const OptimizationStats &other) {
+    functionsOptimized += other.functionsOptimized;
+    modulesOptimized += other.modulesOptimized;
+    instructionsBefore += other.instructionsBefore;
+    instructionsAfter += other.instructionsAfter;
+    moduleInstructionsBefore += other.moduleInstructionsBefore;
+    moduleInstructionsAfter += other.moduleInstructionsAfter;
+    functionMilliseconds += other.functionMilliseconds;
+    moduleMilliseconds += other.moduleMilliseconds;
+    return *this;
+  }
+};
+
+/**
+ * @brief runs the llvm pass pipeline matching the optimization level
+ * The pipeline is the standard one of PassManagerBuilder, so at O1 and
+ * above the allocas generated for every variable are promoted to
+ * registers (mem2reg/SROA), then instcombine, GVN, loop rotation, LICM,
+ * unrolling and so on; inlining runs in the module pipeline only.
+ * At O0 nothing runs and the IR is left as generated.
+ * From O2 the loop and SLP vectorizers run as well, they only do something
+ * when a target machine is given, without it the cost model knows of no
+ * vector registers; with it modules get its triple and data layout.
+ * Function pipelines are cached per module, if the module a function
+ * lives in changes the pipeline is built again
+ */
+struct Optimizer {
+  explicit Optimizer(OptLevel inlevel = OptLevel::O0) : level(inlevel) {}
+
+  /**
+   * @brief runs the function pipeline on a single function, meant to be
+   * called right after the function has been generated
+   * @param function: function to optimize, must have a body
+   * @return whether or not the function has been changed
+   */
+  bool optimizeFunction(llvm::Function *function);
+  /**
+   * @brief runs the whole pipeline on the module, inlining included, if
+   * runPerFunction is false the functions have not been optimized yet so
+   * the function pipeline runs on all of them first
+   * @param module: the module to optimize
+   * @return whether or not the module has been changed
+   */
+  bool optimizeModule(llvm::Module *module);
+  /** @brief drops the cached function pipeline, needed when the module it
+   * has been built for goes away */
+  void clearPipelines();
+
+  OptLevel level;
+  /** whether or not the generator optimizes every function right after
+   * generating it, see FunctionAST::codegen */
+  bool runPerFunction = true;
+  /** whether or not the loop and SLP vectorizers run, from O2 only */
+  bool vectorize = true;
+  /** target the code is optimized for, not owned, the vectorizers and
+   * other passes query its cost model, set it before optimizing */
+  llvm::TargetMachine *targetMachine = nullptr;
+  OptimizationStats stats;
+
+private:
+  void configureBuilder(llvm::PassManagerBuilder *builder) const;
+  void addTargetPasses(llvm::legacy::PassManagerBase *passes) const;
+  void prepareModule(llvm::Module *module) const;
+  llvm::legacy::FunctionPassManager *getFunctionPasses(llvm::Module *module);
+
+  std::unique_ptr<llvm::legacy::FunctionPassManager> functionPasses;
+  llvm::Module *functionPassesModule = nullptr;
+};
+
+} // namespace codegen
+} // namespace babycpp
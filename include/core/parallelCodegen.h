@@ -0,0 +1,50 @@
+#pragma once
+#include "codegen.h"
+
+#include <llvm/ADT/ArrayRef.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace babycpp {
+namespace codegen {
+
+/**
+ * @brief generates the IR of the given top level statements concurrently
+ * Every worker is a Codegenerator of its own, with its own LLVMContext,
+ * builder and module, so the threads do not share any llvm object. The
+ * statements are split in contiguous blocks, one per worker. Every worker
+ * knows the prototypes of the statements before its block, the externs
+ * and the functions of the previous blocks get declared in its module when
+ * called, so the modules can be linked together or handed to a jit one by
+ * one. As in a single pass, calling a function defined further down is an
+ * error.
+ * The workers share the symbol ids of gen, the AST must have been parsed
+ * with its symbol table, see parser::parseInParallel
+ * @param gen: generator the symbols, builtins and prototypes are taken
+ * from, its diagnostic receives the errors of the workers
+ * @param statements: top level statements, in source order
+ * @param workerCount: how many threads to use, 0 means one per core
+ * @return the workers, in source order, their modules hold the IR
+ */
+std::vector<std::unique_ptr<Codegenerator>>
+generateInParallel(Codegenerator *gen, llvm::ArrayRef<ExprAST *> statements,
+                   uint32_t workerCount = 0);
+
+/**
+ * @brief moves the modules of the workers in the module of gen
+ * Modules in different contexts can't be linked directly, every module
+ * goes through bitcode to get in the context of gen first. On success the
+ * prototypes of the linked functions are registered in gen
+ * @param gen: generator owning the destination module
+ * @param workers: the result of generateInParallel, their modules are
+ * consumed
+ * @return false if a module could not be linked, the error is in the
+ * diagnostic of gen
+ */
+bool linkWorkerModules(Codegenerator *gen,
+                       std::vector<std::unique_ptr<Codegenerator>> *workers);
+
+} // namespace codegen
+} // namespace babycpp
@@ -0,0 +1,90 @@
+#pragma once
+#include "AST.h"
+#include "diagnostic.h"
+#include "factoryAST.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <llvm/ADT/StringRef.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace babycpp {
+namespace parser {
+
+/** @brief slice of a source made of whole top level statements */
+struct SourceRange {
+  uint32_t begin;
+  uint32_t end;
+  /** line of the source the range starts at */
+  int line;
+};
+
+/**
+ * @brief splits the source in at most rangeCount ranges of similar size,
+ * cutting only where a top level statement ends, meaning a ; or a } at
+ * curly depth zero
+ * @param source: the whole source
+ * @param rangeCount: how many ranges we would like, less are returned if
+ * there are not enough top level statements
+ * @return the ranges, in source order, covering the whole source
+ */
+std::vector<SourceRange> splitTopLevelStatements(llvm::StringRef source,
+                                                 uint32_t rangeCount);
+
+/**
+ * @brief everything needed to parse a range of the source on its own
+ * thread, the AST lives in the factory and slices the lexer buffer, so
+ * the worker must outlive the generated code
+ */
+struct ParseWorker {
+  ParseWorker()
+      : lexer(&diagnostic), parser(&lexer, &factory, &diagnostic) {}
+  ParseWorker(const ParseWorker &) = delete;
+  ParseWorker &operator=(const ParseWorker &) = delete;
+
+  /**
+   * @brief parses all the top level statements in the range, with the
+   * same error recovery of Codegenerator::generateModuleContent
+   * @param source: the whole source
+   * @param range: the part of the source this worker is in charge of
+   */
+  void parse(llvm::StringRef source, const SourceRange &range);
+  /**
+   * @brief moves the symbols of the AST from the worker symbol table to
+   * the given one, must be called once the parse is done
+   * @param symbols: table the ids get remapped to
+   */
+  void remapSymbols(symbol::SymbolTable *symbols);
+
+  diagnostic::Diagnostic diagnostic;
+  memory::FactoryAST factory;
+  lexer::Lexer lexer;
+  Parser parser;
+  /** statements parsed without errors, in source order */
+  std::vector<codegen::ExprAST *> statements;
+  /** whether the lexer could not go to the end of the range, the
+   * statements after this range should not be generated */
+  bool stoppedEarly = false;
+};
+
+/**
+ * @brief parses the top level statements of the source concurrently
+ * The source is split in one range per worker, each worker has its own
+ * lexer, factory and diagnostic so the threads do not share anything
+ * while parsing. Once all of them are done the symbols are remapped to
+ * the given table, on the calling thread.
+ * @param source: the whole source
+ * @param workerCount: how many threads to use, 0 means one per core
+ * @param symbols: table the ids of the AST get remapped to
+ * @param hashConsing: whether the worker factories use hash consing
+ * @return the workers, in source order
+ */
+std::vector<std::unique_ptr<ParseWorker>>
+parseInParallel(llvm::StringRef source, uint32_t workerCount,
+                symbol::SymbolTable *symbols, bool hashConsing = false);
+
+} // namespace parser
+} // namespace babycpp
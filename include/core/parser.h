@@ -1,6 +1,7 @@
 #pragma once
 #include "lexer.h"
 
+#include <cstdint>
 #include <unordered_map>
 
 namespace babycpp {
@@ -23,6 +24,180 @@ using lexer::Lexer;
 using lexer::Number;
 using lexer::Token;
 
+/** @brief binary operators supported by the expression parser */
+enum BinaryOp : uint8_t {
+  OP_MUL = 0,
+  OP_DIV,
+  OP_MOD,
+  OP_ADD,
+  OP_SUB,
+  OP_SHL,
+  OP_SHR,
+  OP_LESS,
+  OP_LESS_EQUAL,
+  OP_GREATER,
+  OP_GREATER_EQUAL,
+  OP_EQUAL,
+  OP_NOT_EQUAL,
+  OP_BIT_AND,
+  OP_BIT_XOR,
+  OP_BIT_OR,
+  OP_LOGIC_AND,
+  OP_LOGIC_OR,
+  OP_ASSIGN,
+  OP_ADD_ASSIGN,
+  OP_SUB_ASSIGN,
+  OP_MUL_ASSIGN,
+  OP_DIV_ASSIGN,
+  OP_MOD_ASSIGN,
+  OP_AND_ASSIGN,
+  OP_OR_ASSIGN,
+  OP_XOR_ASSIGN,
+  OP_SHL_ASSIGN,
+  OP_SHR_ASSIGN,
+  OP_COUNT,
+  OP_NONE = 0xFF
+};
+
+/** @brief description of a binary operator */
+struct BinaryOperatorInfo {
+  BinaryOp op;
+  /** binding power, a higher number binds tighter */
+  int precedence;
+  bool rightAssociative;
+  /** = and compound assignments, the LHS needs to be a variable */
+  bool isAssignment;
+};
+
+/** @brief operators table, indexed by BinaryOp, precedences follow C */
+constexpr BinaryOperatorInfo BINARY_OPERATORS[OP_COUNT] = {
+    {OP_MUL, 100, false, false},       {OP_DIV, 100, false, false},
+    {OP_MOD, 100, false, false},       {OP_ADD, 90, false, false},
+    {OP_SUB, 90, false, false},        {OP_SHL, 80, false, false},
+    {OP_SHR, 80, false, false},        {OP_LESS, 70, false, false},
+    {OP_LESS_EQUAL, 70, false, false}, {OP_GREATER, 70, false, false},
+    {OP_GREATER_EQUAL, 70, false, false},
+    {OP_EQUAL, 60, false, false},      {OP_NOT_EQUAL, 60, false, false},
+    {OP_BIT_AND, 50, false, false},    {OP_BIT_XOR, 40, false, false},
+    {OP_BIT_OR, 30, false, false},     {OP_LOGIC_AND, 20, false, false},
+    {OP_LOGIC_OR, 10, false, false},   {OP_ASSIGN, 5, true, true},
+    {OP_ADD_ASSIGN, 5, true, true},    {OP_SUB_ASSIGN, 5, true, true},
+    {OP_MUL_ASSIGN, 5, true, true},    {OP_DIV_ASSIGN, 5, true, true},
+    {OP_MOD_ASSIGN, 5, true, true},    {OP_AND_ASSIGN, 5, true, true},
+    {OP_OR_ASSIGN, 5, true, true},     {OP_XOR_ASSIGN, 5, true, true},
+    {OP_SHL_ASSIGN, 5, true, true},    {OP_SHR_ASSIGN, 5, true, true},
+};
+
+/** @brief checks at compile time the table is indexed by the enum */
+constexpr bool isOperatorTableSorted() {
+  for (int i = 0; i < OP_COUNT; ++i) {
+    if (BINARY_OPERATORS[i].op != i) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(isOperatorTableSorted(),
+              "BINARY_OPERATORS must be indexed by BinaryOp");
+
+/**
+ * @brief maps the operator string to the operator, a switch on the
+ * length and on the chars so there is no hashing involved
+ * @param str: operator as extracted by the lexer
+ * @param len: length of the operator
+ * @return the operator or OP_NONE if not a binary operator
+ */
+constexpr BinaryOp findBinaryOperator(const char *str, size_t len) {
+  switch (len) {
+  case 1:
+    switch (str[0]) {
+    case '*':
+      return OP_MUL;
+    case '/':
+      return OP_DIV;
+    case '%':
+      return OP_MOD;
+    case '+':
+      return OP_ADD;
+    case '-':
+      return OP_SUB;
+    case '<':
+      return OP_LESS;
+    case '>':
+      return OP_GREATER;
+    case '&':
+      return OP_BIT_AND;
+    case '^':
+      return OP_BIT_XOR;
+    case '|':
+      return OP_BIT_OR;
+    case '=':
+      return OP_ASSIGN;
+    default:
+      return OP_NONE;
+    }
+  case 2:
+    if (str[1] == '=') {
+      switch (str[0]) {
+      case '<':
+        return OP_LESS_EQUAL;
+      case '>':
+        return OP_GREATER_EQUAL;
+      case '=':
+        return OP_EQUAL;
+      case '!':
+        return OP_NOT_EQUAL;
+      case '+':
+        return OP_ADD_ASSIGN;
+      case '-':
+        return OP_SUB_ASSIGN;
+      case '*':
+        return OP_MUL_ASSIGN;
+      case '/':
+        return OP_DIV_ASSIGN;
+      case '%':
+        return OP_MOD_ASSIGN;
+      case '&':
+        return OP_AND_ASSIGN;
+      case '|':
+        return OP_OR_ASSIGN;
+      case '^':
+        return OP_XOR_ASSIGN;
+      default:
+        return OP_NONE;
+      }
+    }
+    if (str[0] != str[1]) {
+      return OP_NONE;
+    }
+    switch (str[0]) {
+    case '<':
+      return OP_SHL;
+    case '>':
+      return OP_SHR;
+    case '&':
+      return OP_LOGIC_AND;
+    case '|':
+      return OP_LOGIC_OR;
+    default:
+      return OP_NONE;
+    }
+  case 3:
+    if (str[2] != '=' || str[0] != str[1]) {
+      return OP_NONE;
+    }
+    return str[0] == '<' ? OP_SHL_ASSIGN
+                         : (str[0] == '>' ? OP_SHR_ASSIGN : OP_NONE);
+  default:
+    return OP_NONE;
+  }
+}
+
+static_assert(findBinaryOperator(">>=", 3) == OP_SHR_ASSIGN,
+              "operator lookup out of sync");
+static_assert(findBinaryOperator("!", 1) == OP_NONE,
+              "operator lookup out of sync");
+
 /** @brief set of flags representing the status of the parser */
 struct ParserFlags {
   bool processed_assigment : 1;
@@ -50,24 +225,22 @@ struct Parser {
    * @brief parses an expression
    * Expressions is a high level concepts, not necesserly in the
    * mathematical meaning. An expression can be a function call,
-   * an assigment a bin op etc
+   * an assigment a bin op etc. Binary operators and parenthesis are
+   * handled with an explicit stack driven by BINARY_OPERATORS, so the
+   * length and the nesting of an expression do not grow the call stack
    * @return ExprAST* pointer to the top of the expression subtree
    */
   codegen::ExprAST *parseExpression();
   /**
-   * @brief parses a binary operations
-   * @param givenPrec: this is the current precedens of the operator
-   *                   alraedy processed, in case is the first call
-   *                   in the stack a -1 should be passed, in case
-   *                   of chained binary operations, the previously
-   *                   parsed operator precedence should be passed,
-   *                   so that correct precendence is handled
-   * @param LHS: pointer to the left hand side of the operation which
-   *             has been already processed, that can be a sub operation
-   *             in case of chained operations
-   * @return : pointer to the AST node representing the RHS of the op
+   * @brief combines two operands with a binary operator, assignments
+   * are turned in the assigment of a variable node, compound assignments
+   * are expanded in the equivalent binary operation, so x += 1 becomes
+   * x = x + 1
+   * @return the resulting node, nullptr on error
    */
-  codegen::ExprAST *parseBinOpRHS(int givenPrec, codegen::ExprAST *LHS);
+  codegen::ExprAST *makeBinaryNode(BinaryOp op, llvm::StringRef opStr,
+                                   codegen::ExprAST *LHS,
+                                   codegen::ExprAST *RHS);
 
   /**@brief parses the leftmost part of an expression, or sub expression */
   codegen::ExprAST *parsePrimary();
@@ -118,10 +291,22 @@ struct Parser {
    * cast*/
   codegen::ExprAST *parseCast();
 
-  /** @brief constant map representing the different operators precedences
-   *  a higher positive number represents an higher precedence
+  /**@brief panic mode recovery, skips tokens until the end of the current
+   * statement, meaning after the next ; or before the } closing the
+   * enclosing block. Blocks opened while skipping are skipped as a whole
    */
-  const static std::unordered_map<char, int> BIN_OP_PRECEDENCE;
+  void synchronize();
+  /**@brief called by parseStatement on failure, when recovering it
+   * skips what is left of the broken statement
+   * @param isBlockStatement: whether the statement owns a { } body
+   * @param errorsBefore: number of errors before the statement was parsed
+   * @return always nullptr, so it can be returned straight away
+   */
+  codegen::ExprAST *recoverStatement(bool isBlockStatement, int errorsBefore);
+
+  /** @brief maximum nesting of calls and casts inside an expression, the
+   * only constructs still parsed recursively */
+  static const int MAX_EXPRESSION_DEPTH = 512;
 
   // UTILITY
   static inline bool isDatatype(int tok) {
@@ -146,6 +331,12 @@ struct Parser {
   memory::FactoryAST *factory;
   diagnostic::Diagnostic *diagnostic;
   ParserFlags flags;
+  /// current nesting of parseExpression calls
+  int expressionDepth = 0;
+  /// when true statements that fail to parse are skipped with
+  /// synchronize() and parsing carries on, so that a single pass reports
+  /// every error in the source rather than only the first one
+  bool recoverFromErrors = false;
 };
 
 } // namespace parser
@@ -27,10 +27,72 @@ struct Slab {
   char *endp;
 };
 
+/**
+ * @brief fixed size array living in slab memory
+ * The array does not own its memory, it goes away in bulk together
+ * with the slab it has been allocated from, for this reason only
+ * trivially destructible types should be stored in it
+ * @param data pointer to the first element
+ * @param count number of elements
+ */
+template <typename T> struct ArenaArray {
+  T *data = nullptr;
+  uint32_t count = 0;
+
+  inline T *begin() const { return data; }
+  inline T *end() const { return data + count; }
+  inline uint32_t size() const { return count; }
+  inline bool empty() const { return count == 0; }
+  inline T &operator[](uint32_t i) const { return data[i]; }
+  inline T &back() const { return data[count - 1]; }
+};
+
+/**
+ * @brief counters describing how the memory of an allocator is used,
+ * they can be used to size the slabs for a given workload
+ */
+struct AllocatorStats {
+  /** number of allocations served */
+  uint64_t allocationCount = 0;
+  /** bytes asked by the users of the allocator */
+  uint64_t bytesRequested = 0;
+  /** bytes skipped to honor the requested alignments */
+  uint64_t bytesAlignmentPadding = 0;
+  /** bytes left unused at the end of a slab when moving to the next */
+  uint64_t bytesWastedInSlabTails = 0;
+  /** number of slabs in use, the free list is not counted */
+  uint64_t slabCount = 0;
+  /** allocations too big for a slab and their size in bytes */
+  uint64_t oversizedCount = 0;
+  uint64_t oversizedBytes = 0;
+  /** memory currently handed out, padding and slab tails included */
+  uint64_t currentUsage = 0;
+  /** highest value currentUsage reached since the last reset */
+  uint64_t peakUsage = 0;
+
+  AllocatorStats &operator+=(const AllocatorStats &other) {
+    allocationCount += other.allocationCount;
+    bytesRequested += other.bytesRequested;
+    bytesAlignmentPadding += other.bytesAlignmentPadding;
+    bytesWastedInSlabTails += other.bytesWastedInSlabTails;
+    slabCount += other.slabCount;
+    oversizedCount += other.oversizedCount;
+    oversizedBytes += other.oversizedBytes;
+    currentUsage += other.currentUsage;
+    peakUsage += other.peakUsage;
+    return *this;
+  }
+};
+
 /**
  * Default size for slabs, if not provided this will be used
  */
 const uint32_t SLAB_SIZE = 1 << 21;
+/**
+ * Alignment used when none is provided, enough for pointers and
+ * for all the AST nodes
+ */
+const uint32_t DEFAULT_ALIGNMENT = alignof(void *);
 // Allocator interface
 struct SlabAllocator : Allocator {
   /**
@@ -40,27 +102,53 @@ struct SlabAllocator : Allocator {
    */
   explicit SlabAllocator(int slabSizeInByte = SLAB_SIZE);
   /**
-   * Allocates the requested amount of memory
+   * Allocates the requested amount of memory with the default alignment
    * @param byteSize the size of the requested allocation in bytes
    * @return pointer to the start of allocated memory
    */
-  void *alloc(uint32_t byteSize) override;
+  void *alloc(uint32_t byteSize) override {
+    return alloc(byteSize, DEFAULT_ALIGNMENT);
+  }
+  /**
+   * Allocates the requested amount of memory
+   * @param byteSize the size of the requested allocation in bytes
+   * @param alignment required alignment of the returned pointer, must
+   *        be a power of two
+   * @return pointer to the start of allocated memory, allocations that
+   *         would not fit in a slab get a dedicated block
+   */
+  void *alloc(uint32_t byteSize, uint32_t alignment);
   /**
    * @brief clear the allocation memory
    * Clears the internal memory and all the slabs, only
-   * leaves a single slab allocated and empty
+   * leaves a single slab active and empty, the other slabs are
+   * kept in the free list to be reused by following allocations,
+   * oversized blocks are released
    * WARNING: the allocator does not call any kind of free
    * on the content of the memory, but frees only the whole
    */
   void clear() override;
   /**
-   * @brief Allocates a new slabs an returns a ref to it
+   * @brief Allocates a new slabs an returns a ref to it, the memory
+   * comes from the free list when possible
    * @return  newly allocated slab
    */
   Slab &allocateSlab();
+  /**
+   * @brief gives back to the system the slabs in the free list
+   */
+  void releaseFreeSlabs();
+  /** @return the usage counters, clear() resets the current usage only */
+  inline const AllocatorStats &getStats() const { return stats; }
+  /**
+   * @brief restarts the counters, the peak restarts from the current
+   * usage, meant to be called before every compilation
+   */
+  void resetStats();
   virtual ~SlabAllocator() {
     // freeing all slab except first one
     clear();
+    releaseFreeSlabs();
     // freeing last surviving slab
     delete[] currentSlab->data;
   };
@@ -89,6 +177,16 @@ struct SlabAllocator : Allocator {
    */
   Slab *currentSlab = nullptr;
   uint32_t slabSize;
+  /**
+   * Memory of the slabs released by clear(), ready to be reused
+   */
+  std::vector<char *> freeSlabs;
+  /**
+   * Blocks allocated for requests too big for a slab, they are
+   * released on clear()
+   */
+  std::vector<char *> oversizedBlocks;
+  AllocatorStats stats;
 
   // making the allocator not copyable,movable etc
   SlabAllocator(const SlabAllocator &other) = delete;
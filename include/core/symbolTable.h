@@ -0,0 +1,100 @@
+#pragma once
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace babycpp {
+namespace symbol {
+
+/** dense integer representing an interned identifier */
+using SymbolId = uint32_t;
+/** value used for tokens and nodes which do not carry a symbol */
+const SymbolId INVALID_SYMBOL = 0xFFFFFFFF;
+
+/**
+ * @brief string interner for identifiers and function names
+ * Every identifier gets interned once at lex time and gets a dense id,
+ * starting from zero, all the later passes can then resolve names
+ * by indexing instead of hashing and comparing strings.
+ * The table owns a copy of the strings so ids and names stay valid
+ * when the source buffer of the lexer is replaced
+ */
+struct SymbolTable {
+  /**
+   * @brief returns the id for the given string, interning it if needed
+   * @param str: the identifier to intern
+   * @return the dense id of the symbol
+   */
+  SymbolId intern(llvm::StringRef str);
+  /**
+   * @brief looks up an already interned string without interning it
+   * @param str: the identifier to look for
+   * @return id of the symbol or INVALID_SYMBOL if never interned
+   */
+  SymbolId find(llvm::StringRef str) const;
+
+  /** @brief returns the string the symbol has been interned from */
+  inline llvm::StringRef getName(SymbolId id) const {
+    assert(id < names.size());
+    return names[id];
+  }
+  /** @brief number of interned symbols */
+  inline uint32_t size() const { return static_cast<uint32_t>(names.size()); }
+
+  /// from string to id, owns the memory of the strings
+  llvm::StringMap<SymbolId> ids;
+  /// from id to string, slices the keys of ids which are stable in memory
+  std::vector<llvm::StringRef> names;
+};
+
+/**
+ * @brief flat map from symbol to value
+ * Values are stored in a vector indexed directly by the symbol id, so
+ * look ups are a bound check and an index. The keys that get set are
+ * tracked so that clear() only touches those, clearing a scope costs
+ * as much as the number of variables defined in it and not as much
+ * as the whole symbol table
+ */
+template <typename T> struct SymbolMap {
+  /** @brief access the value, default constructs it if not present */
+  T &operator[](SymbolId id) {
+    assert(id != INVALID_SYMBOL);
+    if (id >= values.size()) {
+      values.resize(id + 1);
+      present.resize(id + 1, 0);
+    }
+    if (present[id] == 0) {
+      present[id] = 1;
+      touched.push_back(id);
+    }
+    return values[id];
+  }
+  /** @brief whether or not a value has been set for the symbol */
+  inline bool contains(SymbolId id) const {
+    return id < present.size() && present[id] != 0;
+  }
+  /** @brief returns the value or a default constructed one if missing,
+   * it never inserts */
+  inline T lookup(SymbolId id) const {
+    return contains(id) ? values[id] : T();
+  }
+  /** @brief removes all the values that have been set */
+  void clear() {
+    for (SymbolId id : touched) {
+      present[id] = 0;
+      values[id] = T();
+    }
+    touched.clear();
+  }
+
+  std::vector<T> values;
+  std::vector<uint8_t> present;
+  std::vector<SymbolId> touched;
+};
+
+} // namespace symbol
+} // namespace babycpp
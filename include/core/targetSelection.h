@@ -0,0 +1,55 @@
+#pragma once
+#include "optimizer.h"
+
+#include <llvm/Target/TargetMachine.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace babycpp {
+namespace codegen {
+
+/**
+ * @brief cpu and features code is generated for, features are in the
+ * format of -mattr, like "+avx2" or "-fma".
+ * The default constructed value means the host cpu, see
+ * hostTargetSelection()
+ */
+struct TargetSelection {
+  std::string cpu;
+  std::vector<std::string> features;
+};
+
+/**
+ * @brief detects cpu and features of the machine we are running on, the
+ * features are the ones the os reports as usable, so avx2 and fma are
+ * there only if both the cpu and the os support them
+ */
+TargetSelection hostTargetSelection();
+
+/**
+ * @brief fills what the selection leaves empty with the host values, an
+ * explicit cpu keeps its own default features unless some are given
+ * @param selection: user override, possibly empty
+ * @return the selection to hand to the target machine
+ */
+TargetSelection resolveTargetSelection(const TargetSelection &selection);
+
+/**
+ * @brief creates a target machine for the native triple, the native target
+ * must have been initialized already, llvm::InitializeNativeTarget()
+ * @param selection: cpu and features, empty fields mean the host ones
+ * @param level: optimization level, mapped with toCodeGenLevel()
+ * @param error: filled when the native target is not available
+ * @return the target machine, nullptr on failure
+ */
+std::unique_ptr<llvm::TargetMachine>
+createTargetMachine(const TargetSelection &selection, OptLevel level,
+                    std::string *error);
+
+/** @brief the level of the backend matching the one of the IR pipeline */
+llvm::CodeGenOpt::Level toCodeGenLevel(OptLevel level);
+
+} // namespace codegen
+} // namespace babycpp
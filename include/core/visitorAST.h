@@ -0,0 +1,147 @@
+#pragma once
+#include "AST.h"
+
+namespace babycpp {
+namespace codegen {
+
+/**
+ * @brief base class for passes walking the AST
+ * The dispatch is a switch on the nodetype tag rather than a virtual
+ * call, the concrete pass is known at compile time (CRTP) so the
+ * compiler can inline the visit functions in the switch.
+ * A pass derives from VisitorAST<MyPass, ReturnType> and hides the visit
+ * functions of the nodes it is interested in, every node it does not
+ * handle ends up in visitNode(), which by default returns a value
+ * initialized ReturnType.
+ * The visitor does not recurse on its own, a pass decides if and when to
+ * visit the children, forEachChild() can be used for that
+ */
+template <typename Derived, typename ReturnType = void> struct VisitorAST {
+  /**
+   * @brief dispatches the node to the visit function of its type
+   * @param node: the node to visit, can't be null
+   * @return whatever the visit function returned
+   */
+  ReturnType visit(ExprAST *node) {
+    Derived *self = static_cast<Derived *>(this);
+    switch (node->nodetype) {
+    case NumberNode:
+      return self->visitNumber(static_cast<NumberExprAST *>(node));
+    case VariableNode:
+      return self->visitVariable(static_cast<VariableExprAST *>(node));
+    case BinaryNode:
+      return self->visitBinary(static_cast<BinaryExprAST *>(node));
+    case CallNode:
+      return self->visitCall(static_cast<CallExprAST *>(node));
+    case PrototypeNode:
+      return self->visitPrototype(static_cast<PrototypeAST *>(node));
+    case FunctionNode:
+      return self->visitFunction(static_cast<FunctionAST *>(node));
+    case IfNode:
+      return self->visitIf(static_cast<IfAST *>(node));
+    case ForNode:
+      return self->visitFor(static_cast<ForAST *>(node));
+    case DereferenceNode:
+      return self->visitDereference(static_cast<DereferenceAST *>(node));
+    case ToPointerAssigmentNode:
+      return self->visitToPointerAssigment(
+          static_cast<ToPointerAssigmentAST *>(node));
+    case CastASTNode:
+      return self->visitCast(static_cast<CastAST *>(node));
+    default:
+      return self->visitNode(node);
+    }
+  }
+
+  // default implementations, all falling back to visitNode
+  ReturnType visitNode(ExprAST *) { return ReturnType(); }
+  ReturnType visitNumber(NumberExprAST *node) { return forward(node); }
+  ReturnType visitVariable(VariableExprAST *node) { return forward(node); }
+  ReturnType visitBinary(BinaryExprAST *node) { return forward(node); }
+  ReturnType visitCall(CallExprAST *node) { return forward(node); }
+  ReturnType visitPrototype(PrototypeAST *node) { return forward(node); }
+  ReturnType visitFunction(FunctionAST *node) { return forward(node); }
+  ReturnType visitIf(IfAST *node) { return forward(node); }
+  ReturnType visitFor(ForAST *node) { return forward(node); }
+  ReturnType visitDereference(DereferenceAST *node) { return forward(node); }
+  ReturnType visitToPointerAssigment(ToPointerAssigmentAST *node) {
+    return forward(node);
+  }
+  ReturnType visitCast(CastAST *node) { return forward(node); }
+
+private:
+  ReturnType forward(ExprAST *node) {
+    return static_cast<Derived *>(this)->visitNode(node);
+  }
+};
+
+/**
+ * @brief calls the given function on every direct child of the node, in
+ * source order, null children (like a missing else) are skipped
+ * @param node: the node whose children we want to walk
+ * @param func: callable taking an ExprAST*
+ */
+template <typename F> void forEachChild(ExprAST *node, F &&func) {
+  auto call = [&func](ExprAST *child) {
+    if (child != nullptr) {
+      func(child);
+    }
+  };
+  switch (node->nodetype) {
+  case VariableNode:
+    call(static_cast<VariableExprAST *>(node)->value);
+    break;
+  case BinaryNode: {
+    auto *bin = static_cast<BinaryExprAST *>(node);
+    call(bin->lhs);
+    call(bin->rhs);
+    break;
+  }
+  case CallNode:
+    for (ExprAST *arg : static_cast<CallExprAST *>(node)->args) {
+      call(arg);
+    }
+    break;
+  case FunctionNode: {
+    auto *function = static_cast<FunctionAST *>(node);
+    call(function->proto);
+    for (ExprAST *statement : function->body) {
+      call(statement);
+    }
+    break;
+  }
+  case IfNode: {
+    auto *ifNode = static_cast<IfAST *>(node);
+    call(ifNode->condition);
+    for (ExprAST *statement : ifNode->ifExpr) {
+      call(statement);
+    }
+    for (ExprAST *statement : ifNode->elseExpr) {
+      call(statement);
+    }
+    break;
+  }
+  case ForNode: {
+    auto *forNode = static_cast<ForAST *>(node);
+    call(forNode->initialization);
+    call(forNode->condition);
+    call(forNode->increment);
+    for (ExprAST *statement : forNode->body) {
+      call(statement);
+    }
+    break;
+  }
+  case ToPointerAssigmentNode:
+    call(static_cast<ToPointerAssigmentAST *>(node)->rhs);
+    break;
+  case CastASTNode:
+    call(static_cast<CastAST *>(node)->rhs);
+    break;
+  default:
+    // numbers, prototypes and dereferences are leaves
+    break;
+  }
+}
+
+} // namespace codegen
+} // namespace babycpp
@@ -1,54 +1,169 @@
 #pragma once
 #include "codegen.h"
+#include "targetSelection.h"
 
-#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
-#include <llvm/ExecutionEngine/Orc/IRCompileLayer.h>
-#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
-#include <llvm/IR/Mangler.h>
+#include <llvm/ExecutionEngine/JITSymbol.h>
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/Target/TargetMachine.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace babycpp {
 namespace jit {
 
+/** @brief how the jit compiles the modules it is given */
+struct JITOptions {
+  /** optimization level of the modules added, the IR pipeline runs before
+   * compiling and the same level is used by the backend */
+  codegen::OptLevel level = codegen::OptLevel::O0;
+  /** cpu and features to generate code for, by default the ones of the
+   * host, so avx2 and fma get used when available */
+  codegen::TargetSelection target;
+  /** if true every function gets compiled the first time it is called,
+   * until then it is just a stub, see addModule() */
+  bool lazy = false;
+  /** how many threads compile the modules, 0 means everything is compiled
+   * on the thread asking for it, see addModules() */
+  uint32_t compileThreads = 0;
+  /** if true functions are first compiled at O0 with the fast instruction
+   * selector and counted, the ones called more than hotThreshold times
+   * are recompiled at hotLevel on a background thread. level and lazy
+   * are ignored */
+  bool tiered = false;
+  uint32_t hotThreshold = 1000;
+  codegen::OptLevel hotLevel = codegen::OptLevel::O3;
+};
+
+/**
+ * @brief jit built on the ORC LLJIT stack
+ * Modules are copied in a context of their own when added, so the module
+ * of the code generator can keep being used and, with compile threads,
+ * different modules get optimized and compiled concurrently
+ */
 class BabycppJIT {
 public:
-  explicit BabycppJIT();
+  explicit BabycppJIT(const JITOptions &options = JITOptions());
+  ~BabycppJIT();
+  BabycppJIT(const BabycppJIT &) = delete;
+  BabycppJIT &operator=(const BabycppJIT &) = delete;
+
+  /** tracks what has been compiled out of a module, to remove it */
+  using ModuleHandle = llvm::orc::ResourceTrackerSP;
 
   // data
 private:
-  // here we had to initialize everything as pointers, so we can initalize them
-  // in the constructor and do explicit initialization of the native machine
-  // assembler etc, if we doit outside the class for some reason did not work
-  const llvm::DataLayout *datalayout;
-  llvm::orc::RTDyldObjectLinkingLayer *objectLayer;
-  llvm::orc::IRCompileLayer<llvm::orc::RTDyldObjectLinkingLayer,
-                            llvm::orc::SimpleCompiler> *compileLayer;
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+  // same object of jit, only in lazy mode
+  llvm::orc::LLLazyJIT *lazyJit = nullptr;
+  llvm::orc::JITTargetMachineBuilder targetBuilder;
+  // used by the optimizer when compiling on the calling thread
   std::unique_ptr<llvm::TargetMachine> tm;
+  // guards optimizer and tm, without compile threads lazy compiles can
+  // still come from any thread calling a stub
+  std::mutex optimizerMutex;
+
+  /** a function of a tiered module, every call goes through its stub */
+  struct TieredFunction {
+    // name in the module and mangled name, the one of the stub
+    std::string name;
+    std::string stubName;
+    // the module as it was added, recompiled when the function gets hot
+    std::shared_ptr<const llvm::SmallVector<char, 0>> bitcode;
+    // the module it comes from and, once hot, its optimized version
+    ModuleHandle handle;
+    ModuleHandle optimized;
+    bool queued = false;
+  };
+  // tiering state, everything below is guarded by tierMutex
+  std::unique_ptr<llvm::orc::IndirectStubsManager> stubs;
+  llvm::orc::JITTargetMachineBuilder hotTargetBuilder;
+  std::vector<TieredFunction> tieredFunctions;
+  std::deque<uint32_t> tierQueue;
+  bool tierBusy = false;
+  bool stopTiering = false;
+  std::mutex tierMutex;
+  std::condition_variable tierCondition;
+  std::condition_variable tierIdle;
+  std::thread tierThread;
+
+  llvm::Expected<llvm::orc::ThreadSafeModule>
+  readModule(const llvm::SmallVector<char, 0> &bitcode, llvm::StringRef name);
+  void optimizeModule(llvm::Module *m);
+  ModuleHandle addModuleImpl(const std::shared_ptr<llvm::Module> &m,
+                             std::vector<llvm::orc::SymbolStringPtr> *defined);
+  llvm::Error addTieredModule(llvm::orc::ThreadSafeModule tsm,
+                              const ModuleHandle &handle,
+                              std::shared_ptr<const llvm::SmallVector<char, 0>>
+                                  bitcode,
+                              std::vector<llvm::orc::SymbolStringPtr> *defined);
+  llvm::Expected<llvm::JITTargetAddress>
+  compileHot(const TieredFunction &function, const ModuleHandle &handle);
+  void tierLoop();
+  static void tierUpCallback(void *self, uint32_t index);
 
 public:
-  using ModuleHandle =
-      llvm::orc::IRCompileLayer<llvm::orc::RTDyldObjectLinkingLayer,
-                                llvm::orc::SimpleCompiler>::ModuleHandleT;
+  /** cpu and features the code is generated for, after host detection */
+  codegen::TargetSelection target;
+  /** whether functions are compiled on their first call */
+  const bool lazy;
+  const uint32_t compileThreads;
+  const bool tiered;
+  const uint32_t hotThreshold;
+  const codegen::OptLevel hotLevel;
+  /** how many hot functions have been swapped with the optimized ones */
+  std::atomic<uint32_t> hotFunctions{0};
+  /** how many functions got compiled, in lazy mode only the called ones */
+  std::atomic<uint32_t> compiledFunctions{0};
+  /** runs on every module before it gets compiled, its stats hold the
+   * time spent optimizing, it uses the target machine of the jit. With
+   * compile threads every module is optimized by a copy with the same
+   * settings and its own target machine, the stats are then merged here */
+  codegen::Optimizer optimizer;
+
+  /**
+   * @brief adds the module to the jit, by default compilation happens
+   * right away; in lazy mode every function is replaced by a stub that
+   * compiles the function on its first call, so a module with many
+   * functions costs only what is actually called
+   * @param m: module to compile, it is copied, so it can keep changing.
+   * To add a new version of a module, remove the previous one with its
+   * handle first, the same functions can't be defined twice
+   * @return handle to remove the module, nullptr if it could not be added
+   */
   ModuleHandle addModule(std::shared_ptr<llvm::Module> m);
+  /**
+   * @brief same as addModule but all the modules are added before
+   * compiling, with compile threads they are compiled concurrently
+   */
+  std::vector<ModuleHandle>
+  addModules(const std::vector<std::shared_ptr<llvm::Module>> &modules);
 
-  inline llvm::JITSymbol findSymbol(const std::string Name) {
-    std::string MangledName;
-    llvm::raw_string_ostream MangledNameStream(MangledName);
-    llvm::Mangler::getNameWithPrefix(MangledNameStream, Name, *datalayout);
-    // here the false is really important, it stands for exportedSymbol only.
-    // if you have that set to true, you won't be able to find symbols on
-    // windows  since they are not exported by default.
-    return compileLayer->findSymbol(MangledNameStream.str(), false);
-  }
+  /** @brief finds a compiled function by its name, the symbol is null if
+   * there is no such function */
+  llvm::JITSymbol findSymbol(const std::string Name);
 
   inline llvm::JITTargetAddress getSymbolAddress(const std::string Name) {
     return cantFail(findSymbol(Name).getAddress());
   }
 
-  inline void removeModule(ModuleHandle h) {
-    llvm::cantFail(compileLayer->removeModule(h));
-  }
+  /** @brief removes the code compiled out of a module, the handle is
+   * the one returned when the module was added */
+  void removeModule(ModuleHandle h);
+
+  /** @brief blocks until the hot functions found so far have been
+   * recompiled and swapped in, does nothing if the jit is not tiered */
+  void waitForTiering();
 };
 
 } // namespace jit
-} // namespace babycpp
\ No newline at end of file
+} // namespace babycpp
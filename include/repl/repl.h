@@ -1,4 +1,7 @@
 #pragma once
+#include "jit.h"
+
+#include <memory>
 
 namespace babycpp {
 
@@ -9,9 +12,6 @@ struct Lexer;
 namespace codegen {
 struct Codegenerator;
 }
-namespace jit {
-class BabycppJIT;
-}
 
 namespace repl {
 
@@ -52,9 +52,13 @@ void handleExpression(codegen::Codegenerator *gen, jit::BabycppJIT *jit,
 * @param anonymousModule: module containing the anonymous expression code
 * @param staticModule: this module will contain all the defined functions that
                        can be used in expressions
+* @param staticHandle: handle of the static module in the jit, its code gets
+                       replaced by the new version of the module and the
+                       handle updated
 */
 void handleFunction(codegen::Codegenerator *gen, jit::BabycppJIT *jit,
                     std::shared_ptr<llvm::Module> anonymousModule,
-                    std::shared_ptr<llvm::Module> staticModule);
+                    std::shared_ptr<llvm::Module> staticModule,
+                    jit::BabycppJIT::ModuleHandle *staticHandle);
 } // namespace repl
 } // namespace babycpp
\ No newline at end of file
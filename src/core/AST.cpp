@@ -1,5 +1,6 @@
 #include "AST.h"
 #include "codegen.h"
+#include "visitorAST.h"
 
 #include <iostream>
 #include <llvm/IR/Verifier.h>
@@ -20,6 +21,32 @@ inline void logCodegenError(const std::string &msg, Codegenerator *codegen,
 }
 
 using llvm::Value;
+
+namespace {
+// first client of VisitorAST, forwards every node to its own codegen
+struct CodegenVisitor : VisitorAST<CodegenVisitor, Value *> {
+  explicit CodegenVisitor(Codegenerator *ingen) : gen(ingen) {}
+  Value *visitNumber(NumberExprAST *node) { return node->codegen(gen); }
+  Value *visitVariable(VariableExprAST *node) { return node->codegen(gen); }
+  Value *visitBinary(BinaryExprAST *node) { return node->codegen(gen); }
+  Value *visitCall(CallExprAST *node) { return node->codegen(gen); }
+  Value *visitPrototype(PrototypeAST *node) { return node->codegen(gen); }
+  Value *visitFunction(FunctionAST *node) { return node->codegen(gen); }
+  Value *visitIf(IfAST *node) { return node->codegen(gen); }
+  Value *visitFor(ForAST *node) { return node->codegen(gen); }
+  Value *visitDereference(DereferenceAST *node) { return node->codegen(gen); }
+  Value *visitToPointerAssigment(ToPointerAssigmentAST *node) {
+    return node->codegen(gen);
+  }
+  Value *visitCast(CastAST *node) { return node->codegen(gen); }
+
+  Codegenerator *gen;
+};
+} // namespace
+
+Value *ExprAST::codegen(Codegenerator *gen) {
+  return CodegenVisitor(gen).visit(this);
+}
 Value *NumberExprAST::codegen(Codegenerator *gen) {
 
   if (val.type == Token::tok_float) {
@@ -39,10 +66,10 @@ llvm::Value *VariableExprAST::codegen(Codegenerator *gen) {
   // first we try to see if the variable is already defined at scope
   // level
   llvm::AllocaInst *v = nullptr;
-  auto found = gen->namedValues.find(name);
-  if (found != gen->namedValues.end()) {
-    v = found->second;
-    auto &storeDatatype = gen->variableTypes[name];
+  nameId = gen->resolveSymbol(nameId, name);
+  if (gen->namedValues.contains(nameId)) {
+    v = gen->namedValues.lookup(nameId);
+    auto &storeDatatype = gen->variableTypes[nameId];
     datatype = storeDatatype.datatype;
     flags.isPointer = storeDatatype.isPointer;
     flags.isNull = storeDatatype.isNull;
@@ -51,7 +78,7 @@ llvm::Value *VariableExprAST::codegen(Codegenerator *gen) {
   // if we get a nullptr and the variable is not a definition
   // we got an error
   if (v == nullptr && datatype == 0) {
-    logCodegenError("Error variable " + name + " not defined", gen,
+    logCodegenError("Error variable " + name.str() + " not defined", gen,
                     IssueCode::UNDEFINED_VARIABLE);
     return nullptr;
   }
@@ -62,8 +89,8 @@ llvm::Value *VariableExprAST::codegen(Codegenerator *gen) {
                                   gen->currentScope->getEntryBlock().begin());
     llvm::Type *varType = getType(datatype, gen, flags.isPointer);
     v = tempBuilder.CreateAlloca(varType, nullptr, name);
-    gen->namedValues[name] = v;
-    gen->variableTypes[name] = {datatype, flags.isPointer, flags.isNull};
+    gen->namedValues[nameId] = v;
+    gen->variableTypes[nameId] = {datatype, flags.isPointer, flags.isNull};
 
     if (value == nullptr) {
       std::cout << "error: expected value for value definition" << std::endl;
@@ -106,8 +133,8 @@ llvm::Value *VariableExprAST::codegen(Codegenerator *gen) {
 
       // TODO(giordi) I really don't like that, I need to start having a proper
       // datatype around I can use and rely on FIX THIS WHEN POSSIBLE
-      if (gen->variableTypes.find(name) != gen->variableTypes.end()) {
-        auto currPtrType = gen->variableTypes[name];
+      if (gen->variableTypes.contains(nameId)) {
+        auto currPtrType = gen->variableTypes.lookup(nameId);
         datatype = currPtrType.datatype;
         flags.isPointer = currPtrType.isPointer;
         flags.isNull = currPtrType.isNull;
@@ -141,56 +168,163 @@ llvm::Value *VariableExprAST::codegen(Codegenerator *gen) {
     return gen->builder.CreateStore(valGen, v);
   }
   // otherwise we just generate the load
-  return gen->builder.CreateLoad(v, name.c_str());
+  return gen->builder.CreateLoad(v->getAllocatedType(), v, name);
+}
+
+// converts a value to a i1 for logical operators
+Value *toBoolean(Value *v, Codegenerator *gen) {
+  llvm::Type *type = v->getType();
+  if (type->isIntegerTy(1)) {
+    return v;
+  }
+  if (type->isFloatingPointTy()) {
+    return gen->builder.CreateFCmpONE(
+        v, llvm::ConstantFP::get(type, 0.0), "tobool");
+  }
+  return gen->builder.CreateICmpNE(v, llvm::ConstantInt::get(type, 0),
+                                   "tobool");
+}
+
+// comparisons and logical operators produce an i1, widen it to the i32
+// backing tok_int so the result can be stored or combined like any int
+Value *toInt(Value *v, Codegenerator *gen) {
+  return gen->builder.CreateZExt(v, llvm::Type::getInt32Ty(gen->context),
+                                 "booltmp");
 }
 
 Value *handleBinOpSimpleDatatype(BinaryExprAST *bin, Codegenerator *gen,
                                  llvm::Value *L, llvm::Value *R) {
+  using parser::BinaryOp;
   bin->datatype = gen->omogenizeOperation(bin->lhs, bin->rhs, &L, &R);
+  const BinaryOp op =
+      parser::findBinaryOperator(bin->op.data(), bin->op.size());
 
   if (bin->datatype == Token::tok_float) {
     // checking the operator to generate the correct operation
-    if (bin->op == "+") {
+    llvm::CmpInst::Predicate predicate;
+    switch (op) {
+    case parser::OP_ADD:
       return gen->builder.CreateFAdd(L, R, "addtmp");
-    }
-    if (bin->op == "-") {
+    case parser::OP_SUB:
       return gen->builder.CreateFSub(L, R, "subtmp");
-    }
-    if (bin->op == "*") {
+    case parser::OP_MUL:
       return gen->builder.CreateFMul(L, R, "multmp");
-    }
-    if (bin->op == "/") {
+    case parser::OP_DIV:
       return gen->builder.CreateFDiv(L, R, "divtmp");
+    case parser::OP_MOD:
+      return gen->builder.CreateFRem(L, R, "modtmp");
+    case parser::OP_LESS:
+      predicate = llvm::CmpInst::FCMP_OLT;
+      break;
+    case parser::OP_LESS_EQUAL:
+      predicate = llvm::CmpInst::FCMP_OLE;
+      break;
+    case parser::OP_GREATER:
+      predicate = llvm::CmpInst::FCMP_OGT;
+      break;
+    case parser::OP_GREATER_EQUAL:
+      predicate = llvm::CmpInst::FCMP_OGE;
+      break;
+    case parser::OP_EQUAL:
+      predicate = llvm::CmpInst::FCMP_OEQ;
+      break;
+    case parser::OP_NOT_EQUAL:
+      // unordered so that NaN != x holds
+      predicate = llvm::CmpInst::FCMP_UNE;
+      break;
+    default:
+      // no bitwise or shift on floats
+      return nullptr;
     }
-    if (bin->op == "<") {
-      // TODO(giordi) fix this, to return int?
-      L = gen->builder.CreateFCmpULT(L, R, "cmptmp");
-      return gen->builder.CreateUIToFP(L, llvm::Type::getDoubleTy(gen->context),
-                                       "booltmp");
-    }
+    bin->datatype = Token::tok_int;
+    return toInt(gen->builder.CreateFCmp(predicate, L, R, "cmptmp"), gen);
+  }
+
+  // checking the operator to generate the correct operation
+  switch (op) {
+  case parser::OP_ADD:
+    return gen->builder.CreateAdd(L, R, "addtmp");
+  case parser::OP_SUB:
+    return gen->builder.CreateSub(L, R, "subtmp");
+  case parser::OP_MUL:
+    return gen->builder.CreateMul(L, R, "multmp");
+  case parser::OP_DIV:
+    return gen->builder.CreateSDiv(L, R, "divtmp");
+  case parser::OP_MOD:
+    return gen->builder.CreateSRem(L, R, "modtmp");
+  case parser::OP_SHL:
+    return gen->builder.CreateShl(L, R, "shltmp");
+  case parser::OP_SHR:
+    return gen->builder.CreateAShr(L, R, "shrtmp");
+  case parser::OP_BIT_AND:
+    return gen->builder.CreateAnd(L, R, "andtmp");
+  case parser::OP_BIT_XOR:
+    return gen->builder.CreateXor(L, R, "xortmp");
+  case parser::OP_BIT_OR:
+    return gen->builder.CreateOr(L, R, "ortmp");
+  case parser::OP_LESS:
+    return toInt(gen->builder.CreateICmpSLT(L, R, "cmptmp"), gen);
+  case parser::OP_LESS_EQUAL:
+    return toInt(gen->builder.CreateICmpSLE(L, R, "cmptmp"), gen);
+  case parser::OP_GREATER:
+    return toInt(gen->builder.CreateICmpSGT(L, R, "cmptmp"), gen);
+  case parser::OP_GREATER_EQUAL:
+    return toInt(gen->builder.CreateICmpSGE(L, R, "cmptmp"), gen);
+  case parser::OP_EQUAL:
+    return toInt(gen->builder.CreateICmpEQ(L, R, "cmptmp"), gen);
+  case parser::OP_NOT_EQUAL:
+    return toInt(gen->builder.CreateICmpNE(L, R, "cmptmp"), gen);
+  default:
+    return nullptr;
+  }
+}
+
+// && and || only evaluate the RHS when the LHS does not already decide
+// the result, so they need their own blocks
+Value *handleLogicalOperator(BinaryExprAST *bin, Codegenerator *gen,
+                             bool isAnd) {
+  Value *L = bin->lhs->codegen(gen);
+  if (L == nullptr) {
+    return nullptr;
+  }
+  L = toBoolean(L, gen);
+
+  llvm::BasicBlock *lhsBlock = gen->builder.GetInsertBlock();
+  llvm::Function *function = lhsBlock->getParent();
+  llvm::BasicBlock *rhsBlock =
+      llvm::BasicBlock::Create(gen->context, "logicrhs", function);
+  llvm::BasicBlock *mergeBlock =
+      llvm::BasicBlock::Create(gen->context, "logicmerge", function);
+  if (isAnd) {
+    gen->builder.CreateCondBr(L, rhsBlock, mergeBlock);
   } else {
-    // checking the operator to generate the correct operation
-    if (bin->op == "+") {
-      return gen->builder.CreateAdd(L, R, "addtmp");
-    }
-    if (bin->op == "-") {
-      return gen->builder.CreateSub(L, R, "subtmp");
-    }
-    if (bin->op == "*") {
-      return gen->builder.CreateMul(L, R, "multmp");
-    }
-    if (bin->op == "/") {
-      return gen->builder.CreateSDiv(L, R, "divtmp");
-    }
-    if (bin->op == "<") {
-      L = gen->builder.CreateICmpULT(L, R, "cmptmp");
-      return L;
-    }
+    gen->builder.CreateCondBr(L, mergeBlock, rhsBlock);
   }
-  return nullptr;
+
+  gen->builder.SetInsertPoint(rhsBlock);
+  Value *R = bin->rhs->codegen(gen);
+  if (R == nullptr) {
+    return nullptr;
+  }
+  R = toBoolean(R, gen);
+  // the RHS might have created blocks of its own
+  rhsBlock = gen->builder.GetInsertBlock();
+  gen->builder.CreateBr(mergeBlock);
+
+  gen->builder.SetInsertPoint(mergeBlock);
+  llvm::PHINode *phi =
+      gen->builder.CreatePHI(llvm::Type::getInt1Ty(gen->context), 2, "logictmp");
+  phi->addIncoming(isAnd ? gen->builder.getFalse() : gen->builder.getTrue(),
+                   lhsBlock);
+  phi->addIncoming(R, rhsBlock);
+  bin->datatype = Token::tok_int;
+  return toInt(phi, gen);
 }
 
 llvm::Value *BinaryExprAST::codegen(Codegenerator *gen) {
+  if (op == "&&" || op == "||") {
+    return handleLogicalOperator(this, gen, op == "&&");
+  }
   // generating code recursively for left and right end side
   Value *L = lhs->codegen(gen);
   Value *R = rhs->codegen(gen);
@@ -215,7 +349,7 @@ llvm::Value *BinaryExprAST::codegen(Codegenerator *gen) {
     if (op != "+") {
       logCodegenError(
           "unsupporter operator for pointer arithmetic only valid is +, got: " +
-              op,
+              op.str(),
           gen, IssueCode::POINTER_ARITHMETIC_ERROR);
       return nullptr;
     }
@@ -224,7 +358,8 @@ llvm::Value *BinaryExprAST::codegen(Codegenerator *gen) {
     // be able to perform  math with it, only operator supported is + the time
     // being
     Value *indexList[1] = {R};
-    return gen->builder.CreateGEP(L, llvm::ArrayRef<Value *>(indexList, 1),
+    return gen->builder.CreateGEP(L->getType()->getPointerElementType(), L,
+                                  llvm::ArrayRef<Value *>(indexList, 1),
                                   "pointerShift");
   }
 
@@ -268,7 +403,12 @@ llvm::Value *PrototypeAST::codegen(Codegenerator *gen) {
   // manually
   if (isExtern) {
     if (function != nullptr) {
-      gen->functionProtos[name] = this;
+      // prototypes can be read by generators on other threads, see
+      // generateInParallel, ids already resolved are not written again
+      if (nameId == symbol::INVALID_SYMBOL) {
+        nameId = gen->resolveSymbol(nameId, name);
+      }
+      gen->functionProtos[nameId] = this;
     }
   }
 
@@ -277,11 +417,16 @@ llvm::Value *PrototypeAST::codegen(Codegenerator *gen) {
 llvm::Value *FunctionAST::codegen(Codegenerator *gen) {
   // First, check for an existing function from a previous 'extern'
   // declaration.
-  llvm::Function *function = gen->getFunction(proto->name);
+  // prototypes can be read by generators on other threads, see
+  // generateInParallel, ids already resolved are not written again
+  if (proto->nameId == symbol::INVALID_SYMBOL) {
+    proto->nameId = gen->resolveSymbol(proto->nameId, proto->name);
+  }
+  llvm::Function *function = gen->getFunction(proto->nameId);
 
   if (function == nullptr) {
-    gen->functionProtos[proto->name] = proto;
-    function = gen->getFunction(proto->name);
+    gen->functionProtos[proto->nameId] = proto;
+    function = gen->getFunction(proto->nameId);
   }
   if (function == nullptr) {
     std::cout << "error generating prototype code gen" << std::endl;
@@ -313,8 +458,12 @@ llvm::Value *FunctionAST::codegen(Codegenerator *gen) {
     gen->builder.CreateStore(&arg, alloca);
 
     // Add arguments to variable symbol table.
-    gen->namedValues[arg.getName()] = alloca;
-    gen->variableTypes[arg.getName()] = {
+    Argument &astArg = proto->args[counter];
+    if (astArg.nameId == symbol::INVALID_SYMBOL) {
+      astArg.nameId = gen->resolveSymbol(astArg.nameId, astArg.name);
+    }
+    gen->namedValues[astArg.nameId] = alloca;
+    gen->variableTypes[astArg.nameId] = {
         proto->args[counter].type, proto->args[counter].isPointer,
         false}; // TODO(giordi) should pass argumetn as not null? we don't
                 // supprot  default values so can't be nullptr
@@ -359,12 +508,16 @@ llvm::Value *FunctionAST::codegen(Codegenerator *gen) {
     gen->module->print(llvm::errs(), nullptr);
     return nullptr;
   }
+  if (gen->optimizer.runPerFunction) {
+    gen->optimizer.optimizeFunction(function);
+  }
   return function;
 }
 llvm::Value *CallExprAST::codegen(Codegenerator *gen) {
   // lets try to get the function
   PrototypeAST *proto = nullptr;
-  llvm::Function *calleeF = gen->getFunction(callee, &proto);
+  calleeId = gen->resolveSymbol(calleeId, callee);
+  llvm::Function *calleeF = gen->getFunction(calleeId, &proto);
   if (calleeF == nullptr) {
     logCodegenError("error getting function, either is not defined or builtin "
                     "functions have not been loaded",
@@ -394,10 +547,10 @@ llvm::Value *CallExprAST::codegen(Codegenerator *gen) {
       // the only option here is that is actually a variable is scope
       if (args[t]->nodetype == VariableNode) {
         auto temp = static_cast<VariableExprAST *>(args[t]);
-        bool found =
-            gen->namedValues.find(temp->name) != gen->namedValues.end();
+        temp->nameId = gen->resolveSymbol(temp->nameId, temp->name);
+        bool found = gen->namedValues.contains(temp->nameId);
         if (found) {
-          auto &currDatatype = gen->variableTypes[temp->name];
+          auto &currDatatype = gen->variableTypes[temp->nameId];
           temp->datatype = currDatatype.datatype;
           temp->flags.isPointer = currDatatype.isPointer;
           temp->flags.isNull = currDatatype.isNull;
@@ -411,7 +564,8 @@ llvm::Value *CallExprAST::codegen(Codegenerator *gen) {
     }
     if (proto == nullptr) {
 
-      std::cout << "cannot check function arguments " << callee << std::endl;
+      std::cout << "cannot check function arguments " << callee.str()
+                << std::endl;
     } else {
       if (proto->args[t].type != args[t]->datatype ||
           proto->args[t].isPointer != args[t]->flags.isPointer) {
@@ -556,6 +710,13 @@ llvm::Value *ForAST::codegen(Codegenerator *gen) {
 
   // here we generate the condition and we evaluate
   Value *conditionValue = condition->codegen(gen);
+  if (conditionValue == nullptr) {
+    logCodegenError("Error in generating condition of the for loop", gen,
+                    IssueCode::FOR_LOOP_CODE_FAILURE);
+    return nullptr;
+  }
+  // comparisons yield an int, the branch wants an i1
+  conditionValue = toBoolean(conditionValue, gen);
   // Insert the conditional branch into the end of LoopEndBB.
   // here we valuate the condition for the first time, if it valid we
   // jump to the loop, otherwise we get out after the loop immediatly,
@@ -585,6 +746,12 @@ llvm::Value *ForAST::codegen(Codegenerator *gen) {
 
   // here we need to perform the check on the condition
   conditionValue = condition->codegen(gen);
+  if (conditionValue == nullptr) {
+    logCodegenError("Error in generating condition of the for loop", gen,
+                    IssueCode::FOR_LOOP_CODE_FAILURE);
+    return nullptr;
+  }
+  conditionValue = toBoolean(conditionValue, gen);
   // need to add the branch here
 
   // Create the "after loop" block and insert it.
@@ -603,19 +770,21 @@ llvm::Value *DereferenceAST::codegen(Codegenerator *gen) {
 
   // first we try to see if the variable is already defined at scope
   // level
-  llvm::AllocaInst *v = gen->namedValues[identifierName];
+  identifierId = gen->resolveSymbol(identifierId, identifierName);
+  llvm::AllocaInst *v = gen->namedValues.lookup(identifierId);
   // here we extract the variable from the scope.
   // if we get a nullptr and the variable is not a definition
   // we got an error
   if (v == nullptr && datatype == 0) {
-    logCodegenError("Error variable " + identifierName + "is not defined", gen,
-                    IssueCode::UNDEFINED_VARIABLE);
+    logCodegenError("Error variable " + identifierName.str() +
+                        "is not defined",
+                    gen, IssueCode::UNDEFINED_VARIABLE);
     return nullptr;
   }
 
   if (flags.isDefinition) {
 
-    logCodegenError("Error variable " + identifierName +
+    logCodegenError("Error variable " + identifierName.str() +
                         "is a definition cannot be dereferenced",
                     gen, IssueCode::EXPECTED_POINTER);
     return nullptr;
@@ -634,19 +803,22 @@ llvm::Value *DereferenceAST::codegen(Codegenerator *gen) {
 
   // here we first load the pointer to a register and then we load from that
   // pointer,  this hields a double load
-  Value *ptrLoaded = gen->builder.CreateLoad(v, identifierName.c_str());
+  Value *ptrLoaded =
+      gen->builder.CreateLoad(v->getAllocatedType(), v, identifierName);
   // now we loaded the pointer, what we are going to do is load from the
   // pionter
-  return gen->builder.CreateLoad(ptrLoaded,
-                                 (identifierName + "Dereferenced").c_str());
+  return gen->builder.CreateLoad(
+      v->getAllocatedType()->getPointerElementType(), ptrLoaded,
+      identifierName + "Dereferenced");
 }
 
 llvm::Value *ToPointerAssigmentAST::codegen(Codegenerator *gen) {
 
   // to dereference a pointer it means it must be defined already
-  llvm::AllocaInst *v = gen->namedValues[identifierName];
+  identifierId = gen->resolveSymbol(identifierId, identifierName);
+  llvm::AllocaInst *v = gen->namedValues.lookup(identifierId);
   if (v == nullptr) {
-    logCodegenError("Error pointer variable" + identifierName +
+    logCodegenError("Error pointer variable" + identifierName.str() +
                         "is not defined",
                     gen, IssueCode::UNDEFINED_VARIABLE);
     return nullptr;
@@ -661,7 +833,7 @@ llvm::Value *ToPointerAssigmentAST::codegen(Codegenerator *gen) {
   }
   // updating the datatype
   if (datatype == 0) {
-    auto &currDatatype = gen->variableTypes[identifierName];
+    auto &currDatatype = gen->variableTypes[identifierId];
     datatype = currDatatype.datatype;
     flags.isPointer = currDatatype.isPointer;
     flags.isNull = currDatatype.isNull;
@@ -679,8 +851,8 @@ llvm::Value *ToPointerAssigmentAST::codegen(Codegenerator *gen) {
   }
 
   // we can now proceed with the store
-  Value *ptrLoaded =
-      gen->builder.CreateLoad(v, (identifierName + "Dereferenced").c_str());
+  Value *ptrLoaded = gen->builder.CreateLoad(v->getAllocatedType(), v,
+                                             identifierName + "Dereferenced");
   return gen->builder.CreateStore(rhsValue, ptrLoaded);
 }
 
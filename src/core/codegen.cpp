@@ -1,4 +1,5 @@
 #include "codegen.h"
+#include "parallelCodegen.h"
 #include <iostream>
 
 #include <llvm/IR/Verifier.h>
@@ -15,7 +16,7 @@ const std::unordered_map<int, int> Codegenerator::AST_LLVM_MAP{
 
 llvm::AllocaInst *
 Codegenerator::createEntryBlockAlloca(llvm::Function *function,
-                                      const std::string &varName, int type,
+                                      llvm::StringRef varName, int type,
                                       bool isPointer) {
   llvm::IRBuilder<> tempBuilder(&function->getEntryBlock(),
                                 function->getEntryBlock().begin());
@@ -48,11 +49,36 @@ void Codegenerator::doLoadBuiltinFunctions() {
   mallocFunc->flags.isPointer = true;
   freeFunc->flags.isPointer = false;
   freeFunc->flags.isNull= true;
-  builtInFunctions["malloc"] = mallocFunc;
-  builtInFunctions["free"] = freeFunc;
+  mallocFunc->nameId = lexer.symbols.intern("malloc");
+  freeFunc->nameId = lexer.symbols.intern("free");
+  builtInFunctions[mallocFunc->nameId] = mallocFunc;
+  builtInFunctions[freeFunc->nameId] = freeFunc;
+  builtinFunctionsLoaded = true;
+}
+
+void Codegenerator::reset() {
+  // the builtin prototypes live in the factory, they go away with it
+  functionProtos.clear();
+  builtInFunctions.clear();
+  namedValues.clear();
+  variableTypes.clear();
+  currentScope = nullptr;
+  parseWorkers.clear();
+  factory.clear();
+  diagnostic.clear();
+  parser.recoverFromErrors = false;
+  parser.flags.processed_assigment = false;
+
+  builder.ClearInsertionPoint();
+  optimizer.clearPipelines();
+  module = std::make_shared<llvm::Module>("", context);
+  if (builtinFunctionsLoaded) {
+    doLoadBuiltinFunctions();
+  }
 }
 
 void Codegenerator::setCurrentModule(std::shared_ptr<llvm::Module> mod) {
+  optimizer.clearPipelines();
   module = mod;
 }
 
@@ -117,23 +143,22 @@ std::string Codegenerator::printDiagnostic() {
   return diagnosticMessage;
 }
 
-llvm::Function *Codegenerator::getFunction(const std::string &name,
+llvm::Function *Codegenerator::getFunction(symbol::SymbolId id,
                                            PrototypeAST **returnProto) {
+  if (id == symbol::INVALID_SYMBOL) {
+    return nullptr;
+  }
   // First, see if the function has already been added to the current module.
-  if (auto *F = module->getFunction(name)) {
+  if (auto *F = module->getFunction(lexer.symbols.getName(id))) {
 
     if (returnProto != nullptr) {
       // trying to find the prototype
-      auto FI = functionProtos.find(name);
-      if (FI != functionProtos.end()) {
-        *returnProto = FI->second;
-      } else {
-        FI = builtInFunctions.find(name);
-        if (FI != builtInFunctions.end()) {
-            *returnProto = FI->second;
-          }
-        }
+      if (functionProtos.contains(id)) {
+        *returnProto = functionProtos.lookup(id);
+      } else if (builtInFunctions.contains(id)) {
+        *returnProto = builtInFunctions.lookup(id);
       }
+    }
 	else
 	{
 		std::cout << "cannot return proto pointer is null" << std::endl;
@@ -143,22 +168,22 @@ llvm::Function *Codegenerator::getFunction(const std::string &name,
 
     // If not, check whether we can codegen the declaration from some existing
     // prototype.
-    auto FI = functionProtos.find(name);
-    if (FI != functionProtos.end()) {
-      auto *f = FI->second->codegen(this);
+    PrototypeAST *proto = functionProtos.lookup(id);
+    if (proto != nullptr) {
+      auto *f = proto->codegen(this);
       if (returnProto != nullptr)
-        *returnProto = FI->second;
+        *returnProto = proto;
       if (f == nullptr) {
         return nullptr;
       }
       return static_cast<llvm::Function *>(f);
     }
     // lets check the built in functions
-    FI = builtInFunctions.find(name);
-    if (FI != builtInFunctions.end()) {
-      auto *f = FI->second->codegen(this);
+    proto = builtInFunctions.lookup(id);
+    if (proto != nullptr) {
+      auto *f = proto->codegen(this);
       if (returnProto != nullptr)
-        *returnProto = FI->second;
+        *returnProto = proto;
       if (f == nullptr) {
         return nullptr;
       }
@@ -170,13 +195,61 @@ llvm::Function *Codegenerator::getFunction(const std::string &name,
   }
 
   void Codegenerator::generateModuleContent() {
-
+    // we want every error in the source out of a single pass
+    parser.recoverFromErrors = true;
     while (lexer.currtok != Token::tok_eof) {
+      const int errorsBefore = diagnostic.hasErrors();
       ExprAST *res = parser.parseStatement();
-      if (res != nullptr) {
+      // a recovered statement might still carry errors, we do not
+      // generate code for it
+      if (res != nullptr && diagnostic.hasErrors() == errorsBefore) {
         res->codegen(this);
+        continue;
+      }
+      if (lexer.currtok == Token::tok_no_match) {
+        // the lexer cannot go any further
+        break;
+      }
+      if (lexer.currtok == Token::tok_close_curly) {
+        // a stray } at top level, synchronize leaves it to the block
+        // parser and there is none
+        lexer.gettok();
+      }
+    }
+  }
+
+  void Codegenerator::generateModuleContentParallel(const std::string &source,
+                                                    uint32_t workerCount,
+                                                    bool parallelCodegen) {
+    auto workers = parser::parseInParallel(source, workerCount,
+                                           &lexer.symbols, factory.hashConsing);
+    std::vector<ExprAST *> statements;
+    for (auto &worker : workers) {
+      // errors are reported in source order, as a single pass would
+      while (worker->diagnostic.hasErrors()) {
+        diagnostic::Issue issue = worker->diagnostic.getError();
+        diagnostic.pushError(issue);
+      }
+      statements.insert(statements.end(), worker->statements.begin(),
+                        worker->statements.end());
+      if (worker->stoppedEarly) {
+        break;
+      }
+    }
+    // functionProtos keeps pointing in the AST of the previous calls, so
+    // their workers stay alive until reset()
+    for (auto &worker : workers) {
+      parseWorkers.push_back(std::move(worker));
+    }
+
+    if (!parallelCodegen) {
+      for (ExprAST *statement : statements) {
+        statement->codegen(this);
       }
+      return;
     }
+    auto codegenWorkers = generateInParallel(this, statements, workerCount);
+    linkWorkerModules(this, &codegenWorkers);
   }
 
 } // namespace codegen
@@ -0,0 +1,512 @@
+#include "compactAST.h"
+#include "visitorAST.h"
+
+#include <llvm/ADT/SmallVector.h>
+
+#include <cassert>
+#include <cstring>
+
+namespace babycpp {
+namespace codegen {
+
+namespace {
+inline uint8_t packFlags(const ASTFlags &flags) {
+  return static_cast<uint8_t>((flags.isReturn ? FLAG_RETURN : 0) |
+                              (flags.isDefinition ? FLAG_DEFINITION : 0) |
+                              (flags.isPointer ? FLAG_POINTER : 0) |
+                              (flags.isNull ? FLAG_NULL : 0));
+}
+
+// walks the ExprAST tree bottom up, children are converted before their
+// parent so that lists of children end up contiguous in the shared array
+struct CompactConverter : VisitorAST<CompactConverter, NodeRef> {
+  CompactConverter(CompactAST *inast, symbol::SymbolTable *insymbols)
+      : ast(inast), symbols(insymbols) {}
+
+  // records are built field by field in zeroed memory, so that their
+  // padding is deterministic once the arrays are dumped as raw memory
+  template <typename T>
+  T &add(std::vector<T> *records, NodeType kind, NodeRef *ref) {
+    auto index = static_cast<uint32_t>(records->size());
+    assert(index <= CompactAST::INDEX_MASK);
+    records->emplace_back();
+    T &record = records->back();
+    memset(&record, 0, sizeof(T));
+    *ref = CompactAST::makeRef(kind, index);
+    return record;
+  }
+  NodeRef convert(ExprAST *node) {
+    return node != nullptr ? visit(node) : INVALID_NODE;
+  }
+  template <typename List> IndexRange convertList(const List &nodes) {
+    llvm::SmallVector<NodeRef, 16> converted;
+    for (ExprAST *node : nodes) {
+      converted.push_back(convert(node));
+    }
+    IndexRange range{static_cast<uint32_t>(ast->children.size()),
+                     static_cast<uint32_t>(converted.size())};
+    ast->children.insert(ast->children.end(), converted.begin(),
+                         converted.end());
+    return range;
+  }
+  symbol::SymbolId resolve(symbol::SymbolId id, llvm::StringRef name) {
+    return id != symbol::INVALID_SYMBOL ? id : symbols->intern(name);
+  }
+
+  NodeRef visitNumber(NumberExprAST *node) {
+    NodeRef ref;
+    CompactNumber &record = add(&ast->numbers, NumberNode, &ref);
+    record.val = node->val;
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+  NodeRef visitVariable(VariableExprAST *node) {
+    NodeRef value = convert(node->value);
+    NodeRef ref;
+    CompactVariable &record = add(&ast->variables, VariableNode, &ref);
+    record.name = resolve(node->nameId, node->name);
+    record.value = value;
+    record.datatype = node->datatype;
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+  NodeRef visitBinary(BinaryExprAST *node) {
+    NodeRef lhs = convert(node->lhs);
+    NodeRef rhs = convert(node->rhs);
+    NodeRef ref;
+    CompactBinary &record = add(&ast->binaries, BinaryNode, &ref);
+    record.lhs = lhs;
+    record.rhs = rhs;
+    record.datatype = node->datatype;
+    record.op = parser::findBinaryOperator(node->op.data(), node->op.size());
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+  NodeRef visitCall(CallExprAST *node) {
+    IndexRange args = convertList(node->args);
+    NodeRef ref;
+    CompactCall &record = add(&ast->calls, CallNode, &ref);
+    record.callee = resolve(node->calleeId, node->callee);
+    record.args = args;
+    record.datatype = node->datatype;
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+  NodeRef visitPrototype(PrototypeAST *node) {
+    IndexRange args{static_cast<uint32_t>(ast->arguments.size()),
+                    node->args.size()};
+    for (Argument &arg : node->args) {
+      CompactArgument compactArg;
+      memset(&compactArg, 0, sizeof(CompactArgument));
+      compactArg.name = resolve(arg.nameId, arg.name);
+      compactArg.datatype = arg.type;
+      compactArg.isPointer = arg.isPointer;
+      ast->arguments.push_back(compactArg);
+    }
+    NodeRef ref;
+    CompactPrototype &record = add(&ast->prototypes, PrototypeNode, &ref);
+    record.name = resolve(node->nameId, node->name);
+    record.args = args;
+    record.datatype = node->datatype;
+    record.isExtern = node->isExtern;
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+  NodeRef visitFunction(FunctionAST *node) {
+    NodeRef proto = convert(node->proto);
+    IndexRange body = convertList(node->body);
+    NodeRef ref;
+    CompactFunction &record = add(&ast->functions, FunctionNode, &ref);
+    record.proto = proto;
+    record.body = body;
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+  NodeRef visitIf(IfAST *node) {
+    NodeRef condition = convert(node->condition);
+    IndexRange ifBody = convertList(node->ifExpr);
+    IndexRange elseBody = convertList(node->elseExpr);
+    NodeRef ref;
+    CompactIf &record = add(&ast->ifs, IfNode, &ref);
+    record.condition = condition;
+    record.ifBody = ifBody;
+    record.elseBody = elseBody;
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+  NodeRef visitFor(ForAST *node) {
+    NodeRef initialization = convert(node->initialization);
+    NodeRef condition = convert(node->condition);
+    NodeRef increment = convert(node->increment);
+    IndexRange body = convertList(node->body);
+    NodeRef ref;
+    CompactFor &record = add(&ast->fors, ForNode, &ref);
+    record.initialization = initialization;
+    record.condition = condition;
+    record.increment = increment;
+    record.body = body;
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+  NodeRef visitDereference(DereferenceAST *node) {
+    NodeRef ref;
+    CompactDereference &record =
+        add(&ast->dereferences, DereferenceNode, &ref);
+    record.name = resolve(node->identifierId, node->identifierName);
+    record.datatype = node->datatype;
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+  NodeRef visitToPointerAssigment(ToPointerAssigmentAST *node) {
+    NodeRef rhs = convert(node->rhs);
+    NodeRef ref;
+    CompactToPointerAssigment &record =
+        add(&ast->toPointerAssigments, ToPointerAssigmentNode, &ref);
+    record.name = resolve(node->identifierId, node->identifierName);
+    record.rhs = rhs;
+    record.datatype = node->datatype;
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+  NodeRef visitCast(CastAST *node) {
+    NodeRef rhs = convert(node->rhs);
+    NodeRef ref;
+    CompactCast &record = add(&ast->casts, CastASTNode, &ref);
+    record.rhs = rhs;
+    record.datatype = node->datatype;
+    record.flags = packFlags(node->flags);
+    return ref;
+  }
+
+  CompactAST *ast;
+  symbol::SymbolTable *symbols;
+};
+
+// SERIALIZATION
+const uint32_t SERIALIZATION_MAGIC = 0x54534143; // "CAST"
+const uint32_t SERIALIZATION_VERSION = 1;
+
+template <typename T>
+void writeArray(std::vector<uint8_t> *buffer, const std::vector<T> &array) {
+  auto count = static_cast<uint32_t>(array.size());
+  const auto *countBytes = reinterpret_cast<const uint8_t *>(&count);
+  buffer->insert(buffer->end(), countBytes, countBytes + sizeof(count));
+  const auto *bytes = reinterpret_cast<const uint8_t *>(array.data());
+  buffer->insert(buffer->end(), bytes, bytes + sizeof(T) * array.size());
+}
+
+struct Reader {
+  const uint8_t *ptr;
+  const uint8_t *end;
+
+  bool readUint(uint32_t *value) {
+    if (end - ptr < static_cast<ptrdiff_t>(sizeof(uint32_t))) {
+      return false;
+    }
+    memcpy(value, ptr, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    return true;
+  }
+  template <typename T> bool readArray(std::vector<T> *array) {
+    uint32_t count;
+    if (!readUint(&count)) {
+      return false;
+    }
+    uint64_t bytes = static_cast<uint64_t>(count) * sizeof(T);
+    if (static_cast<uint64_t>(end - ptr) < bytes) {
+      return false;
+    }
+    array->resize(count);
+    memcpy(array->data(), ptr, bytes);
+    ptr += bytes;
+    return true;
+  }
+};
+
+// checks a deserialized CompactAST before anybody walks it, every
+// reference and range has to land inside its array and the nodes have to
+// be acyclic, otherwise a walk could read out of bounds or never end
+struct Validator {
+  explicit Validator(const CompactAST &inast) : ast(inast) {
+    sizes[0] = 0;
+    sizes[NumberNode] = ast.numbers.size();
+    sizes[VariableNode] = ast.variables.size();
+    sizes[BinaryNode] = ast.binaries.size();
+    sizes[CallNode] = ast.calls.size();
+    sizes[PrototypeNode] = ast.prototypes.size();
+    sizes[FunctionNode] = ast.functions.size();
+    sizes[IfNode] = ast.ifs.size();
+    sizes[ForNode] = ast.fors.size();
+    sizes[DereferenceNode] = ast.dereferences.size();
+    sizes[ToPointerAssigmentNode] = ast.toPointerAssigments.size();
+    sizes[CastASTNode] = ast.casts.size();
+    // nodes of all types numbered one after the other
+    offsets[0] = 0;
+    for (int kind = 1; kind < NODE_TYPE_COUNT; ++kind) {
+      offsets[kind] = offsets[kind - 1] + sizes[kind - 1];
+    }
+    nodeCount = offsets[NODE_TYPE_COUNT - 1] + sizes[NODE_TYPE_COUNT - 1];
+  }
+
+  bool isValidRef(NodeRef ref) const {
+    auto kind = static_cast<uint32_t>(CompactAST::kindOf(ref));
+    return kind >= NumberNode && kind < NODE_TYPE_COUNT &&
+           CompactAST::indexOf(ref) < sizes[kind];
+  }
+  // missing children are stored as INVALID_NODE
+  bool isValidChild(NodeRef ref) const {
+    return ref == INVALID_NODE || isValidRef(ref);
+  }
+  static bool isValidRange(IndexRange range, size_t size) {
+    return static_cast<uint64_t>(range.first) + range.count <= size;
+  }
+  bool isValidList(IndexRange range) const {
+    if (!isValidRange(range, ast.children.size())) {
+      return false;
+    }
+    for (NodeRef ref : ast.getChildren(range)) {
+      if (!isValidChild(ref)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool checkReferences() const {
+    for (const CompactVariable &node : ast.variables) {
+      if (!isValidChild(node.value)) {
+        return false;
+      }
+    }
+    for (const CompactBinary &node : ast.binaries) {
+      if (!isValidChild(node.lhs) || !isValidChild(node.rhs) ||
+          (node.op >= parser::OP_COUNT && node.op != parser::OP_NONE)) {
+        return false;
+      }
+    }
+    for (const CompactCall &node : ast.calls) {
+      if (!isValidList(node.args)) {
+        return false;
+      }
+    }
+    for (const CompactPrototype &node : ast.prototypes) {
+      if (!isValidRange(node.args, ast.arguments.size())) {
+        return false;
+      }
+    }
+    for (const CompactFunction &node : ast.functions) {
+      if (!isValidRef(node.proto) ||
+          CompactAST::kindOf(node.proto) != PrototypeNode ||
+          !isValidList(node.body)) {
+        return false;
+      }
+    }
+    for (const CompactIf &node : ast.ifs) {
+      if (!isValidChild(node.condition) || !isValidList(node.ifBody) ||
+          !isValidList(node.elseBody)) {
+        return false;
+      }
+    }
+    for (const CompactFor &node : ast.fors) {
+      if (!isValidChild(node.initialization) ||
+          !isValidChild(node.condition) || !isValidChild(node.increment) ||
+          !isValidList(node.body)) {
+        return false;
+      }
+    }
+    for (const CompactToPointerAssigment &node : ast.toPointerAssigments) {
+      if (!isValidChild(node.rhs)) {
+        return false;
+      }
+    }
+    for (const CompactCast &node : ast.casts) {
+      if (!isValidChild(node.rhs)) {
+        return false;
+      }
+    }
+    for (NodeRef root : ast.roots) {
+      if (!isValidRef(root)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  uint32_t flatIndex(NodeRef ref) const {
+    return offsets[CompactAST::kindOf(ref)] + CompactAST::indexOf(ref);
+  }
+  // calls f on the flat index of every child of the node, references
+  // must have been checked already
+  template <typename F> void forEachChild(NodeRef ref, F f) const {
+    auto single = [&](NodeRef child) {
+      if (child != INVALID_NODE) {
+        f(flatIndex(child));
+      }
+    };
+    auto list = [&](IndexRange range) {
+      for (NodeRef child : ast.getChildren(range)) {
+        single(child);
+      }
+    };
+    const uint32_t index = CompactAST::indexOf(ref);
+    switch (CompactAST::kindOf(ref)) {
+    case VariableNode:
+      single(ast.variables[index].value);
+      break;
+    case BinaryNode:
+      single(ast.binaries[index].lhs);
+      single(ast.binaries[index].rhs);
+      break;
+    case CallNode:
+      list(ast.calls[index].args);
+      break;
+    case FunctionNode:
+      single(ast.functions[index].proto);
+      list(ast.functions[index].body);
+      break;
+    case IfNode:
+      single(ast.ifs[index].condition);
+      list(ast.ifs[index].ifBody);
+      list(ast.ifs[index].elseBody);
+      break;
+    case ForNode:
+      single(ast.fors[index].initialization);
+      single(ast.fors[index].condition);
+      single(ast.fors[index].increment);
+      list(ast.fors[index].body);
+      break;
+    case ToPointerAssigmentNode:
+      single(ast.toPointerAssigments[index].rhs);
+      break;
+    case CastASTNode:
+      single(ast.casts[index].rhs);
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Kahn's algorithm, iterative so that deep trees can not blow the stack,
+  // shared children are fine, only cycles are rejected
+  bool checkAcyclic() const {
+    std::vector<NodeRef> refs(nodeCount);
+    for (int kind = 1; kind < NODE_TYPE_COUNT; ++kind) {
+      for (uint32_t i = 0; i < sizes[kind]; ++i) {
+        refs[offsets[kind] + i] =
+            CompactAST::makeRef(static_cast<NodeType>(kind), i);
+      }
+    }
+    std::vector<uint32_t> parents(nodeCount, 0);
+    for (NodeRef ref : refs) {
+      forEachChild(ref, [&](uint32_t child) { ++parents[child]; });
+    }
+    std::vector<uint32_t> ready;
+    for (uint32_t i = 0; i < nodeCount; ++i) {
+      if (parents[i] == 0) {
+        ready.push_back(i);
+      }
+    }
+    uint32_t processed = 0;
+    while (!ready.empty()) {
+      uint32_t current = ready.back();
+      ready.pop_back();
+      ++processed;
+      forEachChild(refs[current], [&](uint32_t child) {
+        if (--parents[child] == 0) {
+          ready.push_back(child);
+        }
+      });
+    }
+    return processed == nodeCount;
+  }
+
+  const CompactAST &ast;
+  uint32_t sizes[NODE_TYPE_COUNT];
+  uint32_t offsets[NODE_TYPE_COUNT];
+  uint32_t nodeCount;
+};
+} // namespace
+
+NodeRef CompactAST::addRoot(ExprAST *node, symbol::SymbolTable *symbols) {
+  CompactConverter converter(this, symbols);
+  NodeRef root = converter.convert(node);
+  roots.push_back(root);
+  return root;
+}
+
+uint32_t CompactAST::getNodeCount() const {
+  return static_cast<uint32_t>(
+      numbers.size() + variables.size() + binaries.size() + calls.size() +
+      prototypes.size() + functions.size() + ifs.size() + fors.size() +
+      dereferences.size() + toPointerAssigments.size() + casts.size());
+}
+
+void CompactAST::serialize(std::vector<uint8_t> *buffer) const {
+  const uint32_t header[] = {SERIALIZATION_MAGIC, SERIALIZATION_VERSION};
+  const auto *headerBytes = reinterpret_cast<const uint8_t *>(header);
+  buffer->insert(buffer->end(), headerBytes, headerBytes + sizeof(header));
+  writeArray(buffer, numbers);
+  writeArray(buffer, variables);
+  writeArray(buffer, binaries);
+  writeArray(buffer, calls);
+  writeArray(buffer, prototypes);
+  writeArray(buffer, functions);
+  writeArray(buffer, ifs);
+  writeArray(buffer, fors);
+  writeArray(buffer, dereferences);
+  writeArray(buffer, toPointerAssigments);
+  writeArray(buffer, casts);
+  writeArray(buffer, children);
+  writeArray(buffer, arguments);
+  writeArray(buffer, roots);
+}
+
+bool CompactAST::deserialize(const uint8_t *data, size_t size) {
+  clear();
+  Reader reader{data, data + size};
+  uint32_t magic;
+  uint32_t version;
+  if (!reader.readUint(&magic) || magic != SERIALIZATION_MAGIC ||
+      !reader.readUint(&version) || version != SERIALIZATION_VERSION) {
+    return false;
+  }
+  bool result =
+      reader.readArray(&numbers) && reader.readArray(&variables) &&
+      reader.readArray(&binaries) && reader.readArray(&calls) &&
+      reader.readArray(&prototypes) && reader.readArray(&functions) &&
+      reader.readArray(&ifs) && reader.readArray(&fors) &&
+      reader.readArray(&dereferences) &&
+      reader.readArray(&toPointerAssigments) && reader.readArray(&casts) &&
+      reader.readArray(&children) && reader.readArray(&arguments) &&
+      reader.readArray(&roots);
+  // trailing bytes mean the data is not what we wrote
+  result = result && reader.ptr == reader.end;
+  if (result) {
+    Validator validator(*this);
+    result = validator.checkReferences() && validator.checkAcyclic();
+  }
+  if (!result) {
+    clear();
+  }
+  return result;
+}
+
+void CompactAST::clear() {
+  numbers.clear();
+  variables.clear();
+  binaries.clear();
+  calls.clear();
+  prototypes.clear();
+  functions.clear();
+  ifs.clear();
+  fors.clear();
+  dereferences.clear();
+  toPointerAssigments.clear();
+  casts.clear();
+  children.clear();
+  arguments.clear();
+  roots.clear();
+}
+
+} // namespace codegen
+} // namespace babycpp
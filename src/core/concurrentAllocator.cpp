@@ -0,0 +1,194 @@
+#include "concurrentAllocator.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+namespace babycpp {
+namespace memory {
+
+namespace {
+inline char *alignPointer(char *ptr, uint32_t alignment) {
+  auto address = reinterpret_cast<uintptr_t>(ptr);
+  const uintptr_t mask = alignment - 1;
+  return reinterpret_cast<char *>((address + mask) & ~mask);
+}
+
+std::atomic<uint64_t> ALLOCATOR_INSTANCES{0};
+
+// last arena used by the thread, avoids taking the lock and searching the
+// registered arenas on every allocation
+struct ThreadArenaCache {
+  uint64_t instanceId = 0;
+  SlabAllocator *arena = nullptr;
+};
+thread_local ThreadArenaCache ARENA_CACHE;
+} // namespace
+
+// THREAD LOCAL
+ThreadLocalSlabAllocator::ThreadLocalSlabAllocator(int slabSizeInByte)
+    : instanceId(++ALLOCATOR_INSTANCES), slabSize(slabSizeInByte) {
+  assert(slabSize != 0);
+}
+
+SlabAllocator &ThreadLocalSlabAllocator::getThreadArena() {
+  if (ARENA_CACHE.instanceId == instanceId) {
+    return *ARENA_CACHE.arena;
+  }
+  SlabAllocator &arena = registerThreadArena();
+  ARENA_CACHE.instanceId = instanceId;
+  ARENA_CACHE.arena = &arena;
+  return arena;
+}
+
+SlabAllocator &ThreadLocalSlabAllocator::registerThreadArena() {
+  const std::thread::id self = std::this_thread::get_id();
+  std::lock_guard<std::mutex> lock(arenasMutex);
+  // the thread might have used another allocator in between, in that
+  // case its arena is already here
+  for (auto &threadArena : arenas) {
+    if (threadArena.owner == self) {
+      return *threadArena.arena;
+    }
+  }
+  arenas.emplace_back(ThreadArena{
+      self, std::unique_ptr<SlabAllocator>(new SlabAllocator(slabSize))});
+  return *arenas.back().arena;
+}
+
+uint32_t ThreadLocalSlabAllocator::getArenaCount() {
+  std::lock_guard<std::mutex> lock(arenasMutex);
+  return static_cast<uint32_t>(arenas.size());
+}
+
+AllocatorStats ThreadLocalSlabAllocator::getStats() {
+  std::lock_guard<std::mutex> lock(arenasMutex);
+  AllocatorStats total;
+  for (auto &threadArena : arenas) {
+    total += threadArena.arena->getStats();
+  }
+  return total;
+}
+
+void ThreadLocalSlabAllocator::clear() {
+  std::lock_guard<std::mutex> lock(arenasMutex);
+  for (auto &threadArena : arenas) {
+    threadArena.arena->clear();
+  }
+}
+
+// CONCURRENT
+ConcurrentSlabAllocator::ConcurrentSlabAllocator(int slabSizeInByte)
+    : slabSize(slabSizeInByte), oversizedBlocks(nullptr) {
+  assert(slabSize != 0);
+  currentSlab.store(createSlab(nullptr));
+}
+
+ConcurrentSlabAllocator::ConcurrentSlab *
+ConcurrentSlabAllocator::createSlab(ConcurrentSlab *previous) {
+  auto *slab = new ConcurrentSlab;
+  slab->data = new char[slabSize];
+  slab->endp = slab->data + slabSize;
+  slab->rsp.store(slab->data, std::memory_order_relaxed);
+  slab->previous = previous;
+  return slab;
+}
+
+void ConcurrentSlabAllocator::destroySlab(ConcurrentSlab *slab) {
+  delete[] slab->data;
+  delete slab;
+}
+
+void *ConcurrentSlabAllocator::alloc(uint32_t byteSize, uint32_t alignment) {
+  assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+  // same rule as SlabAllocator, new[] memory is aligned for any
+  // fundamental type so only bigger alignments can cost padding
+  const uint32_t worstPadding =
+      alignment > alignof(std::max_align_t) ? alignment - 1 : 0;
+  if (static_cast<uint64_t>(byteSize) + worstPadding > slabSize) {
+    return allocOversized(byteSize, alignment);
+  }
+
+  ConcurrentSlab *slab = currentSlab.load(std::memory_order_acquire);
+  while (true) {
+    char *old = slab->rsp.load(std::memory_order_relaxed);
+    char *aligned = alignPointer(old, alignment);
+    if (aligned + byteSize <= slab->endp) {
+      // fast path, claiming the range unless somebody else moved the
+      // stack pointer in the meantime
+      if (slab->rsp.compare_exchange_weak(old, aligned + byteSize,
+                                          std::memory_order_relaxed)) {
+        return aligned;
+      }
+      continue;
+    }
+
+    // the slab is full, only one thread at the time installs a new one,
+    // the others find it already there once they get the lock
+    slab = refillSlab(slab);
+  }
+}
+
+ConcurrentSlabAllocator::ConcurrentSlab *
+ConcurrentSlabAllocator::refillSlab(ConcurrentSlab *full) {
+  std::lock_guard<std::mutex> lock(refillMutex);
+  ConcurrentSlab *current = currentSlab.load(std::memory_order_acquire);
+  if (current != full) {
+    return current;
+  }
+  ConcurrentSlab *fresh = createSlab(full);
+  currentSlab.store(fresh, std::memory_order_release);
+  return fresh;
+}
+
+void *ConcurrentSlabAllocator::allocOversized(uint32_t byteSize,
+                                              uint32_t alignment) {
+  // the header linking the blocks sits before the user memory
+  const uint32_t headerSize = static_cast<uint32_t>(
+      std::max(sizeof(OversizedBlock), alignof(std::max_align_t)));
+  const uint32_t padding =
+      alignment > alignof(std::max_align_t) ? alignment - 1 : 0;
+  auto *raw = new char[headerSize + byteSize + padding];
+  auto *block = reinterpret_cast<OversizedBlock *>(raw);
+  block->next = oversizedBlocks.load(std::memory_order_relaxed);
+  while (!oversizedBlocks.compare_exchange_weak(block->next, block,
+                                                std::memory_order_release)) {
+  }
+  return alignPointer(raw + headerSize, alignment);
+}
+
+uint32_t ConcurrentSlabAllocator::getSlabCount() const {
+  uint32_t count = 0;
+  for (ConcurrentSlab *slab = currentSlab.load(std::memory_order_acquire);
+       slab != nullptr; slab = slab->previous) {
+    ++count;
+  }
+  return count;
+}
+
+void ConcurrentSlabAllocator::clear() {
+  ConcurrentSlab *current = currentSlab.load(std::memory_order_acquire);
+  ConcurrentSlab *slab = current->previous;
+  while (slab != nullptr) {
+    ConcurrentSlab *previous = slab->previous;
+    destroySlab(slab);
+    slab = previous;
+  }
+  current->previous = nullptr;
+  current->rsp.store(current->data, std::memory_order_release);
+
+  OversizedBlock *block = oversizedBlocks.exchange(nullptr);
+  while (block != nullptr) {
+    OversizedBlock *next = block->next;
+    delete[] reinterpret_cast<char *>(block);
+    block = next;
+  }
+}
+
+ConcurrentSlabAllocator::~ConcurrentSlabAllocator() {
+  clear();
+  destroySlab(currentSlab.load());
+}
+
+} // namespace memory
+} // namespace babycpp
@@ -0,0 +1,176 @@
+#include "factoryAST.h"
+
+#include <llvm/ADT/Hashing.h>
+
+#include <cassert>
+#include <iomanip>
+#include <sstream>
+
+namespace babycpp {
+namespace memory {
+
+namespace {
+void printCounter(std::ostringstream &oss, const char *name, uint64_t value) {
+  oss << "  " << std::left << std::setw(28) << name << std::right
+      << std::setw(12) << value << "\n";
+}
+
+// operators are at most a few characters, packing them in the key avoids
+// keeping slices of the source buffer in the table
+uint64_t packOperator(llvm::StringRef op) {
+  assert(op.size() <= sizeof(uint64_t));
+  uint64_t packed = 0;
+  for (char c : op) {
+    packed = (packed << 8) | static_cast<uint8_t>(c);
+  }
+  return packed;
+}
+
+uint64_t packNumber(const lexer::Number &value) {
+  uint32_t bits;
+  memcpy(&bits, &value.integerNumber, sizeof(bits));
+  return (static_cast<uint64_t>(value.type) << 32) | bits;
+}
+
+uint64_t packCast(int datatype, bool isPointer) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(datatype)) << 1) |
+         (isPointer ? 1 : 0);
+}
+
+bool keyOf(const codegen::ExprAST *node, ConsKey *key) {
+  switch (node->nodetype) {
+  case codegen::NumberNode: {
+    auto *number = static_cast<const codegen::NumberExprAST *>(node);
+    *key = ConsKey{node->nodetype, packNumber(number->val), nullptr, nullptr};
+    return true;
+  }
+  case codegen::VariableNode: {
+    auto *variable = static_cast<const codegen::VariableExprAST *>(node);
+    *key = ConsKey{node->nodetype, variable->nameId, nullptr, nullptr};
+    return true;
+  }
+  case codegen::BinaryNode: {
+    auto *bin = static_cast<const codegen::BinaryExprAST *>(node);
+    *key = ConsKey{node->nodetype, packOperator(bin->op), bin->lhs, bin->rhs};
+    return true;
+  }
+  case codegen::CastASTNode: {
+    auto *cast = static_cast<const codegen::CastAST *>(node);
+    *key = ConsKey{node->nodetype,
+                   packCast(cast->datatype, cast->flags.isPointer), cast->rhs,
+                   nullptr};
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+} // namespace
+
+size_t ConsKeyHash::operator()(const ConsKey &key) const {
+  return llvm::hash_combine(key.nodetype, key.value, key.lhs, key.rhs);
+}
+
+// HASH CONSING
+codegen::NumberExprAST *FactoryAST::consNumberAST(lexer::Number value) {
+  ConsKey key{codegen::NumberNode, packNumber(value), nullptr, nullptr};
+  return consASTNode<codegen::NumberExprAST>(key, value);
+}
+
+codegen::VariableExprAST *
+FactoryAST::consVariableAST(llvm::StringRef name, symbol::SymbolId nameId) {
+  // without a symbol we can't tell names apart cheaply, not worth sharing
+  if (nameId == symbol::INVALID_SYMBOL) {
+    return allocVariableAST(name, nullptr, 0, nameId);
+  }
+  ConsKey key{codegen::VariableNode, nameId, nullptr, nullptr};
+  return consASTNode<codegen::VariableExprAST>(key, name, nullptr, 0, nameId);
+}
+
+codegen::BinaryExprAST *FactoryAST::consBinaryAST(llvm::StringRef op,
+                                                  codegen::ExprAST *lhs,
+                                                  codegen::ExprAST *rhs) {
+  // an operation is pure only if its operands are, a call in there
+  // could have side effects
+  if (!isConsed(lhs) || !isConsed(rhs)) {
+    return allocBinaryAST(op, lhs, rhs);
+  }
+  ConsKey key{codegen::BinaryNode, packOperator(op), lhs, rhs};
+  return consASTNode<codegen::BinaryExprAST>(key, op, lhs, rhs);
+}
+
+codegen::CastAST *FactoryAST::consCastAST(int datatype, bool isPointer,
+                                          codegen::ExprAST *rhs) {
+  if (!isConsed(rhs)) {
+    return allocCastAST(datatype, isPointer, rhs);
+  }
+  ConsKey key{codegen::CastASTNode, packCast(datatype, isPointer), rhs,
+              nullptr};
+  return consASTNode<codegen::CastAST>(key, datatype, isPointer, rhs);
+}
+
+bool FactoryAST::isConsed(const codegen::ExprAST *node) const {
+  ConsKey key;
+  if (!hashConsing || !keyOf(node, &key)) {
+    return false;
+  }
+  auto found = consTable.find(key);
+  return found != consTable.end() && found->second == node;
+}
+
+codegen::ExprAST *FactoryAST::unshare(codegen::ExprAST *node) {
+  if (!isConsed(node)) {
+    return node;
+  }
+  // a plain copy of the node, children are pure so they can stay shared
+  switch (node->nodetype) {
+  case codegen::NumberNode:
+    return allocNuberAST(*static_cast<codegen::NumberExprAST *>(node));
+  case codegen::VariableNode:
+    return allocVariableAST(*static_cast<codegen::VariableExprAST *>(node));
+  case codegen::BinaryNode:
+    return allocBinaryAST(*static_cast<codegen::BinaryExprAST *>(node));
+  case codegen::CastASTNode:
+    return allocCastAST(*static_cast<codegen::CastAST *>(node));
+  default:
+    return node;
+  }
+}
+
+std::string FactoryAST::dumpStats() const {
+  std::ostringstream oss;
+  const AllocatorStats &alloc = allocator.getStats();
+  oss << "================== ALLOCATOR ================= \n";
+  printCounter(oss, "slab size", allocator.slabSize);
+  printCounter(oss, "slabs", alloc.slabCount);
+  printCounter(oss, "allocations", alloc.allocationCount);
+  printCounter(oss, "bytes requested", alloc.bytesRequested);
+  printCounter(oss, "bytes alignment padding", alloc.bytesAlignmentPadding);
+  printCounter(oss, "bytes wasted in slab tails",
+               alloc.bytesWastedInSlabTails);
+  printCounter(oss, "oversized allocations", alloc.oversizedCount);
+  printCounter(oss, "oversized bytes", alloc.oversizedBytes);
+  printCounter(oss, "current usage", alloc.currentUsage);
+  printCounter(oss, "peak usage", alloc.peakUsage);
+
+  oss << "================== AST NODES ================= \n";
+  for (int type = 1; type < codegen::NODE_TYPE_COUNT; ++type) {
+    if (stats.nodeCounts[type] == 0) {
+      continue;
+    }
+    oss << "  " << std::left << std::setw(28) << codegen::getNodeTypeName(type)
+        << std::right << std::setw(12) << stats.nodeCounts[type]
+        << std::setw(12) << stats.nodeBytes[type] << " bytes\n";
+  }
+  printCounter(oss, "children lists", stats.arrayCount);
+  printCounter(oss, "children lists bytes", stats.arrayBytes);
+  printCounter(oss, "names bytes", stats.stringBytes);
+  if (hashConsing) {
+    printCounter(oss, "hash consed nodes", stats.consHits);
+    printCounter(oss, "hash consed bytes saved", stats.consBytesSaved);
+  }
+  return oss.str();
+}
+
+} // namespace memory
+} // namespace babycpp
@@ -1,9 +1,170 @@
 #include "lexer.h"
+#include <cstdint>
 #include <iostream>
+#include <limits>
 
 namespace babycpp {
 namespace lexer {
 
+// character classes used by the scanner, each one maps to one of the
+// alternatives of MAIN_REGEX so that the two lexing modes stay token
+// for token compatible
+enum CharClass : uint8_t {
+  CHAR_OTHER = 0,
+  CHAR_BLANK,      // [ \t]* skipped before every token
+  CHAR_NEWLINE,    // [\r\n]
+  CHAR_ALPHA,      // start of an identifier
+  CHAR_DIGIT,      // start or body of a number
+  CHAR_DOT,        // . is caught by the number alternative first
+  CHAR_UNDERSCORE, // only valid in the body of an identifier
+  CHAR_PUNCT,      // supported ascii, start of an operator
+};
+
+struct CharClassTable {
+  constexpr CharClassTable() : classes{} {
+    for (int c = 'a'; c <= 'z'; ++c) {
+      classes[c] = CHAR_ALPHA;
+    }
+    for (int c = 'A'; c <= 'Z'; ++c) {
+      classes[c] = CHAR_ALPHA;
+    }
+    for (int c = '0'; c <= '9'; ++c) {
+      classes[c] = CHAR_DIGIT;
+    }
+    classes[static_cast<int>(' ')] = CHAR_BLANK;
+    classes[static_cast<int>('\t')] = CHAR_BLANK;
+    classes[static_cast<int>('\r')] = CHAR_NEWLINE;
+    classes[static_cast<int>('\n')] = CHAR_NEWLINE;
+    classes[static_cast<int>('.')] = CHAR_DOT;
+    classes[static_cast<int>('_')] = CHAR_UNDERSCORE;
+    // the regex range \+-/ expands to + , - . / where the dot is already
+    // taken by the number alternative
+    const char punct[] = "(){}+,-/*;<=>!&|^%";
+    for (const char *p = punct; *p != 0; ++p) {
+      classes[static_cast<int>(*p)] = CHAR_PUNCT;
+    }
+  }
+  uint8_t classes[256];
+};
+
+static constexpr CharClassTable CHAR_CLASSES{};
+
+inline uint8_t charClass(char c) {
+  return CHAR_CLASSES.classes[static_cast<unsigned char>(c)];
+}
+inline bool isIdentifierBody(uint8_t cls) {
+  return (cls == CHAR_ALPHA) | (cls == CHAR_DIGIT) | (cls == CHAR_UNDERSCORE);
+}
+inline bool isNumberBody(uint8_t cls) {
+  return (cls == CHAR_DIGIT) | (cls == CHAR_DOT);
+}
+
+inline bool isDigit(char c) { return charClass(c) == CHAR_DIGIT; }
+inline bool isHexDigit(char c) {
+  return isDigit(c) | ((c >= 'a') & (c <= 'f')) | ((c >= 'A') & (c <= 'F'));
+}
+inline bool isNumberSuffix(char c) {
+  return (c == 'u') | (c == 'U') | (c == 'l') | (c == 'L') | (c == 'f') |
+         (c == 'F');
+}
+
+/**
+ * @brief scans the extent of a number literal, same as the digits
+ * alternative of MAIN_REGEX. Only the extent is found here, validation
+ * happens when the number gets converted
+ * @param ptr: first char of the number, a digit or a dot
+ * @return pointer past the end of the literal
+ */
+const char *scanNumber(const char *ptr) {
+  if (ptr[0] == '0' && (ptr[1] == 'x' || ptr[1] == 'X') &&
+      isHexDigit(ptr[2])) {
+    ptr += 3;
+    while (isHexDigit(*ptr)) {
+      ++ptr;
+    }
+  } else {
+    ++ptr;
+    while (isNumberBody(charClass(*ptr))) {
+      ++ptr;
+    }
+    // exponent is only taken if followed by at least a digit
+    if (*ptr == 'e' || *ptr == 'E') {
+      const char *exponent = ptr + 1;
+      if (*exponent == '+' || *exponent == '-') {
+        ++exponent;
+      }
+      if (isDigit(*exponent)) {
+        ptr = exponent + 1;
+        while (isDigit(*ptr)) {
+          ++ptr;
+        }
+      }
+    }
+  }
+  while (isNumberSuffix(*ptr)) {
+    ++ptr;
+  }
+  return ptr;
+}
+
+/**
+ * @brief length of the operator starting at ptr, the longest operator
+ * wins like in the ascii alternative of MAIN_REGEX
+ */
+inline int operatorLength(const char *ptr) {
+  if ((ptr[0] == '<' || ptr[0] == '>') && ptr[1] == ptr[0]) {
+    return ptr[2] == '=' ? 3 : 2;
+  }
+  if (isTwoCharOperator(ptr)) {
+    return 2;
+  }
+  return 1;
+}
+
+/**
+ * @brief hand written equivalent of running MAIN_REGEX on the buffer
+ * @param start: where to start scanning from
+ * @param extractedString: output, slice of the buffer holding the token
+ *                         without blanks
+ * @param offset: output, how many chars are eaten including leading blanks
+ * @return whether or not a token has been matched
+ */
+bool scanToken(const char *start, llvm::StringRef *extractedString,
+               int *offset) {
+  const char *ptr = start;
+  while (charClass(*ptr) == CHAR_BLANK) {
+    ++ptr;
+  }
+  const char *tokenStart = ptr;
+  switch (charClass(*ptr)) {
+  case CHAR_ALPHA: {
+    ++ptr;
+    while (isIdentifierBody(charClass(*ptr))) {
+      ++ptr;
+    }
+    break;
+  }
+  case CHAR_DIGIT:
+  case CHAR_DOT: {
+    ptr = scanNumber(ptr);
+    break;
+  }
+  case CHAR_PUNCT: {
+    ptr += operatorLength(ptr);
+    break;
+  }
+  case CHAR_NEWLINE: {
+    ++ptr;
+    break;
+  }
+  default:
+    return false;
+  }
+  *extractedString = llvm::StringRef(tokenStart, ptr - tokenStart);
+  (*offset) = static_cast<int>(ptr - start);
+  return true;
+}
+
 int inline handleNoMatchFromRegex(const char *start) {
   if ((*start == EOF) || (*start == 0)) {
     return tok_eof;
@@ -12,58 +173,249 @@ int inline handleNoMatchFromRegex(const char *start) {
   return tok_no_match;
 }
 
-int inline isBuiltInKeyword(const std::string &str) {
-  const auto iter = KEYWORDS.find(str);
-  if (iter != KEYWORDS.end()) {
-    return iter->second;
-  }
-  return tok_no_match;
+int inline isBuiltInKeyword(llvm::StringRef str) {
+  return lookupKeyword(str);
 }
 
-inline std::string extractStringFromMatch(const Charmatch &matcher,
-                                          int *offset) {
+inline llvm::StringRef extractStringFromMatch(const Charmatch &matcher,
+                                              int *offset) {
   int matcherSize = matcher.size();
   for (int i = 1; i < matcherSize; ++i) {
     if (matcher[i].matched) {
       (*offset) = matcher.length();
-      return matcher[i];
+      // slicing the buffer rather than copying out the sub match
+      return llvm::StringRef(matcher[i].first, matcher[i].length());
     }
   }
-  return "";
+  return llvm::StringRef();
+}
+
+inline void logLexerError(const std::string &msg, Lexer *lexer,
+                          diagnostic::IssueCode code) {
+  diagnostic::Issue err{msg, lexer->lineNumber, lexer->columnNumber,
+                        diagnostic::IssueType::LEXER, code};
+  lexer->diagnostic->pushError(err);
+}
+
+inline int hexDigitValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
 }
 
-int processNumber(const std::string &str, Lexer *L) {
-  const char *ptr = str.c_str();
-  int cLen = str.length();
-  bool dotFound = false;
-  for (int i = 0; i < cLen; ++i) {
-    const char c = (*(ptr + i));
-    if (isdigit(c) != 0) {
-      continue;
+// powers of ten exactly representable as double
+static const double EXACT_POWERS_OF_TEN[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+static const int MAX_EXACT_POWER_OF_TEN = 22;
+// more digits than this do not fit in the 64 bit mantissa, they can only
+// change the rounding of a 32 bit float by much less than an ulp
+static const int MAX_MANTISSA_DIGITS = 19;
+
+/**
+ * @brief computes mantissa * 10^exponent, the common cases where both
+ * are exact in double give a correctly rounded result, the others are
+ * off by a few double ulps which is well below float precision
+ */
+double scaleByPowerOfTen(uint64_t mantissa, int exponent) {
+  auto value = static_cast<double>(mantissa);
+  if (value == 0.0) {
+    return 0.0;
+  }
+  while (exponent > MAX_EXACT_POWER_OF_TEN) {
+    value *= EXACT_POWERS_OF_TEN[MAX_EXACT_POWER_OF_TEN];
+    exponent -= MAX_EXACT_POWER_OF_TEN;
+    if (value > std::numeric_limits<double>::max()) {
+      return value;
     }
-    if (c == '.' && !dotFound) {
-      dotFound = true;
-      continue;
+  }
+  while (exponent < -MAX_EXACT_POWER_OF_TEN) {
+    value /= EXACT_POWERS_OF_TEN[MAX_EXACT_POWER_OF_TEN];
+    exponent += MAX_EXACT_POWER_OF_TEN;
+  }
+  if (exponent >= 0) {
+    return value * EXACT_POWERS_OF_TEN[exponent];
+  }
+  return value / EXACT_POWERS_OF_TEN[-exponent];
+}
+
+/**
+ * @brief converts a numeric literal in a single pass
+ * Supported forms are decimal integers, hexadecimal integers (0x prefix),
+ * floating points with optional exponent and the u, l and f suffixes.
+ * Integers need to fit in 32 bits, decimal literals without the u suffix
+ * in a signed int, hex and unsigned literals keep their bit pattern.
+ * Nothing is allocated, no locale is involved and nothing throws, out of
+ * range literals are reported in the diagnostic
+ * @param str: the literal as extracted by the lexer
+ * @param L: lexer where to write the value
+ * @return tok_number or tok_malformed_number
+ */
+int processNumber(llvm::StringRef str, Lexer *L) {
+  const char *ptr = str.begin();
+  const char *end = str.end();
+
+  uint64_t mantissa = 0;
+  bool hex = false;
+  bool overflow = false;
+  bool isFloat = false;
+  int digits = 0;
+  int exponent = 0;
+
+  if (str.size() > 2 && ptr[0] == '0' && (ptr[1] == 'x' || ptr[1] == 'X')) {
+    hex = true;
+    ptr += 2;
+    for (; ptr != end && hexDigitValue(*ptr) >= 0; ++ptr) {
+      mantissa = (mantissa << 4) | static_cast<uint64_t>(hexDigitValue(*ptr));
+      overflow |= mantissa > 0xFFFFFFFFull;
+      ++digits;
+    }
+  } else {
+    bool dotFound = false;
+    int significantDigits = 0;
+    for (; ptr != end; ++ptr) {
+      const char c = *ptr;
+      if (c >= '0' && c <= '9') {
+        ++digits;
+        if (mantissa == 0 && c == '0') {
+          // leading zeros do not count toward the mantissa digits
+          exponent -= dotFound ? 1 : 0;
+          continue;
+        }
+        if (++significantDigits <= MAX_MANTISSA_DIGITS) {
+          mantissa = mantissa * 10 + static_cast<uint64_t>(c - '0');
+          exponent -= dotFound ? 1 : 0;
+        } else {
+          // too many digits to track, dropped integer digits still scale
+          // the value and are an overflow if this turns out an integer
+          overflow |= !dotFound;
+          exponent += dotFound ? 0 : 1;
+        }
+        continue;
+      }
+      if (c == '.' && !dotFound) {
+        dotFound = true;
+        continue;
+      }
+      break;
+    }
+    isFloat = dotFound;
+
+    // optional exponent, the sign is only ever there after the e
+    if (ptr != end && (*ptr == 'e' || *ptr == 'E')) {
+      isFloat = true;
+      ++ptr;
+      bool negative = false;
+      if (ptr != end && (*ptr == '+' || *ptr == '-')) {
+        negative = *ptr == '-';
+        ++ptr;
+      }
+      if (ptr == end || *ptr < '0' || *ptr > '9') {
+        return tok_malformed_number;
+      }
+      int explicitExponent = 0;
+      for (; ptr != end && *ptr >= '0' && *ptr <= '9'; ++ptr) {
+        // clamping, anything this big is out of range for a float anyway
+        if (explicitExponent < 100000) {
+          explicitExponent = explicitExponent * 10 + (*ptr - '0');
+        }
+      }
+      exponent += negative ? -explicitExponent : explicitExponent;
+    }
+  }
+  if (digits == 0) {
+    return tok_malformed_number;
+  }
+
+  // suffixes, f makes a float out of a decimal, u and l only apply to
+  // integers, we only have 32 bit integers so l does not widen anything.
+  // Each of f, u and l/ll can appear at most once, ll in a single case
+  bool floatSuffix = false;
+  bool unsignedSuffix = false;
+  int longSuffix = 0;
+  while (ptr != end) {
+    const char c = *ptr++;
+    if ((c == 'f' || c == 'F') && !hex && !floatSuffix) {
+      floatSuffix = true;
+    } else if ((c == 'u' || c == 'U') && !unsignedSuffix) {
+      unsignedSuffix = true;
+    } else if ((c == 'l' || c == 'L') && longSuffix == 0) {
+      longSuffix = 1;
+      if (ptr != end && *ptr == c) {
+        longSuffix = 2;
+        ++ptr;
+      }
+    } else {
+      return tok_malformed_number;
     }
+  }
+  isFloat |= floatSuffix;
+  // 1.0l is a long double, there is no float with u, ll or with both f
+  // and l
+  if (isFloat &&
+      (unsignedSuffix || longSuffix == 2 || (floatSuffix && longSuffix))) {
     return tok_malformed_number;
   }
 
-  // if we get to this point it is a valid number!
-  if (dotFound) {
-    // it means is a floating point
-    L->value.floatNumber = std::stof(str);
+  if (isFloat) {
+    double value = scaleByPowerOfTen(mantissa, exponent);
+    if (value > std::numeric_limits<float>::max()) {
+      logLexerError("floating point literal " + str.str() +
+                        " is out of range",
+                    L, diagnostic::IssueCode::NUMBER_LITERAL_OUT_OF_RANGE);
+      return tok_malformed_number;
+    }
+    L->value.floatNumber = static_cast<float>(value);
     L->value.type = Token::tok_float;
-  } else {
-    L->value.integerNumber = std::stoi(str);
-    L->value.type = Token::tok_int;
+    return tok_number;
   }
+
+  // hex and unsigned literals can use all the 32 bits
+  uint64_t limit = hex || unsignedSuffix
+                       ? std::numeric_limits<uint32_t>::max()
+                       : std::numeric_limits<int32_t>::max();
+  if (overflow || mantissa > limit) {
+    logLexerError("integer literal " + str.str() + " is out of range", L,
+                  diagnostic::IssueCode::NUMBER_LITERAL_OUT_OF_RANGE);
+    return tok_malformed_number;
+  }
+  L->value.integerNumber =
+      static_cast<int32_t>(static_cast<uint32_t>(mantissa));
+  L->value.type = Token::tok_int;
   return tok_number;
 }
 
-inline bool isNewLine(const std::string &str) {
+inline bool isNewLine(llvm::StringRef str) {
   return (str[0] == '\r' || str[0] == '\n');
 }
 
+bool Lexer::initFromFile(const std::string &path) {
+  data.clear();
+  // the null terminator is required, both the scanner and the regex stop
+  // on it, MemoryBuffer guarantees it even when the file is mapped
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    fileBuffer.reset();
+    start = nullptr;
+    diagnostic::Issue err{"could not open source file " + path + ": " +
+                              buffer.getError().message(),
+                          0, 0, diagnostic::IssueType::LEXER,
+                          diagnostic::IssueCode::CANNOT_OPEN_SOURCE_FILE};
+    diagnostic->pushError(err);
+    return false;
+  }
+  fileBuffer = std::move(buffer.get());
+  resetSource(fileBuffer->getBufferStart());
+  return true;
+}
+
 void Lexer::gettok() {
   // making sure the lexer is initialized
   if (start == nullptr) {
@@ -71,23 +423,47 @@ void Lexer::gettok() {
     return;
   }
 
+  if (useTokenBuffer) {
+    currtok = tokens.kinds[cursor];
+    identifierStr = tokens.getString(tokenSource, cursor);
+    identifierId = tokens.ids[cursor];
+    value = tokens.values[cursor];
+    lineNumber = tokens.lines[cursor];
+    columnNumber = tokens.columns[cursor];
+    // the last token is the terminator, we keep returning it
+    if (cursor + 1 < tokens.size()) {
+      ++cursor;
+    }
+    return;
+  }
+
   if (!lookAheadToken.empty()) {
     const MovableToken &mov = lookAheadToken.front();
     currtok = mov.token;
     identifierStr = mov.identifierStr;
+    identifierId = mov.identifierId;
     value = mov.value;
-    columnNumber += mov.columnOffset;
+    lineNumber = mov.lineNumber;
+    columnNumber = mov.columnNumber;
     lookAheadToken.pop_front();
     return;
   }
+  lexToken();
+}
 
-  bool gotMatch = std::regex_search(start, matcher, expr,
-                                    std::regex_constants::match_continuous);
-
+void Lexer::lexToken() {
   // in the offset variable we are going to store how many char will be
   // eaten by the token
-  int offset=0;
-  std::string extractedString = extractStringFromMatch(matcher, &offset);
+  int offset = 0;
+  llvm::StringRef extractedString;
+  bool gotMatch;
+  if (mode == LexerMode::SCANNER) {
+    gotMatch = scanToken(start, &extractedString, &offset);
+  } else {
+    gotMatch = std::regex_search(start, matcher, expr,
+                                 std::regex_constants::match_continuous);
+    extractedString = extractStringFromMatch(matcher, &offset);
+  }
   // handling case of not match
   if (!gotMatch) {
     currtok = handleNoMatchFromRegex(start);
@@ -101,7 +477,7 @@ void Lexer::gettok() {
 
     // we skipped the new line and spaces and we go to the new
     // token
-    gettok();
+    lexToken();
     return;
   }
 
@@ -111,12 +487,13 @@ void Lexer::gettok() {
     start += offset;        // eating the token;
     columnNumber += offset; // adding the offset to the column
     identifierStr = extractedString;
+    identifierId = symbol::INVALID_SYMBOL;
     currtok = tok;
     return;
   }
 
   // if is not a built in word it must be an identifier or an ascii value
-  if (isdigit(extractedString[0]) != 0) {
+  if (isdigit(extractedString[0]) != 0 || extractedString[0] == '.') {
     // procerssing number since variables are not allowed to start with a number
     start += offset;        // eating the token;
     columnNumber += offset; // adding the offset to the column
@@ -127,40 +504,99 @@ void Lexer::gettok() {
     start += offset;        // eating the token;
     columnNumber += offset; // adding the offset to the column
     identifierStr = extractedString;
+    // interning once here, later passes only deal with the id
+    identifierId = symbols.intern(extractedString);
     currtok = tok_identifier;
     return;
   }
 }
+bool Lexer::tokenize() {
+  if (start == nullptr) {
+    return false;
+  }
+  tokens.clear();
+  lookAheadToken.clear();
+  useTokenBuffer = false;
+  bool result = true;
+  while (true) {
+    const char *before = start;
+    lexToken();
+    // tokens the lexer cannot make progress on would make us spin forever
+    // so they terminate the buffer as a failed match
+    bool stalled = start == before && currtok != tok_eof;
+    if (stalled) {
+      currtok = tok_no_match;
+    }
+    // before the first name is met the string can still be empty or
+    // point to a previous source, we only store slices of this one
+    bool inSource = identifierStr.data() >= tokenSource &&
+                    identifierStr.data() < start;
+    tokens.kinds.push_back(currtok);
+    tokens.offsets.push_back(
+        inSource ? static_cast<uint32_t>(identifierStr.data() - tokenSource)
+                 : 0);
+    tokens.lengths.push_back(
+        inSource ? static_cast<uint32_t>(identifierStr.size()) : 0);
+    tokens.ids.push_back(identifierId);
+    tokens.values.push_back(value);
+    tokens.lines.push_back(lineNumber);
+    tokens.columns.push_back(columnNumber);
+    if (currtok == tok_eof || currtok == tok_no_match) {
+      result = currtok == tok_eof;
+      break;
+    }
+  }
+  useTokenBuffer = true;
+  rewind();
+  return result;
+}
+
 bool Lexer::lookAhead(int count) {
-  std::string old = identifierStr;
+  if (useTokenBuffer) {
+    // the last token is the terminator, it can't be looked ahead
+    return cursor + static_cast<uint32_t>(count) < tokens.size();
+  }
+  if (count > static_cast<int>(TokenRingBuffer::CAPACITY)) {
+    return false;
+  }
+  llvm::StringRef old = identifierStr;
+  symbol::SymbolId oldId = identifierId;
   int old_tok = currtok;
   Number oldNumb = value;
+  int oldLine = lineNumber;
+  int32_t oldColumn = columnNumber;
 
-  // here we need a temp buffer, we cannot push directly inside
-  // the lookAheadToken queue, otherwise it will be popped right
-  // away from the next gettok(). We write to a temp buffer and then
-  // transfer to the queue, not super pretty, might be a better way
-  std::vector<MovableToken> tempBuffer;
-  tempBuffer.reserve(count);
-
-  for (int t = 0; t < count; ++t) {
-    gettok();
+  // the source pointer is always past the last buffered token, so we
+  // only lex what is missing and append it after what is already there,
+  // resuming from the status the lexer had after that token. The lexer
+  // position is stored with every token so that popping it restores line
+  // and column exactly
+  if (!lookAheadToken.empty()) {
+    const MovableToken &last = lookAheadToken[lookAheadToken.size() - 1];
+    identifierStr = last.identifierStr;
+    identifierId = last.identifierId;
+    value = last.value;
+    lineNumber = last.lineNumber;
+    columnNumber = last.columnNumber;
+  }
+  bool result = true;
+  while (static_cast<int>(lookAheadToken.size()) < count) {
+    lexToken();
     if (currtok == tok_eof || currtok == tok_no_match) {
-      return false;
+      result = false;
+      break;
     }
-    //TODO(giordi): here we are passing 0 as column offset which is wrong and
-    //might be misleading need to find a nice way to get that offset, probably
-    //having gettok() returning the number of char read
-    tempBuffer.emplace_back(MovableToken{currtok, identifierStr, value, 0});
+    lookAheadToken.push_back(MovableToken{currtok, identifierStr, identifierId,
+                                          value, lineNumber, columnNumber});
   }
 
-  for (int t = 0; t < count; ++t) {
-    lookAheadToken.push_back(tempBuffer[t]);
-  }
   identifierStr = old;
+  identifierId = oldId;
   currtok = old_tok;
   value = oldNumb;
-  return true;
+  lineNumber = oldLine;
+  columnNumber = oldColumn;
+  return result;
 }
 
 } // namespace lexer
@@ -0,0 +1,127 @@
+#include "optimizer.h"
+
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+
+#include <chrono>
+
+namespace babycpp {
+namespace codegen {
+
+namespace {
+uint64_t countInstructions(const llvm::Function &function) {
+  uint64_t count = 0;
+  for (const llvm::BasicBlock &block : function) {
+    count += block.size();
+  }
+  return count;
+}
+
+uint64_t countInstructions(const llvm::Module &module) {
+  uint64_t count = 0;
+  for (const llvm::Function &function : module) {
+    count += countInstructions(function);
+  }
+  return count;
+}
+
+double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+} // namespace
+
+void Optimizer::configureBuilder(llvm::PassManagerBuilder *builder) const {
+  const auto optLevel = static_cast<uint32_t>(level);
+  builder->OptLevel = optLevel;
+  builder->SizeLevel = 0;
+  builder->Inliner = llvm::createFunctionInliningPass(optLevel, 0, false);
+  builder->LoopVectorize = vectorize && level >= OptLevel::O2;
+  builder->SLPVectorize = vectorize && level >= OptLevel::O2;
+  if (targetMachine != nullptr) {
+    targetMachine->adjustPassManager(*builder);
+  }
+}
+
+void Optimizer::addTargetPasses(llvm::legacy::PassManagerBase *passes) const {
+  if (targetMachine != nullptr) {
+    passes->add(llvm::createTargetTransformInfoWrapperPass(
+        targetMachine->getTargetIRAnalysis()));
+  }
+}
+
+void Optimizer::prepareModule(llvm::Module *module) const {
+  if (targetMachine != nullptr) {
+    module->setTargetTriple(targetMachine->getTargetTriple().str());
+    module->setDataLayout(targetMachine->createDataLayout());
+  }
+}
+
+llvm::legacy::FunctionPassManager *
+Optimizer::getFunctionPasses(llvm::Module *module) {
+  if (functionPasses != nullptr && functionPassesModule == module) {
+    return functionPasses.get();
+  }
+  functionPasses.reset(new llvm::legacy::FunctionPassManager(module));
+  functionPassesModule = module;
+  prepareModule(module);
+  addTargetPasses(functionPasses.get());
+  llvm::PassManagerBuilder builder;
+  configureBuilder(&builder);
+  builder.populateFunctionPassManager(*functionPasses);
+  functionPasses->doInitialization();
+  return functionPasses.get();
+}
+
+void Optimizer::clearPipelines() {
+  functionPasses.reset();
+  functionPassesModule = nullptr;
+}
+
+bool Optimizer::optimizeFunction(llvm::Function *function) {
+  if (level == OptLevel::O0 || function->empty()) {
+    return false;
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  stats.instructionsBefore += countInstructions(*function);
+  bool changed = getFunctionPasses(function->getParent())->run(*function);
+  stats.instructionsAfter += countInstructions(*function);
+  ++stats.functionsOptimized;
+  stats.functionMilliseconds += millisecondsSince(start);
+  return changed;
+}
+
+bool Optimizer::optimizeModule(llvm::Module *module) {
+  if (level == OptLevel::O0) {
+    return false;
+  }
+  bool changed = false;
+  if (!runPerFunction) {
+    for (llvm::Function &function : *module) {
+      changed |= optimizeFunction(&function);
+    }
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  const uint64_t before = countInstructions(*module);
+  prepareModule(module);
+  llvm::legacy::PassManager modulePasses;
+  addTargetPasses(&modulePasses);
+  llvm::PassManagerBuilder builder;
+  configureBuilder(&builder);
+  builder.populateModulePassManager(modulePasses);
+  changed |= modulePasses.run(*module);
+  // the function pipeline is bound to the functions it has seen, the
+  // inliner might have deleted some of them
+  clearPipelines();
+
+  ++stats.modulesOptimized;
+  stats.moduleMilliseconds += millisecondsSince(start);
+  stats.moduleInstructionsBefore += before;
+  stats.moduleInstructionsAfter += countInstructions(*module);
+  return changed;
+}
+
+} // namespace codegen
+} // namespace babycpp
@@ -0,0 +1,188 @@
+#include "parallelCodegen.h"
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/DiagnosticPrinter.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+namespace babycpp {
+namespace codegen {
+
+namespace {
+// protos holds the prototype of every statement before the block of the
+// worker, nullptr for statements that have none
+void prepareWorker(Codegenerator *worker, Codegenerator *gen,
+                   llvm::ArrayRef<PrototypeAST *> protos) {
+  // ids are dense and given in order, interning the names of gen in
+  // order gives the worker the very same ids
+  const symbol::SymbolTable &symbols = gen->lexer.symbols;
+  assert(worker->lexer.symbols.size() == 0);
+  for (uint32_t id = 0; id < symbols.size(); ++id) {
+    worker->lexer.symbols.intern(symbols.getName(id));
+  }
+  worker->optimizer.level = gen->optimizer.level;
+  worker->optimizer.runPerFunction = gen->optimizer.runPerFunction;
+  if (gen->builtinFunctionsLoaded) {
+    worker->doLoadBuiltinFunctions();
+  }
+  // prototypes from previous compilations and from the statements before
+  // the block, as a single pass would know them, a call to a function
+  // defined further down fails the same way it does in a single pass. The
+  // declarations are generated in the worker module only when used
+  for (symbol::SymbolId id : gen->functionProtos.touched) {
+    worker->functionProtos[id] = gen->functionProtos.lookup(id);
+  }
+  for (PrototypeAST *proto : protos) {
+    if (proto != nullptr) {
+      worker->functionProtos[proto->nameId] = proto;
+    }
+  }
+}
+
+void logLinkError(Codegenerator *gen, const std::string &msg) {
+  diagnostic::Issue issue{msg, 0, 0, diagnostic::IssueType::CODEGEN,
+                          diagnostic::IssueCode::MODULE_LINK_FAILURE};
+  gen->diagnostic.pushError(issue);
+}
+
+// the linker reports through the context, whose default handler exits the
+// process on errors, the messages are collected instead
+struct LinkDiagnosticHandler : llvm::DiagnosticHandler {
+  explicit LinkDiagnosticHandler(std::string *inMessages)
+      : messages(inMessages) {}
+  bool handleDiagnostics(const llvm::DiagnosticInfo &info) override {
+    llvm::raw_string_ostream stream(*messages);
+    llvm::DiagnosticPrinterRawOStream printer(stream);
+    info.print(printer);
+    stream << "\n";
+    return true;
+  }
+  std::string *messages;
+};
+} // namespace
+
+std::vector<std::unique_ptr<Codegenerator>>
+generateInParallel(Codegenerator *gen, llvm::ArrayRef<ExprAST *> statements,
+                   uint32_t workerCount) {
+  if (workerCount == 0) {
+    workerCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const auto statementCount = static_cast<uint32_t>(statements.size());
+  workerCount = std::max(1u, std::min(workerCount, statementCount));
+
+  // prototypes are read by all the workers, their ids and the ones of
+  // their arguments get resolved here once so that no worker has to write
+  // them
+  std::vector<PrototypeAST *> protos(statementCount, nullptr);
+  for (uint32_t i = 0; i < statementCount; ++i) {
+    PrototypeAST *proto = nullptr;
+    if (statements[i]->nodetype == PrototypeNode) {
+      proto = static_cast<PrototypeAST *>(statements[i]);
+    } else if (statements[i]->nodetype == FunctionNode) {
+      proto = static_cast<FunctionAST *>(statements[i])->proto;
+    }
+    if (proto != nullptr) {
+      proto->nameId = gen->resolveSymbol(proto->nameId, proto->name);
+      for (Argument &arg : proto->args) {
+        arg.nameId = gen->resolveSymbol(arg.nameId, arg.name);
+      }
+      protos[i] = proto;
+    }
+  }
+
+  std::vector<std::unique_ptr<Codegenerator>> workers;
+  workers.reserve(workerCount);
+  for (uint32_t i = 0; i < workerCount; ++i) {
+    const uint32_t first = i * statementCount / workerCount;
+    workers.emplace_back(new Codegenerator);
+    prepareWorker(workers.back().get(), gen,
+                  llvm::ArrayRef<PrototypeAST *>(protos).slice(0, first));
+  }
+
+  auto generateBlock = [statements, statementCount,
+                        workerCount](Codegenerator *worker, uint32_t index) {
+    const uint32_t first = index * statementCount / workerCount;
+    const uint32_t last = (index + 1) * statementCount / workerCount;
+    for (uint32_t i = first; i < last; ++i) {
+      statements[i]->codegen(worker);
+    }
+  };
+  // the calling thread takes the first block
+  std::vector<std::thread> threads;
+  threads.reserve(workerCount);
+  for (uint32_t i = 1; i < workerCount; ++i) {
+    threads.emplace_back(generateBlock, workers[i].get(), i);
+  }
+  generateBlock(workers[0].get(), 0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (auto &worker : workers) {
+    while (worker->diagnostic.hasErrors()) {
+      diagnostic::Issue issue = worker->diagnostic.getError();
+      gen->diagnostic.pushError(issue);
+    }
+  }
+  return workers;
+}
+
+bool linkWorkerModules(Codegenerator *gen,
+                       std::vector<std::unique_ptr<Codegenerator>> *workers) {
+  std::unique_ptr<llvm::DiagnosticHandler> previousHandler =
+      gen->context.getDiagnosticHandler();
+  std::string linkMessages;
+  gen->context.setDiagnosticHandler(
+      std::make_unique<LinkDiagnosticHandler>(&linkMessages));
+
+  bool linked = true;
+  for (auto &worker : *workers) {
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream stream(bitcode);
+    llvm::WriteBitcodeToFile(*worker->module, stream);
+
+    llvm::MemoryBufferRef buffer(llvm::StringRef(bitcode.data(), bitcode.size()),
+                                 "worker");
+    llvm::Expected<std::unique_ptr<llvm::Module>> parsed =
+        llvm::parseBitcodeFile(buffer, gen->context);
+    if (!parsed) {
+      logLinkError(gen, "cannot read back the module of a codegen worker: " +
+                            llvm::toString(parsed.takeError()));
+      linked = false;
+      break;
+    }
+    // functions defined in more than one module fail here
+    if (llvm::Linker::linkModules(*gen->module, std::move(*parsed))) {
+      logLinkError(gen, "cannot link the module of a codegen worker: " +
+                            linkMessages);
+      linked = false;
+      break;
+    }
+    worker->module.reset();
+  }
+  gen->context.setDiagnosticHandler(std::move(previousHandler));
+  if (!linked) {
+    return false;
+  }
+  // every worker registered the prototypes it knows in its own map, the
+  // functions now live in the module of gen so later compilations of the
+  // session can call them
+  for (auto &worker : *workers) {
+    for (symbol::SymbolId id : worker->functionProtos.touched) {
+      PrototypeAST *proto = worker->functionProtos.lookup(id);
+      if (proto != nullptr) {
+        gen->functionProtos[id] = proto;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace codegen
+} // namespace babycpp
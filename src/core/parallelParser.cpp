@@ -0,0 +1,191 @@
+#include "parallelParser.h"
+#include "visitorAST.h"
+
+#include <llvm/ADT/DenseSet.h>
+
+#include <algorithm>
+#include <thread>
+
+namespace babycpp {
+namespace parser {
+
+using codegen::ExprAST;
+
+namespace {
+// rewrites the ids of the nodes from the worker symbol table to the
+// target one, with hash consing the AST is a DAG so shared nodes are
+// remapped only once. Every node goes through the visited set, the cons
+// table only knows the nodes of the last parsed function
+struct SymbolRemapper : codegen::VisitorAST<SymbolRemapper> {
+  explicit SymbolRemapper(const std::vector<symbol::SymbolId> *inremap)
+      : remap(inremap) {}
+
+  symbol::SymbolId map(symbol::SymbolId id) const {
+    return id != symbol::INVALID_SYMBOL ? (*remap)[id] : id;
+  }
+  void visitNode(ExprAST *node) {
+    if (!visited.insert(node).second) {
+      return;
+    }
+    switch (node->nodetype) {
+    case codegen::VariableNode: {
+      auto *variable = static_cast<codegen::VariableExprAST *>(node);
+      variable->nameId = map(variable->nameId);
+      break;
+    }
+    case codegen::CallNode: {
+      auto *call = static_cast<codegen::CallExprAST *>(node);
+      call->calleeId = map(call->calleeId);
+      break;
+    }
+    case codegen::PrototypeNode: {
+      auto *proto = static_cast<codegen::PrototypeAST *>(node);
+      proto->nameId = map(proto->nameId);
+      for (codegen::Argument &arg : proto->args) {
+        arg.nameId = map(arg.nameId);
+      }
+      break;
+    }
+    case codegen::DereferenceNode: {
+      auto *deref = static_cast<codegen::DereferenceAST *>(node);
+      deref->identifierId = map(deref->identifierId);
+      break;
+    }
+    case codegen::ToPointerAssigmentNode: {
+      auto *assigment = static_cast<codegen::ToPointerAssigmentAST *>(node);
+      assigment->identifierId = map(assigment->identifierId);
+      break;
+    }
+    default:
+      break;
+    }
+    codegen::forEachChild(node, [this](ExprAST *child) { visit(child); });
+  }
+
+  const std::vector<symbol::SymbolId> *remap;
+  llvm::DenseSet<ExprAST *> visited;
+};
+} // namespace
+
+std::vector<SourceRange> splitTopLevelStatements(llvm::StringRef source,
+                                                 uint32_t rangeCount) {
+  std::vector<SourceRange> ranges;
+  const auto size = static_cast<uint32_t>(source.size());
+  rangeCount = std::max(1u, rangeCount);
+  const uint32_t target = size / rangeCount;
+
+  SourceRange current{0, 0, 1};
+  int depth = 0;
+  int line = 1;
+  for (uint32_t i = 0; i < size; ++i) {
+    const char c = source[i];
+    if (c == '\n') {
+      ++line;
+      continue;
+    }
+    bool statementEnd = false;
+    if (c == '{') {
+      ++depth;
+    } else if (c == '}') {
+      // an unbalanced } is left to the parser to complain about
+      depth = std::max(0, depth - 1);
+      statementEnd = depth == 0;
+    } else if (c == ';') {
+      statementEnd = depth == 0;
+    }
+    // cutting at the first statement end past the ideal cut, measured
+    // from the start of the source so a long range does not shift all
+    // the following ones, the last range takes whatever is left
+    const auto rangesDone = static_cast<uint32_t>(ranges.size());
+    if (statementEnd && rangesDone + 1 < rangeCount &&
+        i + 1 >= (rangesDone + 1) * target) {
+      current.end = i + 1;
+      ranges.push_back(current);
+      current = SourceRange{i + 1, 0, line};
+    }
+  }
+  current.end = size;
+  // trailing white spaces are not worth a range of their own
+  if (!ranges.empty() && source.substr(current.begin).trim().empty()) {
+    ranges.back().end = size;
+  } else {
+    ranges.push_back(current);
+  }
+  return ranges;
+}
+
+void ParseWorker::parse(llvm::StringRef source, const SourceRange &range) {
+  lexer.initFromString(source.slice(range.begin, range.end).str());
+  // so that the diagnostic refers to the lines of the whole source
+  lexer.lineNumber = range.line;
+  lexer.gettok();
+
+  parser.recoverFromErrors = true;
+  while (lexer.currtok != Token::tok_eof) {
+    const int errorsBefore = diagnostic.hasErrors();
+    ExprAST *res = parser.parseStatement();
+    if (res != nullptr && diagnostic.hasErrors() == errorsBefore) {
+      statements.push_back(res);
+      continue;
+    }
+    if (lexer.currtok == Token::tok_no_match) {
+      stoppedEarly = true;
+      break;
+    }
+    if (lexer.currtok == Token::tok_close_curly) {
+      lexer.gettok();
+    }
+  }
+}
+
+void ParseWorker::remapSymbols(symbol::SymbolTable *symbols) {
+  const symbol::SymbolTable &local = lexer.symbols;
+  std::vector<symbol::SymbolId> remap(local.size());
+  for (uint32_t id = 0; id < local.size(); ++id) {
+    remap[id] = symbols->intern(local.getName(id));
+  }
+  SymbolRemapper remapper(&remap);
+  for (ExprAST *statement : statements) {
+    remapper.visit(statement);
+  }
+}
+
+std::vector<std::unique_ptr<ParseWorker>>
+parseInParallel(llvm::StringRef source, uint32_t workerCount,
+                symbol::SymbolTable *symbols, bool hashConsing) {
+  if (workerCount == 0) {
+    workerCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const std::vector<SourceRange> ranges =
+      splitTopLevelStatements(source, workerCount);
+
+  std::vector<std::unique_ptr<ParseWorker>> workers;
+  workers.reserve(ranges.size());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    workers.emplace_back(new ParseWorker);
+    workers.back()->factory.hashConsing = hashConsing;
+  }
+
+  // the calling thread takes the first range
+  std::vector<std::thread> threads;
+  threads.reserve(ranges.size());
+  for (size_t i = 1; i < ranges.size(); ++i) {
+    ParseWorker *worker = workers[i].get();
+    const SourceRange &range = ranges[i];
+    threads.emplace_back(
+        [worker, source, &range]() { worker->parse(source, range); });
+  }
+  workers[0]->parse(source, ranges[0]);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // the symbol table is not thread safe, remapping happens here
+  for (auto &worker : workers) {
+    worker->remapSymbols(symbols);
+  }
+  return workers;
+}
+
+} // namespace parser
+} // namespace babycpp
@@ -1,6 +1,8 @@
 #include "parser.h"
 #include "codegen.h"
 
+#include <llvm/ADT/SmallVector.h>
+
 #include <iostream>
 
 namespace babycpp {
@@ -15,9 +17,6 @@ using codegen::VariableExprAST;
 using diagnostic::IssueCode;
 using lexer::Token;
 
-const std::unordered_map<char, int> Parser::BIN_OP_PRECEDENCE = {
-    {'<', 10}, {'+', 20}, {'-', 20}, {'*', 40}, {'/', 50}};
-
 // ERROR LOGGING
 inline void logParserError(const std::string &msg, Lexer *lexer,
                            IssueCode code) {
@@ -41,6 +40,7 @@ bool parseStatementsUntillCurly(std::vector<ExprAST *> *statements,
   Lexer *lex = parser->lex;
   const int SECURITY = 2000;
   int counter = 0;
+  bool succeeded = true;
   while ((static_cast<int>(lex->currtok != Token::tok_close_curly) &
           static_cast<int>(counter < SECURITY)) != 0) {
     // there might be the case where you have a else statement before anything
@@ -55,10 +55,15 @@ bool parseStatementsUntillCurly(std::vector<ExprAST *> *statements,
     }
     auto *curr_statement = parser->parseStatement();
     if (curr_statement == nullptr) {
-      // error should be handled by parse statement;
-      return false;
+      // error should be handled by parse statement, when recovering
+      // parseStatement already skipped the broken statement for us
+      if (!parser->recoverFromErrors || lex->currtok == Token::tok_no_match) {
+        return false;
+      }
+      succeeded = false;
+    } else {
+      statements->push_back(curr_statement);
     }
-    statements->push_back(curr_statement);
 
     // check if we are at end of file
     if (lex->currtok == Token::tok_eof) {
@@ -77,45 +82,40 @@ bool parseStatementsUntillCurly(std::vector<ExprAST *> *statements,
                    parser, IssueCode::EXPECTED_TOKEN);
     return false;
   }
-  return true;
+  return succeeded;
 }
 inline bool isPointerCast(Lexer *lex) {
 
-  // this function expects 3 look ahead tokens
-  return (Parser::isDatatype(lex->lookAheadToken[0].token) &
-          (lex->lookAheadToken[1].token == Token::tok_operator) &
-          (lex->lookAheadToken[1].identifierStr == "*") &
-          (lex->lookAheadToken[2].token == Token::tok_close_round));
+  // this function expects 3 look ahead tokens, near the end of the source
+  // there might be fewer
+  return lex->lookAheadSize() >= 3 &&
+         Parser::isDatatype(lex->peekToken(0).token) &&
+         lex->peekToken(1).token == Token::tok_operator &&
+         lex->peekToken(1).identifierStr == "*" &&
+         lex->peekToken(2).token == Token::tok_close_round;
 }
 inline bool isDataCast(Lexer *lex) {
   // this function expects 2 look ahead tokens
-  return (Parser::isDatatype(lex->lookAheadToken[0].token) &
-          (lex->lookAheadToken[1].token == Token::tok_close_round));
+  return lex->lookAheadSize() >= 2 &&
+         Parser::isDatatype(lex->peekToken(0).token) &&
+         lex->peekToken(1).token == Token::tok_close_round;
 }
 
 // this call assumes the lookahead to be already done
 inline bool isCastOperation(Lexer *lex) {
 
-  return (isPointerCast(lex) | isDataCast(lex));
+  return isPointerCast(lex) || isDataCast(lex);
 }
 
-// this function defines whether or not a token is a declaration
-// token or not, meaning defining an external function or datatype.
-// interesting to think of casting as "anonymous declaration maybe?"
-inline int getTokPrecedence(Lexer *lex) {
-  if (lex->currtok != Token::tok_operator) {
-    // TODO(giordi) explain the -1 here
-    return -1;
+// returns the binary operator the current token represents, OP_NONE if
+// the token is not a binary operator
+inline BinaryOp getBinaryOperator(Lexer *lex) {
+  if (lex->currtok != Token::tok_operator &&
+      lex->currtok != Token::tok_assigment_operator) {
+    return OP_NONE;
   }
-
-  const char op = lex->identifierStr[0];
-  auto iter = Parser::BIN_OP_PRECEDENCE.find(op);
-  if (iter != Parser::BIN_OP_PRECEDENCE.end()) {
-    return iter->second;
-  }
-  // should never reach this since all edge cases are taken by
-  // the tok check
-  return -1;
+  return findBinaryOperator(lex->identifierStr.data(),
+                            lex->identifierStr.size());
 }
 
 // PARSING
@@ -123,19 +123,20 @@ NumberExprAST *Parser::parseNumber() {
   if (lex->currtok != Token::tok_number) {
     return nullptr;
   }
-  auto *node = factory->allocNuberAST(lex->value);
+  auto *node = factory->consNumberAST(lex->value);
   lex->gettok(); // eating the number;
   return node;
 }
 
 ExprAST *Parser::parseIdentifier() {
-  const std::string idstr = lex->identifierStr;
+  const llvm::StringRef idstr = lex->identifierStr;
+  const symbol::SymbolId idSymbol = lex->identifierId;
   // look ahead and eat identifier;
   lex->gettok();
 
   int tok = lex->currtok;
   if (tok != Token::tok_open_round) {
-    return factory->allocVariableAST(idstr, nullptr, 0);
+    return factory->consVariableAST(idstr, idSymbol);
   }
   lex->gettok(); // eating paren;
   std::vector<ExprAST *> args;
@@ -169,77 +170,160 @@ ExprAST *Parser::parseIdentifier() {
     }
   }
   lex->gettok(); // eat )
-  return factory->allocCallexprAST(idstr, args);
+  return factory->allocCallexprAST(idstr, args, idSymbol);
+}
+
+namespace {
+// entry of the operators stack of parseExpression, an open paren is
+// pushed as a marker with OP_NONE
+struct PendingOperator {
+  BinaryOp op;
+  llvm::StringRef opStr;
+};
+
+// RAII guard keeping track of how deep parseExpression is nested
+struct ExpressionDepthGuard {
+  explicit ExpressionDepthGuard(int *depth) : depth(depth) { ++(*depth); }
+  ~ExpressionDepthGuard() { --(*depth); }
+  int *depth;
+};
+} // namespace
+
+ExprAST *Parser::makeBinaryNode(BinaryOp op, llvm::StringRef opStr,
+                                ExprAST *LHS, ExprAST *RHS) {
+  const BinaryOperatorInfo &info = BINARY_OPERATORS[op];
+  if (!info.isAssignment) {
+    return factory->consBinaryAST(opStr, LHS, RHS);
+  }
+
+  if (LHS->nodetype != codegen::VariableNode) {
+    logParserError("LHS of assigment operator must be a variable", lex,
+                   IssueCode::EXPECTED_VARIABLE);
+    return nullptr;
+  }
+  if (flags.processed_assigment) {
+    logParserError("cannot have multiple assignment in a statement", lex,
+                   IssueCode::EXPECTED_VARIABLE);
+    return nullptr;
+  }
+  flags.processed_assigment = true;
+
+  // the variable is going to get a value, it can't be a shared read
+  LHS = factory->unshare(LHS);
+  auto *LHScasted = static_cast<VariableExprAST *>(LHS);
+  if (op != OP_ASSIGN) {
+    // compound assignment, x op= y is x = x op y, the operator is the
+    // slice without the trailing =
+    auto *current =
+        factory->consVariableAST(LHScasted->name, LHScasted->nameId);
+    RHS = factory->consBinaryAST(opStr.drop_back(1), current, RHS);
+  }
+  // setting the right hand side as value;
+  LHScasted->value = RHS;
+  return LHS;
 }
 
 ExprAST *Parser::parseExpression() {
-  ExprAST *LHS = parsePrimary();
-  if (LHS == nullptr) {
+  ExpressionDepthGuard guard(&expressionDepth);
+  if (expressionDepth > MAX_EXPRESSION_DEPTH) {
+    logParserError("expression nested too deeply", lex,
+                   IssueCode::EXPRESSION_TOO_DEEP);
     return nullptr;
   }
-  if (lex->currtok == Token::tok_assigment_operator) {
-    if (!flags.processed_assigment) {
 
-      flags.processed_assigment = true;
-      lex->gettok(); // eating assignment operator;
+  // operands and operators waiting for their RHS, reducing the top of the
+  // stacks whenever an operator with lower binding power shows up
+  llvm::SmallVector<ExprAST *, 16> operands;
+  llvm::SmallVector<PendingOperator, 16> operators;
+  int openParens = 0;
+
+  auto reduce = [&]() -> bool {
+    PendingOperator pending = operators.pop_back_val();
+    ExprAST *RHS = operands.pop_back_val();
+    ExprAST *LHS = operands.pop_back_val();
+    ExprAST *node = makeBinaryNode(pending.op, pending.opStr, LHS, RHS);
+    if (node == nullptr) {
+      return false;
+    }
+    operands.push_back(node);
+    return true;
+  };
 
-      auto *RHS = parseExpression();
-      if (RHS == nullptr) {
+  while (true) {
+    // grouping parenthesis are pushed as markers, casts are left to
+    // parsePrimary
+    while (lex->currtok == Token::tok_open_round) {
+      lex->lookAhead(3);
+      if (isCastOperation(lex)) {
+        break;
+      }
+      lex->gettok(); // eating (
+      operators.push_back(PendingOperator{OP_NONE, llvm::StringRef()});
+      ++openParens;
+    }
+
+    ExprAST *operand = parsePrimary();
+    if (operand == nullptr) {
+      if (!operators.empty() && operators.back().op != OP_NONE &&
+          BINARY_OPERATORS[operators.back().op].isAssignment) {
         logParserError("expected valid expression of RHS of assigment operator",
                        lex, IssueCode::EXPECTED_VARIABLE);
-        return nullptr;
       }
-      if (LHS->nodetype != codegen::VariableNode) {
-
-        logParserError("LHS of assigment operator must be a variable got:" +
+      if (openParens > 0 && lex->currtok != Token::tok_close_round) {
+        logParserError("expected close paren after expression got:" +
                            std::to_string(lex->currtok),
-                       lex, IssueCode::EXPECTED_VARIABLE);
-        return nullptr;
+                       this, IssueCode::EXPECTED_TOKEN);
       }
-
-      // setting the right hand side as value;
-      auto *LHScasted = static_cast<VariableExprAST *>(LHS);
-      LHScasted->value = RHS;
-      return LHS;
+      return nullptr;
     }
-
-    // having hard time to replicate this, is mostly prevented by other errors
-    // check if i find a way to trigger it i ll add a test for it
-    std::cout << "error,  cannot have multiple assignment in a statement"
-              << std::endl;
-    return nullptr;
-  }
-  return parseBinOpRHS(0, LHS);
-}
-
-ExprAST *Parser::parseBinOpRHS(int givenPrec, ExprAST *LHS) {
-  while (true) {
-    int tokPrec = getTokPrecedence(lex);
-
-    // if this bin op is less then the current one  we eat it;
-    if (tokPrec < givenPrec) {
-      return LHS;
+    operands.push_back(operand);
+
+    // closing the parenthesis we opened, a ) we did not open belongs to
+    // an outer construct like a function call or an if
+    while (lex->currtok == Token::tok_close_round && openParens > 0) {
+      while (operators.back().op != OP_NONE) {
+        if (!reduce()) {
+          return nullptr;
+        }
+      }
+      operators.pop_back();
+      --openParens;
+      lex->gettok(); // eating )
     }
 
-    std::string op = lex->identifierStr;
-    lex->gettok();
-    ExprAST *RHS = parsePrimary();
-    if (RHS == nullptr) {
-      return nullptr;
+    BinaryOp op = getBinaryOperator(lex);
+    if (op == OP_NONE) {
+      break;
     }
-
-    // if the bin op binds less tightly with RHS than the OP
-    // after RHS, let the pending op take RHS its LHS
-    int nextPrec = getTokPrecedence(lex);
-    if (tokPrec < nextPrec) {
-      RHS = parseBinOpRHS(tokPrec + 1, RHS);
-      if (RHS == nullptr) {
+    const BinaryOperatorInfo &info = BINARY_OPERATORS[op];
+    while (!operators.empty() && operators.back().op != OP_NONE) {
+      int topPrecedence = BINARY_OPERATORS[operators.back().op].precedence;
+      bool topBindsTighter =
+          topPrecedence > info.precedence ||
+          (topPrecedence == info.precedence && !info.rightAssociative);
+      if (!topBindsTighter) {
+        break;
+      }
+      if (!reduce()) {
         return nullptr;
       }
     }
+    operators.push_back(PendingOperator{op, lex->identifierStr});
+    lex->gettok(); // eating the operator
+  }
 
-    LHS = factory->allocBinaryAST(op, LHS, RHS);
+  if (openParens > 0) {
+    logParserError("expected close paren after expression got:" +
+                       std::to_string(lex->currtok),
+                   this, IssueCode::EXPECTED_TOKEN);
+    return nullptr;
   }
+  while (!operators.empty()) {
+    if (!reduce()) {
+      return nullptr;
+    }
+  }
+  return operands.back();
 }
 
 ExprAST *Parser::parsePrimary() {
@@ -304,7 +388,8 @@ ExprAST *Parser::parseAssigment() {
   }
 
   // next we eat the identifier;
-  std::string identifier = lex->identifierStr;
+  llvm::StringRef identifier = lex->identifierStr;
+  symbol::SymbolId identifierId = lex->identifierId;
   lex->gettok(); // eat identifier;
 
   lex->gettok(); // eat = operator
@@ -314,7 +399,8 @@ ExprAST *Parser::parseAssigment() {
                    IssueCode::CANNOT_GENERATE_RHS);
     return nullptr;
   }
-  ExprAST *node = factory->allocVariableAST(identifier, RHS, datatype);
+  ExprAST *node =
+      factory->allocVariableAST(identifier, RHS, datatype, identifierId);
   node->flags.isDefinition = true;
   node->flags.isPointer = isPtr;
 
@@ -330,11 +416,12 @@ ExprAST *Parser::parseDeclaration() {
   // looking ahead 2 tokens, which should give us the identifier
   // and the next token
 
-  // const lexer::MovableToken& nextTok= lex->lookAheadToken[0];
-  if (lex->lookAheadToken[0].token == Token::tok_identifier) {
+  // const lexer::MovableToken& nextTok= lex->peekToken(0);
+  const uint32_t available = lex->lookAheadSize();
+  if (available >= 2 && lex->peekToken(0).token == Token::tok_identifier) {
     // we got an identifier great, now the next token will
     // tell us whether is a function prototype or a variable
-    switch (lex->lookAheadToken[1].token) {
+    switch (lex->peekToken(1).token) {
     case Token::tok_open_round: {
 
       return parseFunction();
@@ -344,8 +431,8 @@ ExprAST *Parser::parseDeclaration() {
       // first we need to check if the tok is pointer and wheter or not we got a
       // * operator after
       if ((lex->currtok == Token::tok_void_ptr) &&
-          !(lex->lookAheadToken[0].token == Token::tok_operator &&
-            lex->lookAheadToken[0].identifierStr == "*")) {
+          !(lex->peekToken(0).token == Token::tok_operator &&
+            lex->peekToken(0).identifierStr == "*")) {
         logParserError("expected * after void, cannot use void as not pointer "
                        "type, got :" +
                            std::to_string(lex->currtok),
@@ -362,8 +449,9 @@ ExprAST *Parser::parseDeclaration() {
       return nullptr;
     }
     }
-  } else if (lex->lookAheadToken[0].token == Token::tok_operator) {
-    if (lex->lookAheadToken[0].identifierStr != "*") {
+  } else if (available >= 3 &&
+             lex->peekToken(0).token == Token::tok_operator) {
+    if (lex->peekToken(0).identifierStr != "*") {
 
       logParserError(
           "only supported operator after datatype is * for pointers, got" +
@@ -372,7 +460,7 @@ ExprAST *Parser::parseDeclaration() {
       return nullptr;
     }
 
-    switch (lex->lookAheadToken[2].token) {
+    switch (lex->peekToken(2).token) {
     case Token::tok_open_round: {
       return parseFunction();
     }
@@ -399,16 +487,20 @@ ExprAST *Parser::parseStatement() {
 
   ExprAST *exp = nullptr;
   bool expectSemicolon = true;
+  const int errorsBefore = diagnostic->hasErrors();
   if (lex->currtok == Token::tok_extern) {
     exp = parseExtern();
   } else if (lex->currtok == Token::tok_return) {
     lex->gettok(); // eat return
     exp = parseExpression();
-    exp->flags.isReturn = true;
+    if (exp != nullptr) {
+      exp = factory->unshare(exp);
+      exp->flags.isReturn = true;
+    }
   } else if (isDeclarationToken(lex->currtok)) {
     exp = parseDeclaration();
     if (exp == nullptr) {
-      return nullptr;
+      return recoverStatement(false, errorsBefore);
     }
     if (exp->nodetype == codegen::FunctionNode) {
       expectSemicolon = false;
@@ -433,12 +525,19 @@ ExprAST *Parser::parseStatement() {
   // TODO(giordi) support statement starting with parenthesis
   // if (lex->currtok == Token::tok_open_paren){}
 
+  // when recovering we skip straight away to the next statement rather
+  // than reporting the missing ; the failure most likely caused
+  if (recoverFromErrors && exp == nullptr &&
+      diagnostic->hasErrors() > errorsBefore) {
+    return recoverStatement(!expectSemicolon, errorsBefore);
+  }
+
   if (lex->currtok != Token::tok_end_statement && expectSemicolon) {
     logParserError("expecting semicolon at end of statement got:" +
                        std::to_string(lex->currtok),
                    lex, IssueCode::EXPECTED_END_STATEMENT_TOKEN);
     // return exp;
-    return nullptr;
+    return recoverStatement(false, errorsBefore);
   }
   if (lex->currtok == Token::tok_end_statement) {
     lex->gettok(); // eating semicolon;
@@ -465,7 +564,8 @@ PrototypeAST *Parser::parseExtern() {
 bool parseArguments(Lexer *lex, std::vector<Argument> *args) {
   int datatype;
   bool isPointer = false;
-  std::string argName;
+  llvm::StringRef argName;
+  symbol::SymbolId argId;
   while (true) {
     isPointer = false;
     if (lex->currtok == Token::tok_close_round) {
@@ -498,7 +598,9 @@ bool parseArguments(Lexer *lex, std::vector<Argument> *args) {
     }
 
     // storing name
+    // slice of the source, the factory copies it with the prototype
     argName = lex->identifierStr;
+    argId = lex->identifierId;
     lex->gettok(); // eating identifier name
 
     // finally checking if we have a comma or paren
@@ -514,7 +616,7 @@ bool parseArguments(Lexer *lex, std::vector<Argument> *args) {
       }
     }
     // if we got here we have a sanitized argument
-    args->emplace_back(Argument(datatype, argName, isPointer));
+    args->emplace_back(Argument(datatype, argName, isPointer, argId));
   }
   return true;
 }
@@ -528,6 +630,9 @@ FunctionAST *Parser::parseFunction() {
   }
   // setting the prototype as not extern
   proto->isExtern = false;
+  // variables read in the body resolve in this function scope only, they
+  // can't be shared with the nodes of the previous functions
+  factory->clearConsTable();
 
   // we expect an open curly brace starting the body of the function
   if (lex->currtok != Token::tok_open_curly) {
@@ -540,7 +645,10 @@ FunctionAST *Parser::parseFunction() {
   lex->gettok(); // eating curly
   std::vector<ExprAST *> statements;
   bool res = parseStatementsUntillCurly(&statements, this);
-  if (!res) {
+  // when recovering, a body that reached its } is still returned with the
+  // broken statements left out, the errors are in the diagnostic
+  bool recovered = recoverFromErrors && lex->currtok == Token::tok_close_curly;
+  if (!res && !recovered) {
     return nullptr;
   }
 
@@ -558,6 +666,62 @@ FunctionAST *Parser::parseFunction() {
   return factory->allocFunctionAST(proto, statements);
 }
 
+ExprAST *Parser::recoverStatement(bool isBlockStatement, int errorsBefore) {
+  if (!recoverFromErrors || diagnostic->hasErrors() == errorsBefore) {
+    return nullptr;
+  }
+  if (isBlockStatement && lex->currtok == Token::tok_close_curly) {
+    // if and for bodies recover on their own, when they fail anyway we are
+    // left on the } closing them
+    flags.processed_assigment = false;
+    lex->gettok(); // eating }
+    if (lex->currtok == Token::tok_else) {
+      // the else branch goes down together with its if
+      lex->gettok(); // eating else
+      synchronize();
+    }
+    return nullptr;
+  }
+  synchronize();
+  return nullptr;
+}
+
+void Parser::synchronize() {
+  // clearing flags, the statement they refer to is being dropped
+  flags.processed_assigment = false;
+  int depth = 0;
+  while (true) {
+    switch (lex->currtok) {
+    case Token::tok_eof:
+    case Token::tok_no_match:
+      // the lexer cannot move past a failed match, nothing to skip to
+      return;
+    case Token::tok_end_statement:
+      if (depth == 0) {
+        lex->gettok(); // eating ;
+        return;
+      }
+      break;
+    case Token::tok_open_curly:
+      ++depth;
+      break;
+    case Token::tok_close_curly:
+      if (depth == 0) {
+        // this closes the enclosing block, left to its parser
+        return;
+      }
+      if (--depth == 0) {
+        lex->gettok(); // eating }, the skipped block was the statement
+        return;
+      }
+      break;
+    default:
+      break;
+    }
+    lex->gettok();
+  }
+}
+
 ExprAST *Parser::parseParen() {
 
   // here we need to figure out if we have a generic expression or a type cast
@@ -681,11 +845,18 @@ codegen::ExprAST *Parser::parseForStatement() {
   // at this point we expect a variable declaration + assigment or
   // variable + assigment
   lex->lookAhead(2);
+  // the source might end inside the header, leaving fewer tokens to peek
+  const uint32_t needed = isDatatype(lex->currtok) ? 2 : 1;
+  if (lex->lookAheadSize() < needed) {
+    logParserError("unexpected end of source in for loop header", lex,
+                   IssueCode::EXPECTED_TOKEN);
+    return nullptr;
+  }
   ExprAST *initialisationExp = nullptr;
   if (isDatatype(lex->currtok)) {
     // if is a datatype we then expect an identifier and an assigment
 
-    if (lex->lookAheadToken[0].token != Token::tok_identifier) {
+    if (lex->peekToken(0).token != Token::tok_identifier) {
 
       logParserError("expected identifier after datatype in for loop variable "
                      "initalisation got:" +
@@ -693,7 +864,7 @@ codegen::ExprAST *Parser::parseForStatement() {
                      lex, IssueCode::EXPECTED_IDENTIFIER_NAME);
       return nullptr;
     }
-    if (lex->lookAheadToken[1].token != Token::tok_assigment_operator) {
+    if (lex->peekToken(1).token != Token::tok_assigment_operator) {
 
       logParserError("expected assigment operator after varible declaration in "
                      "for loop header got:" +
@@ -704,7 +875,7 @@ codegen::ExprAST *Parser::parseForStatement() {
 
     initialisationExp = parseStatement();
   } else {
-    if (lex->lookAheadToken[0].token != Token::tok_assigment_operator) {
+    if (lex->peekToken(0).token != Token::tok_assigment_operator) {
 
       logParserError("expected assigment operator after varible declaration in "
                      "for loop header got:" +
@@ -827,7 +998,9 @@ PrototypeAST *Parser::parsePrototype() {
     return nullptr;
   }
   // we know that we need a function call so we get started
-  std::string functionName = lex->identifierStr;
+  // prototypes own their name, see PrototypeAST
+  std::string functionName = lex->identifierStr.str();
+  symbol::SymbolId functionId = lex->identifierId;
   lex->gettok(); // eat identifier
 
   if (lex->currtok != Token::tok_open_round) {
@@ -848,7 +1021,8 @@ PrototypeAST *Parser::parsePrototype() {
   }
   // need to check semicolon at the end;
   // here we can generate the prototype node;
-  auto *node = factory->allocPrototypeAST(datatype, functionName, args, true);
+  auto *node = factory->allocPrototypeAST(datatype, functionName, args, true,
+                                          functionId);
   node->flags.isPointer = isPointer;
   node->flags.isNull= isNull;
   return node;
@@ -863,7 +1037,8 @@ codegen::ExprAST *Parser::parseDereference() {
                    this, IssueCode::EXPECTED_TOKEN);
     return nullptr;
   }
-  auto *node = factory->allocDereferenceAST(lex->identifierStr);
+  auto *node =
+      factory->allocDereferenceAST(lex->identifierStr, lex->identifierId);
   lex->gettok(); // eat identifier name
   return node;
 }
@@ -880,7 +1055,8 @@ codegen::ExprAST *Parser::parseToPointerAssigment() {
     return nullptr;
   }
 
-  std::string identifier = lex->identifierStr;
+  llvm::StringRef identifier = lex->identifierStr;
+  symbol::SymbolId identifierId = lex->identifierId;
   lex->gettok(); // eat identifier;
 
   // now we expect to see an assigment operator
@@ -903,7 +1079,7 @@ codegen::ExprAST *Parser::parseToPointerAssigment() {
     return nullptr;
   }
 
-  return factory->allocToPointerAssigmentAST(identifier, RHS);
+  return factory->allocToPointerAssigmentAST(identifier, RHS, identifierId);
 }
 
 codegen::ExprAST *Parser::parseCast() {
@@ -947,7 +1123,7 @@ codegen::ExprAST *Parser::parseCast() {
                    IssueCode::CAST_ERROR);
     return nullptr;
   }
-  return factory->allocCastAST(datatype, isPointer, RHS);
+  return factory->consCastAST(datatype, isPointer, RHS);
 }
 } // namespace parser
 } // namespace babycpp
@@ -1,5 +1,6 @@
 #include "slabAllocator.h"
 #include <cassert>
+#include <cstddef>
 
 namespace babycpp {
 namespace memory {
@@ -10,27 +11,87 @@ SlabAllocator::SlabAllocator(int slabSizeInByte) : slabSize(slabSizeInByte) {
   currentSlab = &createdSlab;
 }
 
-void *SlabAllocator::alloc(uint32_t byteSize) {
+namespace {
+inline void trackUsage(AllocatorStats *stats, uint64_t bytes) {
+  stats->currentUsage += bytes;
+  if (stats->currentUsage > stats->peakUsage) {
+    stats->peakUsage = stats->currentUsage;
+  }
+}
+
+inline char *alignPointer(char *ptr, uint32_t alignment) {
+  auto address = reinterpret_cast<uintptr_t>(ptr);
+  const uintptr_t mask = alignment - 1;
+  return reinterpret_cast<char *>((address + mask) & ~mask);
+}
+} // namespace
+
+void *SlabAllocator::alloc(uint32_t byteSize, uint32_t alignment) {
+  assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+  // new[] memory is aligned for any fundamental type, only bigger
+  // alignments can cost us padding at the start of a fresh slab, if the
+  // request does not fit in a slab it gets its own block
+  const uint32_t worstPadding =
+      alignment > alignof(std::max_align_t) ? alignment - 1 : 0;
+  ++stats.allocationCount;
+  stats.bytesRequested += byteSize;
+  if (static_cast<uint64_t>(byteSize) + worstPadding > slabSize) {
+    auto *data = new char[byteSize + worstPadding];
+    oversizedBlocks.push_back(data);
+    ++stats.oversizedCount;
+    stats.oversizedBytes += byteSize;
+    trackUsage(&stats, byteSize);
+    return alignPointer(data, alignment);
+  }
 
   // making sure we have enough space
-  assert(byteSize <= slabSize);
-  if (currentSlab->rsp + byteSize > currentSlab->endp) {
+  char *aligned = alignPointer(currentSlab->rsp, alignment);
+  if (aligned + byteSize > currentSlab->endp) {
+    uint64_t tail = currentSlab->endp - currentSlab->rsp;
+    stats.bytesWastedInSlabTails += tail;
+    trackUsage(&stats, tail);
     Slab &createdSlab = allocateSlab();
     currentSlab = &createdSlab;
+    aligned = alignPointer(currentSlab->rsp, alignment);
   }
+  uint64_t padding = aligned - currentSlab->rsp;
+  stats.bytesAlignmentPadding += padding;
+  trackUsage(&stats, padding + byteSize);
   // shifting stack pointer to allocate the required amount
-  char *old = currentSlab->rsp;
-  currentSlab->rsp += byteSize;
-  return old;
+  currentSlab->rsp = aligned + byteSize;
+  return aligned;
+}
+
+void SlabAllocator::resetStats() {
+  AllocatorStats fresh;
+  fresh.slabCount = stats.slabCount;
+  fresh.currentUsage = stats.currentUsage;
+  fresh.peakUsage = stats.currentUsage;
+  stats = fresh;
 }
 
 Slab &SlabAllocator::allocateSlab() {
-  // need to allocate memory
-  auto *data = new char[slabSize];
+  // recycling a released slab if we have one, all slabs have the same size
+  char *data;
+  if (!freeSlabs.empty()) {
+    data = freeSlabs.back();
+    freeSlabs.pop_back();
+  } else {
+    data = new char[slabSize];
+  }
   slabs.emplace_back(Slab{data, data, data + slabSize});
+  ++stats.slabCount;
   return slabs[slabs.size() - 1];
 }
 
+void SlabAllocator::releaseFreeSlabs() {
+  for (char *data : freeSlabs) {
+    delete[] data;
+  }
+  freeSlabs.clear();
+}
+
 void SlabAllocator::clear() {
 
   // TO NOTE:
@@ -42,11 +103,17 @@ void SlabAllocator::clear() {
   //should change we are going to keep track of the generated
   //pointers and call the destructors.
 
-  //de-allocating the memory except the first one
+  //moving the memory except the first one in the free list
   uint32_t currentSize = slabs.size();
   for (uint32_t i = 1; i < currentSize; ++i) {
-    delete[] slabs[i].data;
+    freeSlabs.push_back(slabs[i].data);
+  }
+  for (char *data : oversizedBlocks) {
+    delete[] data;
   }
+  oversizedBlocks.clear();
+  stats.slabCount = 1;
+  stats.currentUsage = 0;
   // keeping just one slab
   slabs.resize(1);
   currentSlab = &slabs[0];
@@ -0,0 +1,26 @@
+#include "symbolTable.h"
+
+namespace babycpp {
+namespace symbol {
+
+SymbolId SymbolTable::intern(llvm::StringRef str) {
+  // insert does nothing if the key is already there and gives us back
+  // the existing entry, so we only pay a single hash
+  auto res = ids.insert(std::make_pair(str, static_cast<SymbolId>(0)));
+  if (res.second) {
+    res.first->second = static_cast<SymbolId>(names.size());
+    names.push_back(res.first->first());
+  }
+  return res.first->second;
+}
+
+SymbolId SymbolTable::find(llvm::StringRef str) const {
+  auto found = ids.find(str);
+  if (found != ids.end()) {
+    return found->second;
+  }
+  return INVALID_SYMBOL;
+}
+
+} // namespace symbol
+} // namespace babycpp
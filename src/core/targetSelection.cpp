@@ -0,0 +1,77 @@
+#include "targetSelection.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/Host.h>
+// the registry moved to MC in llvm 14
+#if LLVM_VERSION_MAJOR >= 14
+#include <llvm/MC/TargetRegistry.h>
+#else
+#include <llvm/Support/TargetRegistry.h>
+#endif
+
+namespace babycpp {
+namespace codegen {
+
+TargetSelection hostTargetSelection() {
+  TargetSelection selection;
+  selection.cpu = llvm::sys::getHostCPUName().str();
+  llvm::StringMap<bool> hostFeatures;
+  if (llvm::sys::getHostCPUFeatures(hostFeatures)) {
+    for (auto &feature : hostFeatures) {
+      selection.features.push_back((feature.second ? "+" : "-") +
+                                   feature.first().str());
+    }
+  }
+  return selection;
+}
+
+TargetSelection resolveTargetSelection(const TargetSelection &selection) {
+  if (!selection.cpu.empty() && selection.features.empty()) {
+    return selection;
+  }
+  TargetSelection resolved = hostTargetSelection();
+  if (!selection.cpu.empty()) {
+    resolved.cpu = selection.cpu;
+  }
+  if (!selection.features.empty()) {
+    resolved.features = selection.features;
+  }
+  return resolved;
+}
+
+std::unique_ptr<llvm::TargetMachine>
+createTargetMachine(const TargetSelection &selection, OptLevel level,
+                    std::string *error) {
+  const std::string triple = llvm::sys::getProcessTriple();
+  const llvm::Target *target =
+      llvm::TargetRegistry::lookupTarget(triple, *error);
+  if (target == nullptr) {
+    return nullptr;
+  }
+  TargetSelection resolved = resolveTargetSelection(selection);
+  std::string features;
+  for (const std::string &feature : resolved.features) {
+    features += features.empty() ? feature : "," + feature;
+  }
+  return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+      triple, resolved.cpu, features, llvm::TargetOptions(), llvm::None,
+      llvm::None, toCodeGenLevel(level)));
+}
+
+llvm::CodeGenOpt::Level toCodeGenLevel(OptLevel level) {
+  switch (level) {
+  case OptLevel::O0:
+    return llvm::CodeGenOpt::None;
+  case OptLevel::O1:
+    return llvm::CodeGenOpt::Less;
+  case OptLevel::O2:
+    return llvm::CodeGenOpt::Default;
+  case OptLevel::O3:
+    return llvm::CodeGenOpt::Aggressive;
+  }
+  return llvm::CodeGenOpt::Default;
+}
+
+} // namespace codegen
+} // namespace babycpp
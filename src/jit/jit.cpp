@@ -1,67 +1,520 @@
 #include "jit.h"
+#include <cstring>
 #include <iostream>
 
-#include <llvm/ExecutionEngine/ExecutionEngine.h>
-#include <llvm/ExecutionEngine/JITSymbol.h>
-#include <llvm/ExecutionEngine/Orc/LambdaResolver.h>
-#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/ADT/ScopeExit.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/IR/IRBuilder.h>
 #include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/TargetSelect.h>
 
 namespace babycpp {
 namespace jit {
-BabycppJIT::BabycppJIT() {
+
+namespace {
+// tiered code calls this symbol when a function gets hot
+const char *const TIER_UP_SYMBOL = "babycpp_tier_up";
+// suffixes of the baseline and of the optimized version of a function, the
+// original name is the one of the stub
+const char *const BASELINE_SUFFIX = "$tier0";
+const char *const HOT_SUFFIX = "$tier1";
+
+void logJITError(llvm::Error error) {
+  llvm::logAllUnhandledErrors(std::move(error), llvm::errs(), "babycpp jit: ");
+}
+
+std::shared_ptr<const llvm::SmallVector<char, 0>>
+writeBitcode(const llvm::Module &m) {
+  auto bitcode = std::make_shared<llvm::SmallVector<char, 0>>();
+  llvm::raw_svector_ostream stream(*bitcode);
+  llvm::WriteBitcodeToFile(m, stream);
+  return bitcode;
+}
+
+/**
+ * @brief renames every function defined in the module and counts the calls
+ * at its entry, when the count reaches the threshold the tier up callback
+ * is called and the count starts again. Calls are left to the original
+ * names, so they go through the stubs
+ * @return the original names of the functions, in index order
+ */
+std::vector<std::string> instrumentForTiering(llvm::Module *m, void *jit,
+                                              uint32_t firstIndex,
+                                              uint32_t threshold) {
+  llvm::LLVMContext &context = m->getContext();
+  llvm::Type *counterType = llvm::Type::getInt64Ty(context);
+  llvm::Type *indexType = llvm::Type::getInt32Ty(context);
+  llvm::Type *pointerType = llvm::Type::getInt8PtrTy(context);
+  llvm::FunctionType *tierUpType = llvm::FunctionType::get(
+      llvm::Type::getVoidTy(context), {pointerType, indexType}, false);
+  llvm::FunctionCallee tierUp =
+      m->getOrInsertFunction(TIER_UP_SYMBOL, tierUpType);
+
+  std::vector<llvm::Function *> defined;
+  for (llvm::Function &function : *m) {
+    if (!function.isDeclaration()) {
+      defined.push_back(&function);
+    }
+  }
+  std::vector<std::string> names;
+  for (llvm::Function *function : defined) {
+    const std::string name = function->getName().str();
+    const auto index = static_cast<uint32_t>(firstIndex + names.size());
+    names.push_back(name);
+    function->setName(name + BASELINE_SUFFIX);
+    llvm::Function *stub =
+        llvm::Function::Create(function->getFunctionType(),
+                               llvm::GlobalValue::ExternalLinkage, name, m);
+    function->replaceAllUsesWith(stub);
+
+    // functions can be called from several threads, the counter is read
+    // and written with monotonic atomics, a lost increment only delays the
+    // tier up, on x86 they are plain moves
+    auto *counter = new llvm::GlobalVariable(
+        *m, counterType, false, llvm::GlobalValue::InternalLinkage,
+        llvm::ConstantInt::get(counterType, 0), name + "$calls");
+    counter->setAlignment(llvm::Align(8));
+    llvm::BasicBlock *entry = &function->getEntryBlock();
+    auto firstNonAlloca = entry->begin();
+    while (llvm::isa<llvm::AllocaInst>(*firstNonAlloca)) {
+      ++firstNonAlloca;
+    }
+    llvm::BasicBlock *body = entry->splitBasicBlock(firstNonAlloca, "body");
+    entry->getTerminator()->eraseFromParent();
+    llvm::BasicBlock *hot =
+        llvm::BasicBlock::Create(context, "tierup", function, body);
+
+    llvm::IRBuilder<> builder(entry);
+    auto storeCounter = [&](llvm::Value *value) {
+      llvm::StoreInst *store = builder.CreateStore(value, counter);
+      store->setAlignment(llvm::Align(8));
+      store->setAtomic(llvm::AtomicOrdering::Monotonic);
+    };
+    llvm::LoadInst *previous = builder.CreateLoad(counterType, counter);
+    previous->setAlignment(llvm::Align(8));
+    previous->setAtomic(llvm::AtomicOrdering::Monotonic);
+    llvm::Value *calls =
+        builder.CreateAdd(previous, llvm::ConstantInt::get(counterType, 1));
+    storeCounter(calls);
+    builder.CreateCondBr(
+        builder.CreateICmpUGE(calls,
+                              llvm::ConstantInt::get(counterType, threshold)),
+        hot, body);
+    builder.SetInsertPoint(hot);
+    storeCounter(llvm::ConstantInt::get(counterType, 0));
+    llvm::Value *self = builder.CreateIntToPtr(
+        llvm::ConstantInt::get(counterType, reinterpret_cast<uintptr_t>(jit)),
+        pointerType);
+    builder.CreateCall(tierUp,
+                       {self, llvm::ConstantInt::get(indexType, index)});
+    builder.CreateBr(body);
+  }
+  return names;
+}
+} // namespace
+
+BabycppJIT::BabycppJIT(const JITOptions &options)
+    : targetBuilder(llvm::Triple(llvm::sys::getProcessTriple())),
+      hotTargetBuilder(llvm::Triple(llvm::sys::getProcessTriple())),
+      target(codegen::resolveTargetSelection(options.target)),
+      lazy(options.lazy && !options.tiered),
+      compileThreads(options.compileThreads), tiered(options.tiered),
+      hotThreshold(options.hotThreshold), hotLevel(options.hotLevel),
+      optimizer(options.tiered ? codegen::OptLevel::O0 : options.level) {
 
   //here we do the global initialization for llvm
   llvm::InitializeNativeTarget();
   llvm::InitializeNativeTargetAsmPrinter();
   llvm::InitializeNativeTargetAsmParser();
 
-  //setupping the jit with the memory and required layers
-  tm.reset(llvm::EngineBuilder().selectTarget());
-  datalayout = new llvm::DataLayout(tm->createDataLayout());
-  objectLayer = new llvm::orc::RTDyldObjectLinkingLayer(
-      []() { return std::make_shared<llvm::SectionMemoryManager>(); });
-  compileLayer =
-      new llvm::orc::IRCompileLayer<llvm::orc::RTDyldObjectLinkingLayer,
-                                    llvm::orc::SimpleCompiler>(
-          *objectLayer, llvm::orc::SimpleCompiler(*tm));
+  // without cpu and features the target machine generates code for a
+  // generic cpu, meaning no avx or fma, whatever the host supports
+  targetBuilder.setCPU(target.cpu)
+      .addFeatures(target.features)
+      .setCodeGenOptLevel(codegen::toCodeGenLevel(optimizer.level));
+  tm = llvm::cantFail(targetBuilder.createTargetMachine());
+  optimizer.targetMachine = tm.get();
+
+  // with compile threads the modules are compiled by a pool owned by the
+  // execution session, the lazy jit compiles in there the called functions
+  if (lazy) {
+    lazyJit = llvm::cantFail(llvm::orc::LLLazyJITBuilder()
+                                 .setJITTargetMachineBuilder(targetBuilder)
+                                 .setNumCompileThreads(compileThreads)
+                                 .create())
+                  .release();
+    jit.reset(lazyJit);
+  } else {
+    jit = llvm::cantFail(llvm::orc::LLJITBuilder()
+                             .setJITTargetMachineBuilder(targetBuilder)
+                             .setNumCompileThreads(compileThreads)
+                             .create());
+  }
+  jit->getIRTransformLayer().setTransform(
+      [this](llvm::orc::ThreadSafeModule tsm,
+             const llvm::orc::MaterializationResponsibility &) {
+        tsm.withModuleDo([this](llvm::Module &m) { optimizeModule(&m); });
+        return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(tsm));
+      });
+
   // when passing null ptr to load lib, it will load the exported symbols of the
-  // host process itself making them available for execution, really useful for 
+  // host process itself making them available for execution, really useful for
   //exported symbols in the process
   llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+  jit->getMainJITDylib().addGenerator(llvm::cantFail(
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          jit->getDataLayout().getGlobalPrefix())));
+
+  if (tiered) {
+    // the baseline is compiled by the jit at O0, which uses the fast
+    // instruction selector, hot functions by the tier thread at hotLevel
+    hotTargetBuilder.setCPU(target.cpu)
+        .addFeatures(target.features)
+        .setCodeGenOptLevel(codegen::toCodeGenLevel(hotLevel));
+    stubs = llvm::orc::createLocalIndirectStubsManagerBuilder(
+        jit->getTargetTriple())();
+    llvm::orc::SymbolMap callback;
+    callback[jit->mangleAndIntern(TIER_UP_SYMBOL)] = llvm::JITEvaluatedSymbol(
+        llvm::pointerToJITTargetAddress(&BabycppJIT::tierUpCallback),
+        llvm::JITSymbolFlags::Exported);
+    llvm::cantFail(jit->getMainJITDylib().define(
+        llvm::orc::absoluteSymbols(std::move(callback))));
+    tierThread = std::thread([this]() { tierLoop(); });
+  }
+}
+
+BabycppJIT::~BabycppJIT() {
+  if (tierThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(tierMutex);
+      stopTiering = true;
+    }
+    tierCondition.notify_all();
+    tierThread.join();
+  }
+}
+
+void BabycppJIT::optimizeModule(llvm::Module *m) {
+  // in lazy mode the module holds only the function being compiled, the
+  // callees are just declarations so there is no inlining in lazy mode
+  uint32_t functions = 0;
+  for (llvm::Function &function : *m) {
+    functions += function.isDeclaration() ? 0 : 1;
+  }
+  compiledFunctions += functions;
+  if (optimizer.level == codegen::OptLevel::O0) {
+    return;
+  }
+  if (compileThreads == 0) {
+    std::lock_guard<std::mutex> lock(optimizerMutex);
+    optimizer.optimizeModule(m);
+    return;
+  }
+  // modules are optimized concurrently, the target machine caches its
+  // subtargets so every module gets one of its own
+  codegen::Optimizer local(optimizer.level);
+  local.vectorize = optimizer.vectorize;
+  auto localTm = llvm::cantFail(targetBuilder.createTargetMachine());
+  local.targetMachine = localTm.get();
+  local.optimizeModule(m);
+  std::lock_guard<std::mutex> lock(optimizerMutex);
+  optimizer.stats += local.stats;
+}
+
+llvm::Expected<llvm::orc::ThreadSafeModule>
+BabycppJIT::readModule(const llvm::SmallVector<char, 0> &bitcode,
+                       llvm::StringRef name) {
+  // the module lives in the context of the code generator, which is not
+  // ours to lock, going through bitcode moves it in a context of its own
+  auto context = std::make_unique<llvm::LLVMContext>();
+  llvm::MemoryBufferRef buffer(llvm::StringRef(bitcode.data(), bitcode.size()),
+                               name);
+  auto copy = llvm::parseBitcodeFile(buffer, *context);
+  if (!copy) {
+    return copy.takeError();
+  }
+  (*copy)->setDataLayout(jit->getDataLayout());
+  (*copy)->setTargetTriple(jit->getTargetTriple().str());
+  return llvm::orc::ThreadSafeModule(std::move(*copy), std::move(context));
+}
+
+BabycppJIT::ModuleHandle
+BabycppJIT::addModuleImpl(const std::shared_ptr<llvm::Module> &m,
+                          std::vector<llvm::orc::SymbolStringPtr> *defined) {
+  auto bitcode = writeBitcode(*m);
+  auto copy = readModule(*bitcode, m->getModuleIdentifier());
+  if (!copy) {
+    logJITError(copy.takeError());
+    return nullptr;
+  }
+  if (!tiered) {
+    for (llvm::Function &function : *m) {
+      if (!function.isDeclaration()) {
+        defined->push_back(jit->mangleAndIntern(function.getName()));
+      }
+    }
+  }
+
+  ModuleHandle handle = jit->getMainJITDylib().createResourceTracker();
+  llvm::Error error =
+      tiered ? addTieredModule(std::move(*copy), handle, bitcode, defined)
+             : lazy ? lazyJit->getCompileOnDemandLayer().add(handle,
+                                                             std::move(*copy))
+                    : jit->addIRModule(handle, std::move(*copy));
+  if (error) {
+    logJITError(std::move(error));
+    // whatever got defined before the error goes away with the handle
+    removeModule(handle);
+    return nullptr;
+  }
+  return handle;
+}
+
+llvm::Error BabycppJIT::addTieredModule(
+    llvm::orc::ThreadSafeModule tsm, const ModuleHandle &handle,
+    std::shared_ptr<const llvm::SmallVector<char, 0>> bitcode,
+    std::vector<llvm::orc::SymbolStringPtr> *defined) {
+  std::lock_guard<std::mutex> lock(tierMutex);
+  const auto firstIndex = static_cast<uint32_t>(tieredFunctions.size());
+  std::vector<std::string> names = tsm.withModuleDo([&](llvm::Module &m) {
+    return instrumentForTiering(&m, this, firstIndex, hotThreshold);
+  });
+
+  // the stubs start pointing nowhere, they get the baseline once compiled,
+  // stubs can't be deleted so a module added again reuses them
+  llvm::orc::SymbolMap stubSymbols;
+  for (const std::string &name : names) {
+    llvm::orc::SymbolStringPtr mangled = jit->mangleAndIntern(name);
+    if (!stubs->findStub(*mangled, false)) {
+      if (llvm::Error error =
+              stubs->createStub(*mangled, 0, llvm::JITSymbolFlags::Exported)) {
+        return error;
+      }
+    }
+    stubSymbols[mangled] = stubs->findStub(*mangled, false);
+    defined->push_back(jit->mangleAndIntern(name + BASELINE_SUFFIX));
+
+    TieredFunction function;
+    function.name = name;
+    function.stubName = (*mangled).str();
+    function.bitcode = bitcode;
+    function.handle = handle;
+    tieredFunctions.push_back(std::move(function));
+  }
+  // the stubs are part of the module, removing it removes them too
+  if (llvm::Error error = jit->getMainJITDylib().define(
+          llvm::orc::absoluteSymbols(std::move(stubSymbols)), handle)) {
+    return error;
+  }
+  return jit->addIRModule(handle, std::move(tsm));
 }
 
 BabycppJIT::ModuleHandle
 BabycppJIT::addModule(std::shared_ptr<llvm::Module> m) {
-  // Build our symbol resolver:
-  // lambda solvers are symbol solver that needs to find symbols to know if they
-  // are already defined, this is easy to do with lambdas, that LLVM provides
-  // a way to create such symbol look up out of lambdas
-  // Lambda 1: Look back into the JIT itself to find symbols that are part of
-  //           the same "logical dylib".
-  // Lambda 2: Search for external symbols in the host process.
-  auto Resolver = llvm::orc::createLambdaResolver(
-      [&](const std::string &name) {
-        if (auto Sym = compileLayer->findSymbol(name, false)) {
-          return Sym;
+  std::vector<std::shared_ptr<llvm::Module>> modules{std::move(m)};
+  return addModules(modules).front();
+}
+
+std::vector<BabycppJIT::ModuleHandle> BabycppJIT::addModules(
+    const std::vector<std::shared_ptr<llvm::Module>> &modules) {
+  std::vector<ModuleHandle> handles;
+  std::vector<llvm::orc::SymbolStringPtr> defined;
+  for (const auto &m : modules) {
+    handles.push_back(addModuleImpl(m, &defined));
+  }
+  if (lazy || defined.empty()) {
+    return handles;
+  }
+  // a single lookup of everything defined, every module is a separate
+  // materialization unit so the compile threads take one each
+  llvm::orc::ExecutionSession &session = jit->getExecutionSession();
+  auto compiled = session.lookup(
+      llvm::orc::makeJITDylibSearchOrder(&jit->getMainJITDylib()),
+      llvm::orc::SymbolLookupSet(defined));
+  bool failed = false;
+  if (!compiled) {
+    logJITError(compiled.takeError());
+    failed = true;
+  } else if (tiered) {
+    // pointing the stubs to the baseline
+    const size_t suffixSize = std::strlen(BASELINE_SUFFIX);
+    for (auto &symbol : *compiled) {
+      llvm::StringRef name = *symbol.first;
+      llvm::Error error = stubs->updatePointer(name.drop_back(suffixSize),
+                                               symbol.second.getAddress());
+      if (error) {
+        logJITError(std::move(error));
+        failed = true;
+      }
+    }
+  }
+  if (failed && tiered) {
+    // the stubs would still point nowhere, the modules go away with them
+    // so their functions are not found rather than called at address 0
+    for (ModuleHandle &handle : handles) {
+      removeModule(handle);
+      handle = nullptr;
+    }
+  }
+  return handles;
+}
+
+void BabycppJIT::tierUpCallback(void *self, uint32_t index) {
+  // called by the baseline code, it has to be quick, the work is done by
+  // the tier thread
+  auto *jit = static_cast<BabycppJIT *>(self);
+  {
+    std::lock_guard<std::mutex> lock(jit->tierMutex);
+    TieredFunction &function = jit->tieredFunctions[index];
+    if (function.queued || function.handle == nullptr) {
+      return;
+    }
+    function.queued = true;
+    jit->tierQueue.push_back(index);
+  }
+  jit->tierCondition.notify_one();
+}
+
+void BabycppJIT::tierLoop() {
+  std::unique_lock<std::mutex> lock(tierMutex);
+  while (true) {
+    tierCondition.wait(lock,
+                       [this]() { return stopTiering || !tierQueue.empty(); });
+    if (stopTiering) {
+      return;
+    }
+    const uint32_t index = tierQueue.front();
+    tierQueue.pop_front();
+    // whatever happens to this function, waitForTiering() has to hear
+    // about the queue getting empty, the lock is held again by then
+    auto notifyIdle = llvm::make_scope_exit([this]() {
+      if (tierQueue.empty()) {
+        tierIdle.notify_all();
+      }
+    });
+    // the vector might grow while compiling, working on a copy
+    const TieredFunction function = tieredFunctions[index];
+    if (function.handle == nullptr) {
+      continue;
+    }
+    ModuleHandle optimized = jit->getMainJITDylib().createResourceTracker();
+    tierBusy = true;
+    lock.unlock();
+    auto address = compileHot(function, optimized);
+    lock.lock();
+    tierBusy = false;
+
+    TieredFunction &current = tieredFunctions[index];
+    if (!address) {
+      logJITError(address.takeError());
+      llvm::consumeError(optimized->remove());
+    } else if (current.handle != function.handle) {
+      // the module has been removed or replaced meanwhile
+      llvm::consumeError(optimized->remove());
+    } else if (llvm::Error error =
+                   stubs->updatePointer(current.stubName, *address)) {
+      logJITError(std::move(error));
+      llvm::consumeError(optimized->remove());
+    } else {
+      // a single pointer store, callers go to the new code from now on
+      current.optimized = optimized;
+      ++hotFunctions;
+    }
+  }
+}
+
+llvm::Expected<llvm::JITTargetAddress>
+BabycppJIT::compileHot(const TieredFunction &function,
+                       const ModuleHandle &handle) {
+  auto tsm = readModule(*function.bitcode, function.name);
+  if (!tsm) {
+    return tsm.takeError();
+  }
+  auto tm = hotTargetBuilder.createTargetMachine();
+  if (!tm) {
+    return tm.takeError();
+  }
+  const std::string hotName = function.name + HOT_SUFFIX;
+  auto object = tsm->withModuleDo(
+      [&](llvm::Module &m) -> llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> {
+        // the other functions become private copies, so they can be
+        // inlined, the ones left get dropped by the optimizer
+        for (llvm::Function &other : m) {
+          if (!other.isDeclaration()) {
+            other.setLinkage(llvm::GlobalValue::InternalLinkage);
+          }
         }
-        return llvm::JITSymbol(nullptr);
-      },
-      [](const std::string &Name) {
-        if (auto SymAddr =
-                llvm::RTDyldMemoryManager::getSymbolAddressInProcess(Name)) {
-          return llvm::JITSymbol(SymAddr, llvm::JITSymbolFlags::Exported);
+        llvm::Function *hot = m.getFunction(function.name);
+        hot->setLinkage(llvm::GlobalValue::ExternalLinkage);
+        hot->setName(hotName);
+
+        codegen::Optimizer hotOptimizer(hotLevel);
+        hotOptimizer.targetMachine = tm->get();
+        hotOptimizer.optimizeModule(&m);
+        {
+          std::lock_guard<std::mutex> lock(optimizerMutex);
+          optimizer.stats += hotOptimizer.stats;
         }
-        return llvm::JITSymbol(nullptr);
+        llvm::orc::SimpleCompiler compiler(**tm);
+        return compiler(m);
       });
+  if (!object) {
+    return object.takeError();
+  }
+  if (llvm::Error error = jit->addObjectFile(handle, std::move(*object))) {
+    return error;
+  }
+  auto symbol = jit->lookup(hotName);
+  if (!symbol) {
+    return symbol.takeError();
+  }
+  return symbol->getAddress();
+}
+
+void BabycppJIT::waitForTiering() {
+  std::unique_lock<std::mutex> lock(tierMutex);
+  tierIdle.wait(lock, [this]() { return tierQueue.empty() && !tierBusy; });
+}
+
+llvm::JITSymbol BabycppJIT::findSymbol(const std::string Name) {
+  auto symbol = jit->lookup(Name);
+  if (!symbol) {
+    // a missing function is a null symbol, not an error
+    llvm::consumeError(symbol.takeError());
+    return llvm::JITSymbol(nullptr);
+  }
+  return llvm::JITSymbol(symbol->getAddress(), symbol->getFlags());
+}
 
-  // Add the set to the JIT with the resolver we created above and a newly
-  // created SectionMemoryManager, this step will trigger compilation right
-  // away, meaning it wont be lazy
-  return llvm::cantFail(
-      compileLayer->addModule(std::move(m), std::move(Resolver)));
+void BabycppJIT::removeModule(ModuleHandle h) {
+  if (h == nullptr) {
+    return;
+  }
+  if (tiered) {
+    std::lock_guard<std::mutex> lock(tierMutex);
+    for (TieredFunction &function : tieredFunctions) {
+      if (function.handle != h) {
+        continue;
+      }
+      if (function.optimized != nullptr) {
+        llvm::consumeError(function.optimized->remove());
+      }
+      function.handle = nullptr;
+      function.optimized = nullptr;
+      function.bitcode.reset();
+    }
+  }
+  llvm::Error error = h->remove();
+  if (error) {
+    logJITError(std::move(error));
+  }
 }
 
 } // namespace jit
-} // namespace babycpp
\ No newline at end of file
+} // namespace babycpp
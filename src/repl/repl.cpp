@@ -10,6 +10,8 @@ namespace repl {
 // hardcoded function names used in the jitting
 static const std::string ANONYMOUS_FUNCTION{ "__anonymous__"};
 static const std::string DUMMY_FUNCTION {"__dummy__"};
+// repl commands, not part of the language
+static const std::string STATS_COMMAND{":stats"};
 
 using babycpp::codegen::Codegenerator;
 using babycpp::codegen::ExprAST;
@@ -35,12 +37,12 @@ int lookAheadStatement(babycpp::Lexer *lex) {
       if (!res) {
         return Token::tok_invalid_repl;
       }
-      if (lex->lookAheadToken[0].token == Token::tok_identifier &&
-          lex->lookAheadToken[1].token == Token::tok_assigment_operator) {
+      if (lex->peekToken(0).token == Token::tok_identifier &&
+          lex->peekToken(1).token == Token::tok_assigment_operator) {
         return Token::tok_assigment_repl;
       }
-      if (lex->lookAheadToken[0].token == Token::tok_identifier &&
-          lex->lookAheadToken[1].token == Token::tok_open_round) {
+      if (lex->peekToken(0).token == Token::tok_identifier &&
+          lex->peekToken(1).token == Token::tok_open_round) {
         return Token::tok_function_repl;
       }
       return Token::tok_invalid_repl;
@@ -53,7 +55,7 @@ int lookAheadStatement(babycpp::Lexer *lex) {
       if (!res) {
         return Token::tok_invalid_repl;
       }
-      if (lex->lookAheadToken[0].token == Token::tok_assigment_operator) {
+      if (lex->peekToken(0).token == Token::tok_assigment_operator) {
         return Token::tok_anonymous_assigment_repl;
       }
       return Token::tok_expression_repl;
@@ -141,7 +143,8 @@ void handleExpression(codegen::Codegenerator *gen, BabycppJIT *jit,
 
 void handleFunction(codegen::Codegenerator *gen, jit::BabycppJIT *jit,
                     std::shared_ptr<llvm::Module> anonymousModule,
-                    std::shared_ptr<llvm::Module> staticModule) {
+                    std::shared_ptr<llvm::Module> staticModule,
+                    BabycppJIT::ModuleHandle *staticHandle) {
   // here we add the code to the permanent module
   gen->setCurrentModule(staticModule);
   // generating code
@@ -152,8 +155,10 @@ void handleFunction(codegen::Codegenerator *gen, jit::BabycppJIT *jit,
   //generating the code and is added to the module
   res->codegen(gen);
 
-  // adding function to the jit so it gets compiled
-  jit->addModule(gen->module);
+  // the static module holds every function defined so far, its previous
+  // version goes away before adding it again
+  jit->removeModule(*staticHandle);
+  *staticHandle = jit->addModule(gen->module);
 }
 
 void loop(Codegenerator *gen, BabycppJIT *jit,
@@ -161,6 +166,7 @@ void loop(Codegenerator *gen, BabycppJIT *jit,
           std::shared_ptr<llvm::Module> staticModule) {
   // this is the main loop of the repl
   std::string str;
+  BabycppJIT::ModuleHandle staticHandle;
   while (true) {
     std::cout << ">>> ";
     std::cout.flush();
@@ -168,6 +174,12 @@ void loop(Codegenerator *gen, BabycppJIT *jit,
     // unitl input is not provided
     getline(std::cin, str);
 
+    // dumping how much memory the AST is using so far
+    if (str == STATS_COMMAND) {
+      std::cout << gen->factory.dumpStats();
+      continue;
+    }
+
     // we initialize the code generator
     gen->initFromString(str);
     // we use our code to look ahead withouth invalidating token
@@ -186,7 +198,7 @@ void loop(Codegenerator *gen, BabycppJIT *jit,
       break;
     }
     case Token::tok_function_repl: {
-      handleFunction(gen, jit, anonymousModule, staticModule);
+      handleFunction(gen, jit, anonymousModule, staticModule, &staticHandle);
       break;
     }
     }
@@ -1,8 +1,12 @@
 #include "catch.hpp"
 #include "codegen.h"
+#include "concurrentAllocator.h"
 #include "factoryAST.h"
 #include "slabAllocator.h"
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <thread>
 
 using babycpp::memory::Slab;
 using babycpp::memory::SlabAllocator;
@@ -79,6 +83,79 @@ TEST_CASE("Testing allocation slab-re-alloc", "[memory]") {
   REQUIRE(slab.getStackPtrOffset() == allocSize);
 }
 
+TEST_CASE("Testing aligned allocation", "[memory]") {
+  SlabAllocator slab(256);
+
+  // odd sized allocation to move the stack pointer off alignment
+  char *c = static_cast<char *>(slab.alloc(3, 1));
+  REQUIRE(slab.getStackPtrOffset() == 3);
+  auto *p = slab.alloc(8, 8);
+  REQUIRE(reinterpret_cast<uintptr_t>(p) % 8 == 0);
+  REQUIRE(static_cast<char *>(p) >= c + 3);
+  REQUIRE(slab.getStackPtrOffset() == 16);
+
+  auto *big = slab.alloc(4, 64);
+  REQUIRE(reinterpret_cast<uintptr_t>(big) % 64 == 0);
+
+  // default alignment keeps pointers aligned
+  slab.alloc(1, 1);
+  auto *def = slab.alloc(sizeof(void *));
+  REQUIRE(reinterpret_cast<uintptr_t>(def) % alignof(void *) == 0);
+}
+
+TEST_CASE("Testing aligned allocation on slab boundary", "[memory]") {
+  SlabAllocator slab(64);
+  slab.alloc(60, 1);
+  REQUIRE(slab.slabs.size() == 1);
+  // 4 bytes are left but not aligned to 8, we need a new slab
+  auto *p = slab.alloc(8, 16);
+  REQUIRE(reinterpret_cast<uintptr_t>(p) % 16 == 0);
+  REQUIRE(slab.slabs.size() == 2);
+}
+
+TEST_CASE("Testing oversized allocation", "[memory]") {
+  SlabAllocator slab(128);
+  slab.alloc(16);
+  uint64_t offset = slab.getStackPtrOffset();
+
+  auto *p = static_cast<char *>(slab.alloc(1000, 32));
+  REQUIRE(p != nullptr);
+  REQUIRE(reinterpret_cast<uintptr_t>(p) % 32 == 0);
+  // the whole block must be usable
+  memset(p, 1, 1000);
+  // slabs are left untouched
+  REQUIRE(slab.slabs.size() == 1);
+  REQUIRE(slab.getStackPtrOffset() == offset);
+  REQUIRE(slab.oversizedBlocks.size() == 1);
+
+  slab.clear();
+  REQUIRE(slab.oversizedBlocks.empty());
+}
+
+TEST_CASE("Testing slabs recycled after clear", "[memory]") {
+  SlabAllocator slab(64);
+  for (uint32_t i = 0; i < 4; ++i) {
+    slab.alloc(64);
+  }
+  REQUIRE(slab.slabs.size() == 4);
+  char *last = slab.slabs[3].data;
+
+  slab.clear();
+  REQUIRE(slab.slabs.size() == 1);
+  REQUIRE(slab.freeSlabs.size() == 3);
+
+  // the first slab is reused, then the memory comes from the free list
+  slab.alloc(64);
+  slab.alloc(64);
+  REQUIRE(slab.slabs.size() == 2);
+  REQUIRE(slab.freeSlabs.size() == 2);
+  REQUIRE(slab.slabs[1].data == last);
+  REQUIRE(slab.slabs[1].rsp == slab.slabs[1].data + 64);
+
+  slab.releaseFreeSlabs();
+  REQUIRE(slab.freeSlabs.empty());
+}
+
 TEST_CASE("Testing cleaning memory", "[memory]") {
 
   uint32_t allocSize = sizeof(babycpp::codegen::ExprAST);
@@ -126,7 +203,7 @@ TEST_CASE("Testing factory nodes", "[memory]") {
   REQUIRE(f.allocator.getStackPtrOffset() == allocSize);
 
   allocSize += sizeof(BinaryExprAST);
-  auto *binptr = f.allocBinaryAST(std::string("+"), nullptr, nullptr);
+  auto *binptr = f.allocBinaryAST("+", nullptr, nullptr);
   REQUIRE(binptr != nullptr);
   REQUIRE(binptr->op == "+");
   REQUIRE(f.allocator.slabs.size() == 1);
@@ -134,13 +211,15 @@ TEST_CASE("Testing factory nodes", "[memory]") {
 
   allocSize += sizeof(CallExprAST);
   std::vector<ExprAST *> args;
-  auto *callptr = f.allocCallexprAST(std::string("func"), args);
+  auto *callptr = f.allocCallexprAST("func", args);
   REQUIRE(callptr != nullptr);
   REQUIRE(callptr->callee == "func");
   REQUIRE(f.allocator.slabs.size() == 1);
   REQUIRE(f.allocator.getStackPtrOffset() == allocSize);
 
-  allocSize += sizeof(PrototypeAST);
+  // the name is copied in the slab too, the node after it is aligned
+  // back to the pointer size
+  allocSize += sizeof(PrototypeAST) + sizeof(void *);
   std::vector<Argument> protoarg;
   auto *protoptr = f.allocPrototypeAST(Token::tok_int, std::string("proto"),
                                        protoarg, false);
@@ -157,3 +236,223 @@ TEST_CASE("Testing factory nodes", "[memory]") {
   REQUIRE(f.allocator.slabs.size() == 1);
   REQUIRE(f.allocator.getStackPtrOffset() == allocSize);
 }
+
+TEST_CASE("Testing AST children allocated in the slabs", "[memory]") {
+  using babycpp::codegen::Argument;
+  using babycpp::codegen::ExprAST;
+  using babycpp::codegen::FunctionAST;
+  using babycpp::codegen::VariableExprAST;
+  using babycpp::lexer::Token;
+  babycpp::memory::FactoryAST f;
+  char *slabStart = f.allocator.currentSlab->data;
+  char *slabEnd = f.allocator.currentSlab->endp;
+  auto inSlab = [&](const void *ptr) {
+    return ptr >= slabStart && ptr < slabEnd;
+  };
+
+  auto *a = f.allocVariableAST("a", nullptr, 0);
+  auto *b = f.allocVariableAST("b", nullptr, 0);
+  std::vector<ExprAST *> args{a, b};
+  auto *callptr = f.allocCallexprAST("func", args);
+  REQUIRE(callptr->args.size() == 2);
+  REQUIRE(inSlab(callptr->args.data));
+  REQUIRE(callptr->args[0] == a);
+  REQUIRE(callptr->args[1] == b);
+
+  // the arguments names must not depend on the strings we started from
+  std::vector<Argument> protoarg;
+  {
+    std::string argName("value");
+    protoarg.emplace_back(Argument(Token::tok_float, argName, false));
+  }
+  auto *protoptr = f.allocPrototypeAST(Token::tok_int, std::string("proto"),
+                                       protoarg, false);
+  REQUIRE(inSlab(protoptr->name.data()));
+  REQUIRE(protoptr->args.size() == 1);
+  REQUIRE(inSlab(protoptr->args.data));
+  REQUIRE(inSlab(protoptr->args[0].name.data()));
+
+  // empty lists do not allocate
+  std::vector<ExprAST *> funcbody;
+  uint64_t offset = f.allocator.getStackPtrOffset();
+  auto *funcptr = f.allocFunctionAST(protoptr, funcbody);
+  REQUIRE(funcptr->body.empty());
+  REQUIRE(funcptr->body.data == nullptr);
+  REQUIRE(f.allocator.getStackPtrOffset() == offset + sizeof(FunctionAST));
+
+  // nodes keep being aligned after odd sized strings
+  auto *padded = f.allocVariableAST("c", nullptr, 0);
+  REQUIRE(reinterpret_cast<uintptr_t>(padded) % alignof(VariableExprAST) ==
+          0);
+}
+
+TEST_CASE("Testing thread local allocator", "[memory]") {
+  using babycpp::memory::ThreadLocalSlabAllocator;
+  ThreadLocalSlabAllocator allocator(256);
+
+  const int threadCount = 4;
+  const int allocCount = 1000;
+  std::vector<std::vector<uint32_t *>> results(threadCount);
+  std::vector<SlabAllocator *> arenas(threadCount);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&, t]() {
+      arenas[t] = &allocator.getThreadArena();
+      for (int i = 0; i < allocCount; ++i) {
+        auto *ptr = static_cast<uint32_t *>(
+            allocator.alloc(sizeof(uint32_t), alignof(uint32_t)));
+        *ptr = static_cast<uint32_t>(t);
+        results[t].push_back(ptr);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  REQUIRE(allocator.getArenaCount() == threadCount);
+  for (int t = 0; t < threadCount; ++t) {
+    for (int o = t + 1; o < threadCount; ++o) {
+      REQUIRE(arenas[t] != arenas[o]);
+    }
+    // nobody wrote in the memory of another thread
+    bool intact = true;
+    for (uint32_t *ptr : results[t]) {
+      intact &= *ptr == static_cast<uint32_t>(t);
+    }
+    REQUIRE(intact);
+  }
+  allocator.clear();
+  REQUIRE(allocator.getArenaCount() == threadCount);
+}
+
+TEST_CASE("Testing concurrent allocator", "[memory]") {
+  using babycpp::memory::ConcurrentSlabAllocator;
+  // small slabs to make the threads race on the slab replacement
+  ConcurrentSlabAllocator allocator(512);
+
+  const int threadCount = 8;
+  const int allocCount = 2000;
+  std::atomic<bool> misaligned{false};
+  std::vector<std::vector<uint64_t *>> results(threadCount);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < allocCount; ++i) {
+        // mixing sizes and alignments, with an oversized one now and then
+        uint32_t size = (i % 97 == 0) ? 1024 : 8 * (1 + i % 3);
+        uint32_t alignment = (i % 2 == 0) ? 8 : 32;
+        auto *ptr = static_cast<uint64_t *>(allocator.alloc(size, alignment));
+        // catch assertions are not thread safe, checking after the join
+        if (reinterpret_cast<uintptr_t>(ptr) % alignment != 0) {
+          misaligned = true;
+        }
+        for (uint32_t w = 0; w < size / sizeof(uint64_t); ++w) {
+          ptr[w] = static_cast<uint64_t>(t) << 32 | i;
+        }
+        results[t].push_back(ptr);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  REQUIRE(!misaligned);
+  // every allocation still holds what its thread wrote, no range has been
+  // handed out twice
+  bool intact = true;
+  for (int t = 0; t < threadCount; ++t) {
+    for (int i = 0; i < allocCount; ++i) {
+      intact &= *results[t][i] == (static_cast<uint64_t>(t) << 32 | i);
+    }
+  }
+  REQUIRE(intact);
+  REQUIRE(allocator.getSlabCount() > 1);
+  allocator.clear();
+  REQUIRE(allocator.getSlabCount() == 1);
+}
+
+TEST_CASE("Testing concurrent allocator refill", "[memory]") {
+  using babycpp::memory::ConcurrentSlabAllocator;
+  // 16 allocations fill a slab exactly, so every refill is forced by a
+  // full slab and exactly one new slab has to come out of each
+  ConcurrentSlabAllocator allocator(256);
+
+  const int threadCount = 8;
+  const int allocCount = 1000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < allocCount; ++i) {
+        allocator.alloc(16, 16);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(allocator.getSlabCount() == threadCount * allocCount / 16);
+}
+
+TEST_CASE("Testing allocator statistics", "[memory]") {
+  SlabAllocator slab(64);
+  REQUIRE(slab.getStats().slabCount == 1);
+
+  slab.alloc(3, 1);
+  slab.alloc(8, 8);
+  const auto &stats = slab.getStats();
+  REQUIRE(stats.allocationCount == 2);
+  REQUIRE(stats.bytesRequested == 11);
+  REQUIRE(stats.bytesAlignmentPadding == 5);
+  REQUIRE(stats.currentUsage == 16);
+
+  // 48 bytes left in the slab, they go wasted
+  slab.alloc(56, 8);
+  REQUIRE(stats.slabCount == 2);
+  REQUIRE(stats.bytesWastedInSlabTails == 48);
+  REQUIRE(stats.currentUsage == 16 + 48 + 56);
+
+  slab.alloc(100);
+  REQUIRE(stats.oversizedCount == 1);
+  REQUIRE(stats.oversizedBytes == 100);
+  REQUIRE(stats.peakUsage == 220);
+
+  // the peak survives the clear, the current usage does not
+  slab.clear();
+  REQUIRE(stats.currentUsage == 0);
+  REQUIRE(stats.slabCount == 1);
+  REQUIRE(stats.peakUsage == 220);
+  slab.resetStats();
+  REQUIRE(stats.peakUsage == 0);
+  REQUIRE(stats.allocationCount == 0);
+}
+
+TEST_CASE("Testing factory statistics", "[memory]") {
+  using babycpp::codegen::ExprAST;
+  using babycpp::codegen::NodeType;
+  using babycpp::codegen::VariableExprAST;
+
+  babycpp::memory::FactoryAST f;
+  auto *a = f.allocVariableAST("a", nullptr, 0);
+  auto *b = f.allocVariableAST("b", nullptr, 0);
+  std::vector<ExprAST *> args{a, b};
+  f.allocCallexprAST("func", args);
+
+  REQUIRE(f.stats.nodeCounts[NodeType::VariableNode] == 2);
+  REQUIRE(f.stats.nodeBytes[NodeType::VariableNode] ==
+          2 * sizeof(VariableExprAST));
+  REQUIRE(f.stats.nodeCounts[NodeType::CallNode] == 1);
+  REQUIRE(f.stats.arrayCount == 1);
+  REQUIRE(f.stats.arrayBytes == 2 * sizeof(ExprAST *));
+  REQUIRE(f.allocator.getStats().allocationCount == 4);
+
+  std::string report = f.dumpStats();
+  REQUIRE(report.find("VariableExprAST") != std::string::npos);
+  REQUIRE(report.find("peak usage") != std::string::npos);
+  // nodes never allocated are not listed
+  REQUIRE(report.find("ForAST") == std::string::npos);
+
+  f.resetStats();
+  REQUIRE(f.stats.nodeCounts[NodeType::VariableNode] == 0);
+}
@@ -1,6 +1,10 @@
 #include "catch.hpp"
 #include <codegen.h>
 #include <iostream>
+#include <targetSelection.h>
+
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/TargetSelect.h>
 
 using babycpp::codegen::Codegenerator;
 using babycpp::lexer::Lexer;
@@ -65,7 +69,7 @@ TEST_CASE("Testing code gen number int", "[codegen]") {
 //      llvm::BasicBlock::Create(gen.context, "entry", function);
 //  tmpb.SetInsertPoint(block);
 //  auto a = tmpb.CreateAlloca(llvm::Type::getFloatTy(gen.context), 0, "x");
-//  gen.namedValues[a->getName().str()] = a;
+//  gen.namedValues[gen.lexer.symbols.intern(a->getName())] = a;
 //
 //  // doing the parsing
 //  auto *p = gen.parser.parseIdentifier();
@@ -111,7 +115,7 @@ TEST_CASE("Testing binop codegen plus", "[codegen]") {
   gen.builder.SetInsertPoint(block);
   auto a =
       gen.builder.CreateAlloca(llvm::Type::getFloatTy(gen.context), 0, "x");
-  gen.namedValues[a->getName().str()] = a;
+  gen.namedValues[gen.lexer.symbols.intern(a->getName())] = a;
 
   llvm::Value *v = p->codegen(&gen);
   REQUIRE(v != nullptr);
@@ -140,7 +144,7 @@ TEST_CASE("Testing binop codegen -", "[codegen]") {
   gen.builder.SetInsertPoint(block);
   auto a =
       gen.builder.CreateAlloca(llvm::Type::getFloatTy(gen.context), 0, "yy");
-  gen.namedValues[a->getName().str()] = a;
+  gen.namedValues[gen.lexer.symbols.intern(a->getName())] = a;
 
   llvm::Value *v = p->codegen(&gen);
   REQUIRE(v != nullptr);
@@ -169,7 +173,7 @@ TEST_CASE("Testing binop codegen *", "[codegen]") {
   gen.builder.SetInsertPoint(block);
   auto a =
       gen.builder.CreateAlloca(llvm::Type::getFloatTy(gen.context), 0, "temp");
-  gen.namedValues[a->getName().str()] = a;
+  gen.namedValues[gen.lexer.symbols.intern(a->getName())] = a;
 
   llvm::Value *v = p->codegen(&gen);
   REQUIRE(v != nullptr);
@@ -198,7 +202,7 @@ TEST_CASE("Testing binop codegen /", "[codegen]") {
   gen.builder.SetInsertPoint(block);
   auto a =
       gen.builder.CreateAlloca(llvm::Type::getFloatTy(gen.context), 0, "temp");
-  gen.namedValues[a->getName().str()] = a;
+  gen.namedValues[gen.lexer.symbols.intern(a->getName())] = a;
 
   llvm::Value *v = p->codegen(&gen);
   REQUIRE(v != nullptr);
@@ -229,7 +233,7 @@ TEST_CASE("Testing binop codegen <", "[codegen]") {
       llvm::BasicBlock::Create(gen.context, "entry", function);
   tmpb.SetInsertPoint(block);
   auto a = tmpb.CreateAlloca(llvm::Type::getFloatTy(gen.context), 0, "z");
-  gen.namedValues[a->getName().str()] = a;
+  gen.namedValues[gen.lexer.symbols.intern(a->getName())] = a;
 
   llvm::Value *v = p->codegen(&gen);
   REQUIRE(v != nullptr);
@@ -315,6 +319,37 @@ TEST_CASE("Testing function call in function", "[codegen]") {
   REQUIRE(outs == expected);
 }
 
+TEST_CASE("Testing codegen from token buffer", "[codegen]") {
+  const std::string source{
+      "float avg(float x){return x*2.0;}"
+      "float tt(float x , float y){return y + avg(x);}"
+      "int loop(int x){ int* ptr = (int*) x; for(int i = 0; i < x; i = i+1)"
+      "{ x = x + (int)2.0;} return x;}"};
+
+  Codegenerator streaming;
+  Codegenerator batch;
+  streaming.initFromString(source);
+  batch.initFromString(source, true);
+  REQUIRE(batch.lexer.useTokenBuffer);
+
+  for (int i = 0; i < 2; ++i) {
+    auto *streamingFunc = streaming.parser.parseFunction();
+    auto *batchFunc = batch.parser.parseFunction();
+    REQUIRE(streamingFunc != nullptr);
+    REQUIRE(batchFunc != nullptr);
+    REQUIRE(Codegenerator::printLlvmData(streamingFunc->codegen(&streaming)) ==
+            Codegenerator::printLlvmData(batchFunc->codegen(&batch)));
+  }
+  // the last one exercises the look ahead of casts and declarations
+  auto *streamingFunc = streaming.parser.parseFunction();
+  auto *batchFunc = batch.parser.parseFunction();
+  REQUIRE(streamingFunc != nullptr);
+  REQUIRE(batchFunc != nullptr);
+  REQUIRE(batchFunc->body.size() == streamingFunc->body.size());
+  REQUIRE(batch.lexer.currtok == Token::tok_eof);
+  REQUIRE(streaming.lexer.currtok == Token::tok_eof);
+}
+
 TEST_CASE("Testing function call in function2", "[codegen]") {
 
   Codegenerator gen;
@@ -510,6 +545,29 @@ TEST_CASE("Testing less operator codegen", "[codegen]") {
   REQUIRE(outs == expected);
 }
 
+TEST_CASE("Testing comparison and logical result assigned to int codegen",
+          "[codegen]") {
+
+  Codegenerator gen;
+  gen.initFromString("int testFunc(int a, float b){ int res = a < 0 && b >= "
+                     "0.0; int other = a != 3; return res + other;}");
+
+  auto p = gen.parser.parseStatement();
+  checkGenErrors(&gen);
+  REQUIRE(p != nullptr);
+
+  auto v = p->codegen(&gen);
+  checkGenErrors(&gen);
+  REQUIRE(v != nullptr);
+  REQUIRE_FALSE(gen.diagnostic.hasErrors());
+
+  std::string outs = gen.printLlvmData(v);
+  REQUIRE(outs.find("icmp slt i32") != std::string::npos);
+  REQUIRE(outs.find("fcmp oge float") != std::string::npos);
+  REQUIRE(outs.find("zext i1") != std::string::npos);
+  REQUIRE_FALSE(llvm::verifyModule(*gen.module, &llvm::errs()));
+}
+
 TEST_CASE("Testing float pointer as return in protoype is correct codegen ",
           "[codegen]") {
 
@@ -939,3 +997,340 @@ TEST_CASE("Testing pointer arithm float with wrong operator * code gen", "[codeg
 // TODO(giordi) test concatenated casts, not really useful but let see what
 // happen should  hold, something like (float*)(void*)myPyt;  not sure if double
 // parent is working back to back
+
+TEST_CASE("Testing code generator reset", "[codegen]") {
+  Codegenerator gen{true};
+  const std::string code{
+      "int* testFunc(int x){ int* ptr = (int*) malloc(x); return ptr;}"};
+  gen.initFromString(code);
+  auto p = gen.parser.parseStatement();
+  REQUIRE(p != nullptr);
+  REQUIRE(p->codegen(&gen) != nullptr);
+  checkGenErrors(&gen);
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+
+  llvm::LLVMContext *context = &gen.context;
+  std::shared_ptr<llvm::Module> firstModule = gen.module;
+  const uint64_t usage = gen.factory.allocator.getStats().currentUsage;
+
+  // same function again, without reset it would be a redefinition
+  gen.reset();
+  REQUIRE(gen.module != firstModule);
+  REQUIRE(&gen.module->getContext() == context);
+  REQUIRE(gen.module->getFunction("testFunc") == nullptr);
+  REQUIRE(firstModule->getFunction("testFunc") != nullptr);
+  REQUIRE(gen.namedValues.touched.empty());
+  REQUIRE(gen.functionProtos.touched.empty());
+  // only the builtins have been allocated again
+  REQUIRE(gen.factory.allocator.getStats().currentUsage < usage);
+
+  gen.initFromString(code);
+  p = gen.parser.parseStatement();
+  REQUIRE(p != nullptr);
+  auto v = p->codegen(&gen);
+  checkGenErrors(&gen);
+  REQUIRE(v != nullptr);
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+  REQUIRE(gen.module->getFunction("testFunc") != nullptr);
+  // the previous slabs have been reused
+  REQUIRE(gen.factory.allocator.getStats().currentUsage == usage);
+  REQUIRE(gen.factory.allocator.getStats().slabCount == 1);
+
+  // errors do not leak in the next session
+  gen.reset();
+  gen.initFromString("int testFunc(int x){ return y;}");
+  p = gen.parser.parseStatement();
+  REQUIRE(p != nullptr);
+  REQUIRE(p->codegen(&gen) == nullptr);
+  REQUIRE(gen.diagnostic.hasErrors() != 0);
+  gen.reset();
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+}
+
+TEST_CASE("Testing code gen of hash consed expressions", "[codegen]") {
+  Codegenerator gen;
+  gen.factory.hashConsing = true;
+  gen.initFromString("float testFunc(float x, float y){ "
+                     "float a = x*x + y*y; float b = x*x + y*y; "
+                     "return a + b + x*x;}");
+
+  auto p = gen.parser.parseStatement();
+  REQUIRE(p != nullptr);
+  auto v = p->codegen(&gen);
+  checkGenErrors(&gen);
+  REQUIRE(v != nullptr);
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+  REQUIRE(gen.factory.stats.consHits != 0);
+}
+
+TEST_CASE("Testing parallel parsing code gen", "[codegen]") {
+  std::string source;
+  for (int i = 0; i < 16; ++i) {
+    const std::string name = "func" + std::to_string(i);
+    const std::string previous =
+        i == 0 ? std::string("x") : "func" + std::to_string(i - 1) + "(x)";
+    source += "float " + name + "(float x){ float res = 0.0; " +
+              "for(int i = 0; i < 4; i = i + 1){ res = res + " + previous +
+              ";} return res * 2.0;}\n";
+  }
+
+  Codegenerator sequential;
+  sequential.initFromString(source);
+  sequential.generateModuleContent();
+  checkGenErrors(&sequential);
+  REQUIRE(sequential.diagnostic.hasErrors() == 0);
+
+  Codegenerator parallel;
+  parallel.generateModuleContentParallel(source, 4);
+  checkGenErrors(&parallel);
+  REQUIRE(parallel.diagnostic.hasErrors() == 0);
+  REQUIRE(parallel.parseWorkers.size() == 4);
+
+  std::string sequentialIR;
+  llvm::raw_string_ostream sequentialStream(sequentialIR);
+  sequential.module->print(sequentialStream, nullptr);
+  std::string parallelIR;
+  llvm::raw_string_ostream parallelStream(parallelIR);
+  parallel.module->print(parallelStream, nullptr);
+  REQUIRE(sequentialStream.str() == parallelStream.str());
+}
+
+TEST_CASE("Testing parallel parsing twice in a session", "[codegen]") {
+  Codegenerator gen;
+  gen.generateModuleContentParallel("int foo(int a){ return a+1;}", 2);
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+  // foo lives in the AST of the first parse, it has to survive the second
+  gen.generateModuleContentParallel("int bar(int b){ return foo(b)*2;}", 2);
+  checkGenErrors(&gen);
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+  REQUIRE(gen.module->getFunction("bar") != nullptr);
+  REQUIRE_FALSE(llvm::verifyModule(*gen.module, &llvm::errs()));
+  gen.reset();
+  REQUIRE(gen.parseWorkers.empty());
+}
+
+TEST_CASE("Testing parallel parsing errors", "[codegen]") {
+  Codegenerator gen;
+  gen.generateModuleContentParallel("int a(int x){ return x;}\n"
+                                    "int b(int x){ return x +;}\n"
+                                    "int c(int x){ return a(x);}\n",
+                                    3);
+  REQUIRE(gen.diagnostic.hasErrors() != 0);
+  // the error is reported on the line of the whole source
+  REQUIRE(gen.diagnostic.peakError().line == 2);
+  REQUIRE(gen.module->getFunction("a") != nullptr);
+  REQUIRE(gen.module->getFunction("b") == nullptr);
+  REQUIRE(gen.module->getFunction("c") != nullptr);
+}
+
+TEST_CASE("Testing parallel IR generation", "[codegen]") {
+  std::string source{"extern float sin(float x);\n"};
+  for (int i = 0; i < 16; ++i) {
+    const std::string name = "func" + std::to_string(i);
+    // calls to functions generated by other workers
+    const std::string callee =
+        i == 0 ? std::string("x") : "func" + std::to_string(i / 2) + "(x)";
+    source += "float " + name + "(float x){ float res = 0.0; " +
+              "for(int i = 0; i < 4; i = i + 1){ res = res + " + callee +
+              ";} return res * 2.0;}\n";
+  }
+
+  Codegenerator sequential;
+  sequential.initFromString(source);
+  sequential.generateModuleContent();
+  checkGenErrors(&sequential);
+  REQUIRE(sequential.diagnostic.hasErrors() == 0);
+
+  Codegenerator parallel;
+  parallel.generateModuleContentParallel(source, 4, true);
+  checkGenErrors(&parallel);
+  REQUIRE(parallel.diagnostic.hasErrors() == 0);
+  REQUIRE_FALSE(llvm::verifyModule(*parallel.module, &llvm::errs()));
+
+  // functions can end up in a different order, comparing them one by one,
+  // unused declarations like sin are dropped by the linker
+  bool same = true;
+  int definitions = 0;
+  for (llvm::Function &function : *sequential.module) {
+    if (function.isDeclaration()) {
+      continue;
+    }
+    llvm::Function *linked = parallel.module->getFunction(function.getName());
+    if (linked == nullptr) {
+      same = false;
+      continue;
+    }
+    ++definitions;
+    std::string expected;
+    llvm::raw_string_ostream expectedStream(expected);
+    function.print(expectedStream);
+    std::string actual;
+    llvm::raw_string_ostream actualStream(actual);
+    linked->print(actualStream);
+    same &= expectedStream.str() == actualStream.str();
+  }
+  REQUIRE(same);
+  REQUIRE(definitions == 16);
+
+  // the same function defined by two workers can't be linked
+  Codegenerator duplicated;
+  duplicated.generateModuleContentParallel(
+      "int a(int x){ return x;}\nint a(int x){ return x + 1;}\n", 2, true);
+  REQUIRE(duplicated.diagnostic.hasErrors() == 1);
+  REQUIRE(duplicated.diagnostic.peakError().code ==
+          babycpp::diagnostic::IssueCode::MODULE_LINK_FAILURE);
+}
+
+TEST_CASE("Testing compile after a parallel IR generation", "[codegen]") {
+  Codegenerator gen;
+  gen.generateModuleContentParallel(
+      "int foo(int a){ return a + 1;}\nint baz(int c){ return c * 3;}\n", 2,
+      true);
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+  REQUIRE(gen.functionProtos.touched.size() == 2);
+
+  // the functions generated by the workers can be called from the session
+  gen.initFromString("int bar(int b){ return foo(b)*2 + baz(b);}");
+  gen.generateModuleContent();
+  checkGenErrors(&gen);
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+  REQUIRE(gen.module->getFunction("bar") != nullptr);
+  REQUIRE_FALSE(llvm::verifyModule(*gen.module, &llvm::errs()));
+}
+
+TEST_CASE("Testing parallel IR generation forward calls", "[codegen]") {
+  // calling a function defined further down is an error in a single pass,
+  // the workers must not accept it either, even if the callee is generated
+  // by another worker
+  const std::string source{"int a(int x){ return b(x);}\n"
+                           "int b(int x){ return x;}\n"};
+  Codegenerator sequential;
+  sequential.initFromString(source);
+  sequential.generateModuleContent();
+  REQUIRE(sequential.diagnostic.hasErrors() != 0);
+
+  Codegenerator parallel;
+  parallel.generateModuleContentParallel(source, 2, true);
+  REQUIRE(parallel.diagnostic.hasErrors() != 0);
+  REQUIRE(parallel.diagnostic.peakError().code ==
+          babycpp::diagnostic::IssueCode::UNDEFINED_FUNCTION);
+}
+
+TEST_CASE("Testing optimization levels", "[codegen]") {
+  const std::string source{
+      "float sq(float x){ return x * x;}\n"
+      "float func(float x){ float res = 0.0; "
+      "for(int i = 0; i < 4; i = i + 1){ res = res + sq(x);} return res;}\n"};
+  auto countOpcodes = [](llvm::Function *function, unsigned opcode) {
+    int count = 0;
+    for (llvm::BasicBlock &block : *function) {
+      for (llvm::Instruction &inst : block) {
+        count += inst.getOpcode() == opcode ? 1 : 0;
+      }
+    }
+    return count;
+  };
+
+  Codegenerator unoptimized;
+  unoptimized.initFromString(source);
+  unoptimized.generateModuleContent();
+  checkGenErrors(&unoptimized);
+  REQUIRE(unoptimized.optimizeModule() == false);
+  llvm::Function *func = unoptimized.module->getFunction("func");
+  REQUIRE(countOpcodes(func, llvm::Instruction::Alloca) > 0);
+  REQUIRE(countOpcodes(func, llvm::Instruction::Call) == 1);
+  REQUIRE(unoptimized.optimizer.stats.functionsOptimized == 0);
+
+  Codegenerator gen;
+  gen.optimizer.level = babycpp::codegen::OptLevel::O2;
+  gen.initFromString(source);
+  gen.generateModuleContent();
+  checkGenErrors(&gen);
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+  // variables promoted to registers right after generating the function
+  func = gen.module->getFunction("func");
+  REQUIRE(countOpcodes(func, llvm::Instruction::Alloca) == 0);
+  REQUIRE(countOpcodes(func, llvm::Instruction::Call) == 1);
+  REQUIRE(gen.optimizer.stats.functionsOptimized == 2);
+  REQUIRE(gen.optimizer.stats.instructionsAfter <
+          gen.optimizer.stats.instructionsBefore);
+
+  // inlining happens on the whole module
+  gen.optimizeModule();
+  func = gen.module->getFunction("func");
+  REQUIRE(func != nullptr);
+  REQUIRE(countOpcodes(func, llvm::Instruction::Call) == 0);
+  REQUIRE(gen.optimizer.stats.modulesOptimized == 1);
+  REQUIRE_FALSE(llvm::verifyModule(*gen.module, &llvm::errs()));
+
+  // same result when the whole pipeline runs at the end
+  Codegenerator deferred;
+  deferred.optimizer.level = babycpp::codegen::OptLevel::O2;
+  deferred.optimizer.runPerFunction = false;
+  deferred.initFromString(source);
+  deferred.generateModuleContent();
+  REQUIRE(deferred.optimizer.stats.functionsOptimized == 0);
+  deferred.optimizeModule();
+  func = deferred.module->getFunction("func");
+  REQUIRE(countOpcodes(func, llvm::Instruction::Alloca) == 0);
+  REQUIRE(countOpcodes(func, llvm::Instruction::Call) == 0);
+  REQUIRE_FALSE(llvm::verifyModule(*deferred.module, &llvm::errs()));
+}
+
+TEST_CASE("Testing loop vectorization for the host", "[codegen]") {
+  const std::string source{
+      "void scale(float* out, float* in, int count){ "
+      "for(int i = 0; i < count; i = i + 1){ float* dst = out + i; "
+      "float* src = in + i; float value = *src; "
+      "*dst = value * 2.0 + 1.0;}}\n"};
+  auto countVectorOps = [](llvm::Function *function) {
+    int count = 0;
+    for (llvm::BasicBlock &block : *function) {
+      for (llvm::Instruction &inst : block) {
+        count += inst.getType()->isVectorTy() ? 1 : 0;
+      }
+    }
+    return count;
+  };
+
+  llvm::InitializeNativeTarget();
+  babycpp::codegen::TargetSelection host =
+      babycpp::codegen::hostTargetSelection();
+  REQUIRE_FALSE(host.cpu.empty());
+  std::string error;
+  auto tm = babycpp::codegen::createTargetMachine(
+      host, babycpp::codegen::OptLevel::O2, &error);
+  INFO(error);
+  REQUIRE(tm != nullptr);
+
+  // without a target the cost model has no vector registers
+  Codegenerator generic;
+  generic.optimizer.level = babycpp::codegen::OptLevel::O2;
+  generic.initFromString(source);
+  generic.generateModuleContent();
+  checkGenErrors(&generic);
+  REQUIRE(generic.diagnostic.hasErrors() == 0);
+  generic.optimizeModule();
+  REQUIRE(countVectorOps(generic.module->getFunction("scale")) == 0);
+
+  Codegenerator gen;
+  gen.optimizer.level = babycpp::codegen::OptLevel::O2;
+  gen.optimizer.targetMachine = tm.get();
+  gen.initFromString(source);
+  gen.generateModuleContent();
+  checkGenErrors(&gen);
+  gen.optimizeModule();
+  REQUIRE(gen.module->getTargetTriple() == tm->getTargetTriple().str());
+  REQUIRE(countVectorOps(gen.module->getFunction("scale")) > 0);
+  REQUIRE_FALSE(llvm::verifyModule(*gen.module, &llvm::errs()));
+
+  // vectorizers can be turned off
+  Codegenerator scalar;
+  scalar.optimizer.level = babycpp::codegen::OptLevel::O2;
+  scalar.optimizer.targetMachine = tm.get();
+  scalar.optimizer.vectorize = false;
+  scalar.initFromString(source);
+  scalar.generateModuleContent();
+  scalar.optimizeModule();
+  REQUIRE(countVectorOps(scalar.module->getFunction("scale")) == 0);
+}
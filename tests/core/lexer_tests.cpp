@@ -3,502 +3,981 @@
 #include "catch.hpp"
 #include <lexer.h>
 
+#include <cstdio>
+#include <fstream>
+
 using babycpp::lexer::Lexer;
+using babycpp::lexer::LexerMode;
 using babycpp::lexer::MovableToken;
 using babycpp::lexer::Token;
 
 babycpp::diagnostic::Diagnostic diagnostic;
 
+// every lexer test is run against both implementations, the scanner
+// is required to be token for token compatible with the regex
+static const LexerMode LEXER_MODES[] = {LexerMode::REGEX, LexerMode::SCANNER};
+
 TEST_CASE("Testing empty lexer", "[lexer]") {
-  Lexer lex(&diagnostic);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_empty_lexer);
+  for (auto mode : LEXER_MODES) {
+    Lexer lex(&diagnostic, mode);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_empty_lexer);
+  }
 }
 
 TEST_CASE("Testing empty string", "[lexer]") {
-  Lexer lex(&diagnostic);
-  lex.initFromString("");
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_eof);
+  for (auto mode : LEXER_MODES) {
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString("");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_eof);
+  }
 }
 
 TEST_CASE("Testing no match", "[lexer]") {
-  Lexer lex(&diagnostic);
-  lex.initFromString(" ~~~~~~~ ");
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_no_match);
+  for (auto mode : LEXER_MODES) {
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(" ~~~~~~~ ");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_no_match);
+  }
 }
 
 TEST_CASE("Testing keyword tok", "[lexer]") {
-  std::string str{" int"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_int);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_eof);
-
-  str = " float lksdfjlj";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_float);
-
-  str = "string ";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_string);
-  lex.gettok();
-  REQUIRE(lex.currtok != Token::tok_eof);
+  for (auto mode : LEXER_MODES) {
+    std::string str{" int"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_int);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_eof);
+
+    str = " float lksdfjlj";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_float);
+
+    str = "string ";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_string);
+    lex.gettok();
+    REQUIRE(lex.currtok != Token::tok_eof);
+  }
 }
 
 TEST_CASE("Testing numbers tok", "[lexer]") {
-  std::string str{" 12334 "};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_int);
-  REQUIRE(lex.value.integerNumber == 12334);
-
-  str = "0.3234214";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_float);
-  REQUIRE(lex.value.floatNumber == Approx(0.3234214f));
-
-  str = "0.3.4214";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_malformed_number);
+  for (auto mode : LEXER_MODES) {
+    std::string str{" 12334 "};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 12334);
+
+    str = "0.3234214";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(0.3234214f));
+
+    str = "0.3.4214";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_malformed_number);
+
+    str = "3240..34214";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_malformed_number);
+
+    str = "3240.";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(3240.0f));
+  }
+}
 
-  str = "3240..34214";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_malformed_number);
+TEST_CASE("Testing numeric literal forms", "[lexer]") {
+  for (auto mode : LEXER_MODES) {
+    Lexer lex(&diagnostic, mode);
+
+    lex.initFromString("0x1F 0XFFFFFFFF 1e3 2.5E-2 .5e+1 7f 3.f 42u 42L 12e");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 31);
+
+    // hex keeps the bit pattern
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == -1);
+
+    lex.gettok();
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(1000.0f));
+
+    lex.gettok();
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(0.025f));
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(5.0f));
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(7.0f));
+
+    lex.gettok();
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(3.0f));
+
+    lex.gettok();
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 42);
+
+    lex.gettok();
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 42);
+
+    // exponent without digits is not part of the number
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.integerNumber == 12);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "e");
+
+    lex.initFromString("0.000000000000000000000000123456789 1.5uf 0x1Fu");
+    lex.gettok();
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(1.23456789e-25f));
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_malformed_number);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.integerNumber == 31);
+
+    // every suffix at most once, l and ll only as a single group
+    lex.initFromString("1.0ff 1lll 1fl 1uu 1lul 1lL 3ull 3LLu 2.0F");
+    for (int i = 0; i < 6; ++i) {
+      lex.gettok();
+      REQUIRE(lex.currtok == Token::tok_malformed_number);
+    }
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.integerNumber == 3);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.integerNumber == 3);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(2.0f));
+
+    // the whole hex literal is a single number token, x and F are not
+    // left over as an identifier
+    lex.initFromString("0x1F+1");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 31);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_operator);
+    REQUIRE(lex.identifierStr == "+");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 1);
+  }
+}
 
-  str = "3240.";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_float);
-  REQUIRE(lex.value.floatNumber == Approx(3240.0f));
+TEST_CASE("Testing numeric literal overflow", "[lexer]") {
+  for (auto mode : LEXER_MODES) {
+    babycpp::diagnostic::Diagnostic numberDiagnostic;
+    Lexer lex(&numberDiagnostic, mode);
+
+    lex.initFromString("2147483647 2147483648 4294967295u 0x100000000 "
+                       "99999999999999999999999 3.4e38 3.5e38 1e-60");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.integerNumber == 2147483647);
+    REQUIRE(numberDiagnostic.hasErrors() == 0);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_malformed_number);
+    REQUIRE(numberDiagnostic.hasErrors() == 1);
+    auto err = numberDiagnostic.getError();
+    REQUIRE(err.code ==
+            babycpp::diagnostic::IssueCode::NUMBER_LITERAL_OUT_OF_RANGE);
+    REQUIRE(err.type == babycpp::diagnostic::IssueType::LEXER);
+    REQUIRE(err.line == 1);
+    REQUIRE(err.column == 21);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(static_cast<uint32_t>(lex.value.integerNumber) == 4294967295u);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_malformed_number);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_malformed_number);
+    REQUIRE(numberDiagnostic.hasErrors() == 2);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.floatNumber == Approx(3.4e38f));
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_malformed_number);
+    REQUIRE(numberDiagnostic.hasErrors() == 3);
+
+    // underflow just rounds to zero
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.floatNumber == 0.0f);
+  }
 }
 
 TEST_CASE("Testing operators tok", "[lexer]") {
-  std::string str{" + 99 "};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_operator);
-  REQUIRE(lex.identifierStr == "+");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_int);
-  REQUIRE(lex.value.integerNumber == 99);
-
-  str = " - 0.314";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_operator);
-  REQUIRE(lex.identifierStr == "-");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_float);
-  REQUIRE(lex.value.floatNumber == Approx(0.314f));
-
-  str = " * 1191";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_operator);
-  REQUIRE(lex.identifierStr == "*");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_int);
-  REQUIRE(lex.value.integerNumber == 1191);
-
-  str = " / 0.1135";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_operator);
-  REQUIRE(lex.identifierStr == "/");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_float);
-  REQUIRE(lex.value.floatNumber == Approx(0.1135f));
-
-  str = " < 19";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_operator);
-  REQUIRE(lex.identifierStr == "<");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_int);
-  REQUIRE(lex.value.integerNumber == 19);
-
-  str = " = 3242235";
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_assigment_operator);
-  REQUIRE(lex.identifierStr == "=");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_int);
-  REQUIRE(lex.value.integerNumber == 3242235);
+  for (auto mode : LEXER_MODES) {
+    std::string str{" + 99 "};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_operator);
+    REQUIRE(lex.identifierStr == "+");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 99);
+
+    str = " - 0.314";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_operator);
+    REQUIRE(lex.identifierStr == "-");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(0.314f));
+
+    str = " * 1191";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_operator);
+    REQUIRE(lex.identifierStr == "*");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 1191);
+
+    str = " / 0.1135";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_operator);
+    REQUIRE(lex.identifierStr == "/");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(0.1135f));
+
+    str = " < 19";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_operator);
+    REQUIRE(lex.identifierStr == "<");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 19);
+
+    str = " = 3242235";
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_assigment_operator);
+    REQUIRE(lex.identifierStr == "=");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 3242235);
+  }
 }
 TEST_CASE("Testing * operator with no space", "[lexer]") {
-
-  // in a situation like this, although pointers are not supported
-  // yet, there is the chance that "x*" will be parsed as a pointer
-  // and not as an operator
-  const std::string str{" x*4 "};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "x");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_operator);
-  REQUIRE(lex.identifierStr == "*");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_int);
-  REQUIRE(lex.value.integerNumber == 4);
+  for (auto mode : LEXER_MODES) {
+
+    // in a situation like this, although pointers are not supported
+    // yet, there is the chance that "x*" will be parsed as a pointer
+    // and not as an operator
+    const std::string str{" x*4 "};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "x");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_operator);
+    REQUIRE(lex.identifierStr == "*");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 4);
+  }
 }
 TEST_CASE("Testing extern tok", "[lexer]") {
-  const std::string str{" extern sin( float x);"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
+  for (auto mode : LEXER_MODES) {
+    const std::string str{" extern sin( float x);"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
 
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_extern);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_extern);
 
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "sin");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "sin");
 
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_open_round);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_open_round);
 
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_float);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_float);
 
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "x");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "x");
 
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_close_round);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_close_round);
 
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_end_statement);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_end_statement);
+  }
 }
 
 TEST_CASE("Testing multi line", "[lexer]") {
-  const std::string str{"x \n  2.0"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "x");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.lineNumber == 2);
-  REQUIRE(lex.value.type == Token::tok_float);
-  REQUIRE(lex.value.floatNumber == Approx(2.0f));
+  for (auto mode : LEXER_MODES) {
+    const std::string str{"x \n  2.0"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "x");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.lineNumber == 2);
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(2.0f));
+  }
 }
 
 TEST_CASE("Testing column advancement 1", "[lexer]") {
+  for (auto mode : LEXER_MODES) {
 
-  const std::string str{"aa 12 cc 3.14 ee"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-  REQUIRE(lex.lookAheadToken.empty());
-  REQUIRE(lex.columnNumber == 0);
+    const std::string str{"aa 12 cc 3.14 ee"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+    REQUIRE(lex.lookAheadToken.empty());
+    REQUIRE(lex.columnNumber == 0);
 
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 2);
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 2);
 
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 5);
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 5);
 
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 8);
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 8);
 
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 13);
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 13);
 
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 16);
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 16);
+  }
 }
 
 TEST_CASE("Testing column advancement 2", "[lexer]") {
-  const std::string str{
-      "if else randomword \n \n else \n whatever \n ifelse elseif"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 2);
-
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 7);
-
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 18);
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_else);
-  REQUIRE(lex.columnNumber == 5);
-  REQUIRE(lex.lineNumber == 3);
-
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 9);
-  REQUIRE(lex.lineNumber == 4);
-
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 7);
-  REQUIRE(lex.lineNumber == 5);
-
-  lex.gettok();
-  REQUIRE(lex.columnNumber == 14);
-  REQUIRE(lex.lineNumber == 5);
+  for (auto mode : LEXER_MODES) {
+    const std::string str{
+        "if else randomword \n \n else \n whatever \n ifelse elseif"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 2);
+
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 7);
+
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 18);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_else);
+    REQUIRE(lex.columnNumber == 5);
+    REQUIRE(lex.lineNumber == 3);
+
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 9);
+    REQUIRE(lex.lineNumber == 4);
+
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 7);
+    REQUIRE(lex.lineNumber == 5);
+
+    lex.gettok();
+    REQUIRE(lex.columnNumber == 14);
+    REQUIRE(lex.lineNumber == 5);
+  }
 }
 
 TEST_CASE("Testing testing buffering", "[lexer]") {
-
-  const std::string str{"aa 12 cc 3.14 ee"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-  REQUIRE(lex.lookAheadToken.empty());
-
-  bool res = lex.lookAhead(4);
-  REQUIRE(res == true);
-  REQUIRE(lex.lookAheadToken.size() == 4);
-
-  lex.gettok();
-  REQUIRE(lex.lookAheadToken.size() == 3);
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "aa");
-
-  lex.gettok();
-  REQUIRE(lex.lookAheadToken.size() == 2);
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_int);
-  REQUIRE(lex.value.integerNumber == 12);
-
-  lex.gettok();
-  REQUIRE(lex.lookAheadToken.size() == 1);
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "cc");
-
-  lex.gettok();
-  REQUIRE(lex.lookAheadToken.empty());
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.type == Token::tok_float);
-  REQUIRE(lex.value.floatNumber == Approx(3.14f));
-
-  // here the buffer should be emtpy
-  lex.gettok();
-  REQUIRE(lex.lookAheadToken.empty());
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "ee");
+  for (auto mode : LEXER_MODES) {
+
+    const std::string str{"aa 12 cc 3.14 ee"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+    REQUIRE(lex.lookAheadToken.empty());
+
+    bool res = lex.lookAhead(4);
+    REQUIRE(res == true);
+    REQUIRE(lex.lookAheadToken.size() == 4);
+
+    lex.gettok();
+    REQUIRE(lex.lookAheadToken.size() == 3);
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "aa");
+
+    lex.gettok();
+    REQUIRE(lex.lookAheadToken.size() == 2);
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_int);
+    REQUIRE(lex.value.integerNumber == 12);
+
+    lex.gettok();
+    REQUIRE(lex.lookAheadToken.size() == 1);
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "cc");
+
+    lex.gettok();
+    REQUIRE(lex.lookAheadToken.empty());
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.type == Token::tok_float);
+    REQUIRE(lex.value.floatNumber == Approx(3.14f));
+
+    // here the buffer should be emtpy
+    lex.gettok();
+    REQUIRE(lex.lookAheadToken.empty());
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "ee");
+  }
 }
 
 TEST_CASE("Testing too much look ahead", "[lexer]") {
-  const std::string str{"xyz "};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-
-  bool res = lex.lookAhead(10);
-  REQUIRE(res == false);
+  for (auto mode : LEXER_MODES) {
+    const std::string str{"xyz "};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+
+    bool res = lex.lookAhead(10);
+    REQUIRE(res == false);
+  }
 }
 TEST_CASE("Testing clear look ahead", "[lexer]") {
-  const std::string str{"this should be cleared after look ahead and init"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
+  for (auto mode : LEXER_MODES) {
+    const std::string str{"this should be cleared after look ahead and init"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+
+    bool res = lex.lookAhead(4);
+    REQUIRE(res == true);
+    lex.initFromString("cleanup");
+    REQUIRE(lex.lookAheadToken.size() == 0);
+  }
+}
 
-  bool res = lex.lookAhead(4);
-  REQUIRE(res == true);
-  lex.initFromString("cleanup");
-  REQUIRE(lex.lookAheadToken.size() == 0);
+TEST_CASE("Testing look ahead keeps positions", "[lexer]") {
+  for (auto mode : LEXER_MODES) {
+    const std::string str{"aa 12\n cc 3.14 ee\n ff gg hh ii jj kk"};
+    Lexer plain(&diagnostic, mode);
+    Lexer ahead(&diagnostic, mode);
+    plain.initFromString(str);
+    ahead.initFromString(str);
+
+    // looking ahead at every step, with overlapping requests, goes around
+    // the ring buffer more than once and must not change what gettok sees
+    for (int i = 0; i < 11; ++i) {
+      int lineBefore = ahead.lineNumber;
+      int columnBefore = ahead.columnNumber;
+      ahead.lookAhead(1 + (i % 3));
+      REQUIRE(ahead.lineNumber == lineBefore);
+      REQUIRE(ahead.columnNumber == columnBefore);
+
+      plain.gettok();
+      ahead.gettok();
+      REQUIRE(ahead.currtok == plain.currtok);
+      REQUIRE(ahead.identifierStr == plain.identifierStr);
+      REQUIRE(ahead.lineNumber == plain.lineNumber);
+      REQUIRE(ahead.columnNumber == plain.columnNumber);
+    }
+    REQUIRE(ahead.identifierStr == "kk");
+    REQUIRE(!ahead.lookAhead(1));
+    ahead.gettok();
+    REQUIRE(ahead.currtok == Token::tok_eof);
+  }
 }
 
-TEST_CASE("Testing if statement", "[lexer]") {
-  const std::string str{"if else randomword else whatever ifelse elseif"};
+TEST_CASE("Testing look ahead over capacity", "[lexer]") {
   Lexer lex(&diagnostic);
-  lex.initFromString(str);
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_if);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_else);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "randomword");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_else);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "whatever");
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "ifelse");
+  lex.initFromString("a b c d e f g h i j k");
+  int capacity = babycpp::lexer::TokenRingBuffer::CAPACITY;
+  REQUIRE(!lex.lookAhead(capacity + 1));
+  REQUIRE(lex.lookAheadToken.empty());
+  REQUIRE(lex.lookAhead(capacity));
+  REQUIRE(lex.lookAheadToken.size() == capacity);
+  REQUIRE(lex.lookAheadToken[capacity - 1].identifierStr == "h");
+}
 
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "elseif");
+TEST_CASE("Testing if statement", "[lexer]") {
+  for (auto mode : LEXER_MODES) {
+    const std::string str{"if else randomword else whatever ifelse elseif"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_if);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_else);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "randomword");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_else);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "whatever");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "ifelse");
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "elseif");
+  }
 }
 
 TEST_CASE("Testing for loop keyword lexer", "[lexer]") {
-
-  const std::string str{"for forfor for{"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_for);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_for);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_open_curly);
+  for (auto mode : LEXER_MODES) {
+
+    const std::string str{"for forfor for{"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_for);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_for);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_open_curly);
+  }
 }
 
 TEST_CASE("Testing pointer correctly", "[lexer]") {
-
-  const std::string str{"int* myFunction()"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-  lex.gettok();
-
-  // the key thing here is that we let the lexer not include * in the
-  // token after that we let the lexer figure based on the type what to do
-  REQUIRE(lex.currtok == Token::tok_int);
-  REQUIRE(lex.identifierStr == "int");
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_operator);
-  REQUIRE(lex.identifierStr == "*");
+  for (auto mode : LEXER_MODES) {
+
+    const std::string str{"int* myFunction()"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+    lex.gettok();
+
+    // the key thing here is that we let the lexer not include * in the
+    // token after that we let the lexer figure based on the type what to do
+    REQUIRE(lex.currtok == Token::tok_int);
+    REQUIRE(lex.identifierStr == "int");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_operator);
+    REQUIRE(lex.identifierStr == "*");
+  }
 }
 
 TEST_CASE("Testing writing to pointer", "[lexer]") {
-
-  const std::string str{" *myPtr = 20;"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-  lex.gettok();
-
-  // the key thing here is that we let the lexer not include * in the
-  // token after that we let the lexer figure based on the type what to do
-  REQUIRE(lex.currtok == Token::tok_operator);
-  REQUIRE(lex.identifierStr == "*");
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_assigment_operator);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.integerNumber == 20);
+  for (auto mode : LEXER_MODES) {
+
+    const std::string str{" *myPtr = 20;"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+    lex.gettok();
+
+    // the key thing here is that we let the lexer not include * in the
+    // token after that we let the lexer figure based on the type what to do
+    REQUIRE(lex.currtok == Token::tok_operator);
+    REQUIRE(lex.identifierStr == "*");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_assigment_operator);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.integerNumber == 20);
+  }
 }
 
 TEST_CASE("Testing lexing allocation", "[lexer]") {
-
-  const std::string str{"malloc(20)"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-  lex.gettok();
-
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "malloc");
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_open_round);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_number);
-  REQUIRE(lex.value.integerNumber == 20);
+  for (auto mode : LEXER_MODES) {
+
+    const std::string str{"malloc(20)"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+    lex.gettok();
+
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "malloc");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_open_round);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_number);
+    REQUIRE(lex.value.integerNumber == 20);
+  }
 }
 
 TEST_CASE("Testing lexing free", "[lexer]") {
-
-  const std::string str{"free(myPtr)"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-  lex.gettok();
-
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "free");
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_open_round);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  REQUIRE(lex.identifierStr == "myPtr");
+  for (auto mode : LEXER_MODES) {
+
+    const std::string str{"free(myPtr)"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+    lex.gettok();
+
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "free");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_open_round);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    REQUIRE(lex.identifierStr == "myPtr");
+  }
 }
 
 TEST_CASE("Testing linefeed with no space", "[lexer]") {
+  for (auto mode : LEXER_MODES) {
+
+    const std::string str{
+        "float testFunc(float a , float b)\n"
+        "{ float result = 0.0; result = result + a; return result; }"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+    lex.gettok();
+
+    REQUIRE(lex.currtok == Token::tok_float);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_open_round);
+    lex.gettok();
+
+    REQUIRE(lex.currtok == Token::tok_float);
+    lex.gettok();
+
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    lex.gettok();
+
+    REQUIRE(lex.currtok == Token::tok_comma);
+    lex.gettok();
+
+    REQUIRE(lex.currtok == Token::tok_float);
+    lex.gettok();
+
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    lex.gettok();
+    REQUIRE(lex.currtok != Token::tok_no_match);
+    REQUIRE(lex.currtok != Token::tok_open_curly);
+  }
+}
+TEST_CASE("Testing void ptr", "[lexer]") {
+  for (auto mode : LEXER_MODES) {
+
+    const std::string str{"void* ptr  voidvoid*"};
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_void_ptr);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_operator);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    lex.gettok();
+    //the voidvoid gets parsed as identifier since the alg match the whole word
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_operator);
+    lex.gettok();
+  }
+}
+
+TEST_CASE("Testing scanner token compatibility with regex", "[lexer]") {
 
   const std::string str{
-      "float testFunc(float a , float b)\n"
-      "{ float result = 0.0; result = result + a; return result; }"};
-  Lexer lex(&diagnostic);
-  lex.initFromString(str);
-  lex.gettok();
+      "extern float sin(float x);\n"
+      "float* avg(float* data, int count)\r\n"
+      "{ float res = 0.0; for(int i = 0; i < count; i = i+1)\n"
+      "  { res = res + *data; data = data + 1;}\t return res / 3.; }\n"
+      "int my_var2 = (int)x_1 * 12.3.4;\n void* ptr = nullptr; ~ "};
+  Lexer regexLex(&diagnostic, LexerMode::REGEX);
+  Lexer scannerLex(&diagnostic, LexerMode::SCANNER);
+  regexLex.initFromString(str);
+  scannerLex.initFromString(str);
+
+  int counter = 0;
+  while (counter < 200) {
+    regexLex.gettok();
+    scannerLex.gettok();
+    REQUIRE(regexLex.currtok == scannerLex.currtok);
+    REQUIRE(regexLex.lineNumber == scannerLex.lineNumber);
+    REQUIRE(regexLex.columnNumber == scannerLex.columnNumber);
+    if (regexLex.currtok == Token::tok_identifier) {
+      REQUIRE(regexLex.identifierStr == scannerLex.identifierStr);
+    }
+    if (regexLex.currtok == Token::tok_number) {
+      REQUIRE(regexLex.value.type == scannerLex.value.type);
+      REQUIRE(regexLex.value.integerNumber == scannerLex.value.integerNumber);
+    }
+    if (regexLex.currtok == Token::tok_eof ||
+        regexLex.currtok == Token::tok_no_match) {
+      break;
+    }
+    ++counter;
+  }
+  REQUIRE(regexLex.currtok == Token::tok_no_match);
+  REQUIRE(counter > 60);
+}
 
-  REQUIRE(lex.currtok == Token::tok_float);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_open_round);
-  lex.gettok();
+TEST_CASE("Testing identifiers interning", "[lexer]") {
+  for (auto mode : LEXER_MODES) {
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString("x y int x lookAhead");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_identifier);
+    auto xId = lex.identifierId;
+    REQUIRE(xId != babycpp::symbol::INVALID_SYMBOL);
+    lex.gettok();
+    auto yId = lex.identifierId;
+    REQUIRE(yId != xId);
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_int);
+    REQUIRE(lex.identifierId == babycpp::symbol::INVALID_SYMBOL);
+    lex.gettok();
+    REQUIRE(lex.identifierId == xId);
+    REQUIRE(lex.symbols.getName(xId) == "x");
+
+    // looking ahead should not change the current symbol
+    lex.lookAhead(1);
+    REQUIRE(lex.identifierId == xId);
+    REQUIRE(lex.lookAheadToken[0].identifierId ==
+            lex.symbols.find("lookAhead"));
+    lex.gettok();
+    REQUIRE(lex.symbols.getName(lex.identifierId) == "lookAhead");
+
+    // symbols survive re-initialization of the lexer
+    lex.initFromString("x");
+    lex.gettok();
+    REQUIRE(lex.identifierId == xId);
+    REQUIRE(lex.symbols.size() == 3);
+  }
+}
 
-  REQUIRE(lex.currtok == Token::tok_float);
-  lex.gettok();
+TEST_CASE("Testing keyword perfect hash against keyword map", "[lexer]") {
+  for (const auto &keyword : babycpp::lexer::KEYWORDS) {
+    REQUIRE(babycpp::lexer::lookupKeyword(keyword.first) == keyword.second);
+  }
+  // mix of near misses and real keywords, the two must always agree
+  const char *candidates[] = {"i",       "in",  "ints",     "fo",  "flo",
+                              "else_",   "void", "extrn",   "nul", "x",
+                              "returns", "|",    "nullptra", "Int", "."};
+  for (const char *str : candidates) {
+    bool inMap = babycpp::lexer::KEYWORDS.find(str) !=
+                 babycpp::lexer::KEYWORDS.end();
+    REQUIRE((babycpp::lexer::lookupKeyword(str) != Token::tok_no_match) ==
+            inMap);
+  }
+}
 
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  lex.gettok();
+TEST_CASE("Testing lexing from file", "[lexer]") {
+  const std::string str{"float avg(float* data, int count)\n"
+                        "{ float res = 0.0;\n  return res / 2; }\n"};
+  const std::string path{"lexerFromFileTest.txt"};
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << str;
+  }
+
+  for (auto mode : LEXER_MODES) {
+    Lexer fileLex(&diagnostic, mode);
+    Lexer stringLex(&diagnostic, mode);
+    REQUIRE(fileLex.initFromFile(path));
+    stringLex.initFromString(str);
+    REQUIRE(fileLex.data.empty());
+
+    // same tokens and same positions as lexing from memory
+    int counter = 0;
+    while (counter < 100) {
+      fileLex.gettok();
+      stringLex.gettok();
+      REQUIRE(fileLex.currtok == stringLex.currtok);
+      REQUIRE(fileLex.lineNumber == stringLex.lineNumber);
+      REQUIRE(fileLex.columnNumber == stringLex.columnNumber);
+      if (fileLex.currtok == Token::tok_identifier) {
+        REQUIRE(fileLex.identifierStr == stringLex.identifierStr);
+        REQUIRE(fileLex.identifierStr.data() >=
+                fileLex.fileBuffer->getBufferStart());
+      }
+      if (fileLex.currtok == Token::tok_eof ||
+          fileLex.currtok == Token::tok_no_match) {
+        break;
+      }
+      ++counter;
+    }
+    REQUIRE(fileLex.currtok == Token::tok_eof);
+    REQUIRE(fileLex.lineNumber == 4);
+  }
+  std::remove(path.c_str());
+}
 
-  REQUIRE(lex.currtok == Token::tok_comma);
+TEST_CASE("Testing lexing from missing file", "[lexer]") {
+  babycpp::diagnostic::Diagnostic fileDiagnostic;
+  Lexer lex(&fileDiagnostic);
+  REQUIRE(!lex.initFromFile("thisFileDoesNotExist.txt"));
+  REQUIRE(fileDiagnostic.hasErrors() == 1);
+  auto err = fileDiagnostic.getError();
+  REQUIRE(err.code ==
+          babycpp::diagnostic::IssueCode::CANNOT_OPEN_SOURCE_FILE);
+  REQUIRE(err.type == babycpp::diagnostic::IssueType::LEXER);
   lex.gettok();
+  REQUIRE(lex.currtok == Token::tok_empty_lexer);
+}
 
-  REQUIRE(lex.currtok == Token::tok_float);
-  lex.gettok();
+TEST_CASE("Testing tokenize up front", "[lexer]") {
+  const std::string str{"extern float sin(float x);\n"
+                        "float* avg(float* data, int count)\n"
+                        "{ float res = 0.0; for(int i = 0; i < count; i = i+1)"
+                        "\n  { res = res + *data; data = data + 1;}\n"
+                        " return res / 3.; }\n"};
+  for (auto mode : LEXER_MODES) {
+    Lexer streaming(&diagnostic, mode);
+    Lexer batch(&diagnostic, mode);
+    streaming.initFromString(str);
+    batch.initFromString(str);
+    REQUIRE(batch.tokenize());
+    REQUIRE(batch.tokens.kinds.back() == Token::tok_eof);
+
+    // two passes over the buffer, the second after a rewind
+    for (int pass = 0; pass < 2; ++pass) {
+      int counter = 0;
+      while (counter < 200) {
+        if (pass == 0) {
+          streaming.gettok();
+        }
+        batch.gettok();
+        REQUIRE(batch.currtok == batch.tokens.kinds[counter]);
+        if (pass == 0) {
+          REQUIRE(batch.currtok == streaming.currtok);
+          REQUIRE(batch.lineNumber == streaming.lineNumber);
+          REQUIRE(batch.columnNumber == streaming.columnNumber);
+          REQUIRE(batch.identifierStr == streaming.identifierStr);
+          REQUIRE(batch.identifierId == streaming.identifierId);
+          if (batch.currtok == Token::tok_number) {
+            REQUIRE(batch.value.integerNumber ==
+                    streaming.value.integerNumber);
+          }
+        }
+        if (batch.currtok == Token::tok_eof) {
+          break;
+        }
+        ++counter;
+      }
+      REQUIRE(counter + 1 == static_cast<int>(batch.tokens.size()));
+      // the terminator keeps being returned
+      batch.gettok();
+      REQUIRE(batch.currtok == Token::tok_eof);
+      batch.rewind();
+    }
+  }
+}
 
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  lex.gettok();
-  REQUIRE(lex.currtok != Token::tok_no_match);
-  REQUIRE(lex.currtok != Token::tok_open_curly);
+TEST_CASE("Testing token buffer look ahead", "[lexer]") {
+  Lexer lex(&diagnostic);
+  lex.initFromString("a b c d e f g h i j k l");
+  REQUIRE(lex.tokenize());
+  lex.gettok();
+  REQUIRE(lex.identifierStr == "a");
+  // more than the ring buffer could hold, reading ahead is free
+  REQUIRE(lex.lookAhead(11));
+  REQUIRE(!lex.lookAhead(12));
+  REQUIRE(lex.peekToken(10).identifierStr == "l");
+  REQUIRE(lex.peekToken(11).token == Token::tok_eof);
+  REQUIRE(lex.peekToken(50).token == Token::tok_eof);
+  lex.gettok();
+  REQUIRE(lex.identifierStr == "b");
+  REQUIRE(lex.peekToken(0).identifierStr == "c");
+
+  // init goes back to lex on demand
+  lex.initFromString("x");
+  REQUIRE(!lex.useTokenBuffer);
+  REQUIRE(lex.tokens.size() == 0);
 }
-TEST_CASE("Testing void ptr", "[lexer]") {
 
-  const std::string str{"void* ptr  voidvoid*"};
+TEST_CASE("Testing tokenize stops on failed match", "[lexer]") {
   Lexer lex(&diagnostic);
-  lex.initFromString(str);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_void_ptr);
+  lex.initFromString("a $ b");
+  REQUIRE(!lex.tokenize());
+  REQUIRE(lex.tokens.size() == 2);
   lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_operator);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  lex.gettok();
-  //the voidvoid gets parsed as identifier since the alg match the whole word
-  REQUIRE(lex.currtok == Token::tok_identifier);
-  lex.gettok();
-  REQUIRE(lex.currtok == Token::tok_operator);
+  REQUIRE(lex.identifierStr == "a");
   lex.gettok();
+  REQUIRE(lex.currtok == Token::tok_no_match);
+}
+
+TEST_CASE("Testing multi character operators", "[lexer]") {
+  const char *str = "a<<=b>>c!=d&&e||f|g%=h";
+  const char *expected[] = {"<<=", ">>", "!=", "&&", "||", "|", "%="};
+  for (auto mode : {LexerMode::REGEX, LexerMode::SCANNER}) {
+    Lexer lex(&diagnostic, mode);
+    lex.initFromString(str);
+    for (const char *op : expected) {
+      lex.gettok();
+      REQUIRE(lex.currtok == Token::tok_identifier);
+      lex.gettok();
+      REQUIRE(lex.identifierStr == op);
+    }
+    lex.gettok();
+    REQUIRE(lex.identifierStr == "h");
+    lex.gettok();
+    REQUIRE(lex.currtok == Token::tok_eof);
+  }
 }
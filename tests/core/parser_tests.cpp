@@ -3,8 +3,11 @@
 #include "catch.hpp"
 
 #include <codegen.h>
+#include <compactAST.h>
 #include <factoryAST.h>
+#include <parallelParser.h>
 #include <parser.h>
+#include <visitorAST.h>
 
 using babycpp::codegen::Argument;
 using babycpp::lexer::Lexer;
@@ -424,6 +427,51 @@ TEST_CASE("Testing more complex expression with paren", "[parser]") {
   REQUIRE(rhs_z != nullptr);
   REQUIRE(rhs_z->name == "z");
 }
+TEST_CASE("Testing paren at the end of the source", "[parser]") {
+  // fewer tokens than the cast check looks ahead are left after the (
+  const char *sources[] = {"(a)", "2 * (a)", "(int)", "(x"};
+  for (const char *source : sources) {
+    for (bool tokenizeUpFront : {false, true}) {
+      diagnosticParserTests.clear();
+      Lexer lex(&diagnosticParserTests);
+      lex.initFromString(source);
+      if (tokenizeUpFront) {
+        lex.tokenize();
+      }
+      Parser parser(&lex, &factory, &diagnosticParserTests);
+      lex.gettok();
+      parser.parseExpression();
+    }
+  }
+
+  diagnosticParserTests.clear();
+  Lexer lex(&diagnosticParserTests);
+  lex.initFromString("(a)");
+  Parser parser(&lex, &factory, &diagnosticParserTests);
+  lex.gettok();
+  auto *p = dynamic_cast<VariableExprAST *>(parser.parseExpression());
+  REQUIRE(p != nullptr);
+  REQUIRE(p->name == "a");
+  REQUIRE(diagnosticParserTests.hasErrors() == 0);
+
+  // same for a source ending inside a for loop header
+  const char *forSources[] = {"float f(){ for(int x", "float f(){ for(x",
+                              "float f(){ for(int"};
+  for (const char *source : forSources) {
+    for (bool tokenizeUpFront : {false, true}) {
+      diagnosticParserTests.clear();
+      Lexer forLex(&diagnosticParserTests);
+      forLex.initFromString(source);
+      if (tokenizeUpFront) {
+        forLex.tokenize();
+      }
+      Parser forParser(&forLex, &factory, &diagnosticParserTests);
+      forLex.gettok();
+      REQUIRE(forParser.parseStatement() == nullptr);
+      REQUIRE(diagnosticParserTests.hasErrors() != 0);
+    }
+  }
+}
 TEST_CASE("Testing expression from top level", "[parser]") {
   diagnosticParserTests.clear();
   Lexer lex(&diagnosticParserTests);
@@ -1364,3 +1412,474 @@ TEST_CASE("Testing pointers arithmetic", "[parser]") {
   auto *valueCasted = dynamic_cast<BinaryExprAST*>(ptrAritmCasted->value);
   REQUIRE(valueCasted != nullptr);
 }
+
+TEST_CASE("Testing operator precedence", "[parser]") {
+  diagnosticParserTests.clear();
+  Lexer lex(&diagnosticParserTests);
+  lex.initFromString("a + b * c << 1 == d && e || f");
+  Parser parser(&lex, &factory, &diagnosticParserTests);
+  lex.gettok();
+
+  auto *p = parser.parseExpression();
+  checkParserErrors();
+  REQUIRE(p != nullptr);
+  // ((((a + (b * c)) << 1) == d) && e) || f
+  auto *orOp = dynamic_cast<BinaryExprAST *>(p);
+  REQUIRE(orOp != nullptr);
+  REQUIRE(orOp->op == "||");
+  auto *andOp = dynamic_cast<BinaryExprAST *>(orOp->lhs);
+  REQUIRE(andOp != nullptr);
+  REQUIRE(andOp->op == "&&");
+  auto *eqOp = dynamic_cast<BinaryExprAST *>(andOp->lhs);
+  REQUIRE(eqOp != nullptr);
+  REQUIRE(eqOp->op == "==");
+  auto *shlOp = dynamic_cast<BinaryExprAST *>(eqOp->lhs);
+  REQUIRE(shlOp != nullptr);
+  REQUIRE(shlOp->op == "<<");
+  auto *addOp = dynamic_cast<BinaryExprAST *>(shlOp->lhs);
+  REQUIRE(addOp != nullptr);
+  REQUIRE(addOp->op == "+");
+  auto *mulOp = dynamic_cast<BinaryExprAST *>(addOp->rhs);
+  REQUIRE(mulOp != nullptr);
+  REQUIRE(mulOp->op == "*");
+
+  // subtraction is left associative
+  lex.initFromString("a - b - c");
+  lex.gettok();
+  p = parser.parseExpression();
+  auto *outer = dynamic_cast<BinaryExprAST *>(p);
+  REQUIRE(outer != nullptr);
+  REQUIRE(dynamic_cast<BinaryExprAST *>(outer->lhs) != nullptr);
+  REQUIRE(dynamic_cast<VariableExprAST *>(outer->rhs) != nullptr);
+}
+
+TEST_CASE("Testing compound assignment", "[parser]") {
+  diagnosticParserTests.clear();
+  Lexer lex(&diagnosticParserTests);
+  lex.initFromString("x += 2 * y");
+  Parser parser(&lex, &factory, &diagnosticParserTests);
+  lex.gettok();
+
+  auto *p = parser.parseExpression();
+  checkParserErrors();
+  auto *var = dynamic_cast<VariableExprAST *>(p);
+  REQUIRE(var != nullptr);
+  REQUIRE(var->name == "x");
+  auto *value = dynamic_cast<BinaryExprAST *>(var->value);
+  REQUIRE(value != nullptr);
+  REQUIRE(value->op == "+");
+  auto *lhs = dynamic_cast<VariableExprAST *>(value->lhs);
+  REQUIRE(lhs != nullptr);
+  REQUIRE(lhs->name == "x");
+  auto *rhs = dynamic_cast<BinaryExprAST *>(value->rhs);
+  REQUIRE(rhs != nullptr);
+  REQUIRE(rhs->op == "*");
+}
+
+TEST_CASE("Testing assignment to non variable", "[parser]") {
+  diagnosticParserTests.clear();
+  Lexer lex(&diagnosticParserTests);
+  lex.initFromString("a + b = c");
+  Parser parser(&lex, &factory, &diagnosticParserTests);
+  lex.gettok();
+
+  auto *p = parser.parseExpression();
+  REQUIRE(p == nullptr);
+  REQUIRE(diagnosticParserTests.hasErrors());
+  REQUIRE(diagnosticParserTests.getError().code ==
+          babycpp::diagnostic::IssueCode::EXPECTED_VARIABLE);
+}
+
+TEST_CASE("Testing deeply nested expressions", "[parser]") {
+  diagnosticParserTests.clear();
+  Lexer lex(&diagnosticParserTests);
+  Parser parser(&lex, &factory, &diagnosticParserTests);
+
+  // parenthesis no longer recurse, so nesting is bound only by memory
+  const int depth = 5000;
+  std::string str = std::string(depth, '(') + "a" + std::string(depth, ')');
+  lex.initFromString(str.c_str());
+  lex.gettok();
+  auto *p = parser.parseExpression();
+  checkParserErrors();
+  REQUIRE(p != nullptr);
+  REQUIRE(dynamic_cast<VariableExprAST *>(p) != nullptr);
+
+  std::string chain = "a";
+  for (int i = 0; i < depth; ++i) {
+    chain += " + a";
+  }
+  lex.initFromString(chain.c_str());
+  lex.gettok();
+  p = parser.parseExpression();
+  checkParserErrors();
+  REQUIRE(dynamic_cast<BinaryExprAST *>(p) != nullptr);
+
+  lex.initFromString("((a + b)");
+  lex.gettok();
+  p = parser.parseExpression();
+  REQUIRE(p == nullptr);
+  REQUIRE(diagnosticParserTests.hasErrors());
+  diagnosticParserTests.clear();
+}
+
+TEST_CASE("Testing error recovery in function body", "[parser]") {
+  diagnosticParserTests.clear();
+  Lexer lex(&diagnosticParserTests);
+  lex.initFromString("int testFunc(int x){ int a = ; int b = x * 2; "
+                     "b = (x + ; if (x < 2) { b = ) ; } else { b = 1; } "
+                     "return b;}");
+  Parser parser(&lex, &factory, &diagnosticParserTests);
+  parser.recoverFromErrors = true;
+  lex.gettok();
+
+  auto *p = parser.parseStatement();
+  REQUIRE(p != nullptr);
+  auto *p_casted = dynamic_cast<FunctionAST *>(p);
+  REQUIRE(p_casted != nullptr);
+  // the two valid statements survive, the broken ones are dropped
+  REQUIRE(p_casted->body.size() == 2);
+  auto *ret = dynamic_cast<VariableExprAST *>(p_casted->body[1]);
+  REQUIRE(ret != nullptr);
+  REQUIRE(ret->flags.isReturn);
+  REQUIRE(lex.currtok == Token::tok_eof);
+
+  // all three broken statements are reported, each of them possibly with
+  // the errors of the constructs containing the failure
+  REQUIRE(diagnosticParserTests.hasErrors() >= 3);
+  while (diagnosticParserTests.hasErrors()) {
+    auto err = diagnosticParserTests.getError();
+    REQUIRE(err.type == babycpp::diagnostic::IssueType::PARSER);
+  }
+}
+
+TEST_CASE("Testing error recovery across top level statements", "[parser]") {
+  diagnosticParserTests.clear();
+  Lexer lex(&diagnosticParserTests);
+  lex.initFromString("int broken(int x { return x; }"
+                     "extern ; "
+                     "float ok(float y){ return y; }");
+  Parser parser(&lex, &factory, &diagnosticParserTests);
+  parser.recoverFromErrors = true;
+  lex.gettok();
+
+  auto *p = parser.parseStatement();
+  REQUIRE(p == nullptr);
+  p = parser.parseStatement();
+  REQUIRE(p == nullptr);
+  p = parser.parseStatement();
+  REQUIRE(p != nullptr);
+  auto *p_casted = dynamic_cast<FunctionAST *>(p);
+  REQUIRE(p_casted != nullptr);
+  REQUIRE(p_casted->proto->name == "ok");
+  REQUIRE(diagnosticParserTests.hasErrors() == 2);
+  diagnosticParserTests.clear();
+}
+
+namespace {
+// counts nodes per type walking the whole tree
+struct NodeCounter
+    : babycpp::codegen::VisitorAST<NodeCounter, void> {
+  int counts[babycpp::codegen::NODE_TYPE_COUNT] = {};
+  void visitNode(ExprAST *node) {
+    ++counts[node->nodetype];
+    babycpp::codegen::forEachChild(node,
+                                   [this](ExprAST *child) { visit(child); });
+  }
+};
+// only handles numbers, everything else goes to the default
+struct NumberValue : babycpp::codegen::VisitorAST<NumberValue, int> {
+  int visitNumber(NumberExprAST *node) { return node->val.integerNumber; }
+};
+} // namespace
+
+TEST_CASE("Testing AST visitor", "[parser]") {
+  diagnosticParserTests.clear();
+  Lexer lex(&diagnosticParserTests);
+  lex.initFromString("int testFunc(int x){ int res = 0; "
+                     "for(int i = 0; i < x; i = i + 1){ res = res + f(i, 2);}"
+                     "if (res < 10) { res = 10; } return res;}");
+  Parser parser(&lex, &factory, &diagnosticParserTests);
+  lex.gettok();
+
+  auto *p = parser.parseStatement();
+  checkParserErrors();
+  REQUIRE(p != nullptr);
+
+  NodeCounter counter;
+  counter.visit(p);
+  using babycpp::codegen::NodeType;
+  REQUIRE(counter.counts[NodeType::FunctionNode] == 1);
+  REQUIRE(counter.counts[NodeType::PrototypeNode] == 1);
+  REQUIRE(counter.counts[NodeType::ForNode] == 1);
+  REQUIRE(counter.counts[NodeType::IfNode] == 1);
+  REQUIRE(counter.counts[NodeType::CallNode] == 1);
+  // i < x, i + 1, res + f(), res < 10
+  REQUIRE(counter.counts[NodeType::BinaryNode] == 4);
+
+  NumberValue number;
+  auto *function = dynamic_cast<FunctionAST *>(p);
+  REQUIRE(number.visit(function) == 0);
+  auto *declaration = dynamic_cast<VariableExprAST *>(function->body[0]);
+  REQUIRE(declaration != nullptr);
+  REQUIRE(number.visit(declaration->value) == 0);
+  auto *ifNode = dynamic_cast<IfAST *>(function->body[2]);
+  REQUIRE(ifNode != nullptr);
+  auto *assignment = dynamic_cast<VariableExprAST *>(ifNode->ifExpr[0]);
+  REQUIRE(number.visit(assignment->value) == 10);
+}
+
+TEST_CASE("Testing compact AST conversion", "[parser]") {
+  diagnosticParserTests.clear();
+  Lexer lex(&diagnosticParserTests);
+  lex.initFromString("int testFunc(int x){ int res = 0; "
+                     "for(int i = 0; i < x; i = i + 1){ res = res + f(i, 2);}"
+                     "if (res < 10) { res = 10; } return res;}");
+  Parser parser(&lex, &factory, &diagnosticParserTests);
+  lex.gettok();
+
+  auto *p = parser.parseStatement();
+  checkParserErrors();
+  REQUIRE(p != nullptr);
+
+  using babycpp::codegen::CompactAST;
+  using babycpp::codegen::NodeRef;
+  using babycpp::codegen::NodeType;
+  CompactAST compact;
+  NodeRef root = compact.addRoot(p, &lex.symbols);
+  REQUIRE(compact.roots.size() == 1);
+  REQUIRE(CompactAST::kindOf(root) == NodeType::FunctionNode);
+
+  // same amount of nodes of the pointer based tree
+  NodeCounter counter;
+  counter.visit(p);
+  int total = 0;
+  for (int count : counter.counts) {
+    total += count;
+  }
+  REQUIRE(compact.getNodeCount() == static_cast<uint32_t>(total));
+  REQUIRE(compact.binaries.size() == 4);
+  REQUIRE(compact.fors.size() == 1);
+  REQUIRE(compact.ifs.size() == 1);
+
+  const auto &function = compact.functions[CompactAST::indexOf(root)];
+  const auto &proto =
+      compact.prototypes[CompactAST::indexOf(function.proto)];
+  REQUIRE(lex.symbols.getName(proto.name) == "testFunc");
+  auto args = compact.getArguments(proto.args);
+  REQUIRE(args.size() == 1);
+  REQUIRE(lex.symbols.getName(args[0].name) == "x");
+
+  auto body = compact.getChildren(function.body);
+  REQUIRE(body.size() == 4);
+  REQUIRE(CompactAST::kindOf(body[0]) == NodeType::VariableNode);
+  REQUIRE(CompactAST::kindOf(body[1]) == NodeType::ForNode);
+  REQUIRE(CompactAST::kindOf(body[2]) == NodeType::IfNode);
+
+  const auto &forNode = compact.fors[CompactAST::indexOf(body[1])];
+  const auto &condition =
+      compact.binaries[CompactAST::indexOf(forNode.condition)];
+  REQUIRE(condition.op == babycpp::parser::OP_LESS);
+  auto forBody = compact.getChildren(forNode.body);
+  REQUIRE(forBody.size() == 1);
+  const auto &assignment =
+      compact.variables[CompactAST::indexOf(forBody[0])];
+  const auto &sum = compact.binaries[CompactAST::indexOf(assignment.value)];
+  REQUIRE(CompactAST::kindOf(sum.rhs) == NodeType::CallNode);
+  const auto &call = compact.calls[CompactAST::indexOf(sum.rhs)];
+  REQUIRE(lex.symbols.getName(call.callee) == "f");
+  REQUIRE(call.args.count == 2);
+
+  // serialization roundtrip
+  std::vector<uint8_t> buffer;
+  compact.serialize(&buffer);
+  CompactAST loaded;
+  REQUIRE(loaded.deserialize(buffer.data(), buffer.size()));
+  REQUIRE(loaded.getNodeCount() == compact.getNodeCount());
+  REQUIRE(loaded.children == compact.children);
+  REQUIRE(loaded.roots == compact.roots);
+  std::vector<uint8_t> second;
+  loaded.serialize(&second);
+  REQUIRE(second == buffer);
+
+  // truncated data is rejected
+  REQUIRE_FALSE(loaded.deserialize(buffer.data(), buffer.size() - 1));
+  REQUIRE(loaded.getNodeCount() == 0);
+
+  // so is data that does not describe a valid tree
+  auto rejects = [&](const CompactAST &corrupted) {
+    std::vector<uint8_t> data;
+    corrupted.serialize(&data);
+    CompactAST target;
+    return !target.deserialize(data.data(), data.size()) &&
+           target.getNodeCount() == 0;
+  };
+  CompactAST corrupted = compact;
+  corrupted.roots[0] = CompactAST::makeRef(NodeType::FunctionNode, 1);
+  REQUIRE(rejects(corrupted));
+  corrupted = compact;
+  corrupted.roots[0] = CompactAST::makeRef(static_cast<NodeType>(15), 0);
+  REQUIRE(rejects(corrupted));
+  corrupted = compact;
+  corrupted.functions[0].body.count = 1000;
+  REQUIRE(rejects(corrupted));
+  corrupted = compact;
+  corrupted.functions[0].proto = body[0];
+  REQUIRE(rejects(corrupted));
+  corrupted = compact;
+  corrupted.prototypes[0].args.first = 0xFFFFFFFF;
+  REQUIRE(rejects(corrupted));
+  // a node being its own operand would make any walk loop forever
+  corrupted = compact;
+  corrupted.binaries[0].lhs = CompactAST::makeRef(NodeType::BinaryNode, 0);
+  REQUIRE(rejects(corrupted));
+  std::vector<uint8_t> trailing = buffer;
+  trailing.push_back(0);
+  REQUIRE_FALSE(loaded.deserialize(trailing.data(), trailing.size()));
+}
+
+TEST_CASE("Testing hash consing of pure expressions", "[parser]") {
+  diagnosticParserTests.clear();
+  babycpp::memory::FactoryAST consFactory;
+  consFactory.hashConsing = true;
+  Lexer lex(&diagnosticParserTests);
+  lex.initFromString("float testFunc(float x, float y){ "
+                     "float a = x*x + y*y; float b = x*x + y*y + f(x); "
+                     "a = x*x + y*y; return x*x + y*y;}");
+  Parser parser(&lex, &consFactory, &diagnosticParserTests);
+  lex.gettok();
+
+  auto *p = parser.parseStatement();
+  checkParserErrors();
+  REQUIRE(p != nullptr);
+  auto *function = dynamic_cast<FunctionAST *>(p);
+  REQUIRE(function != nullptr);
+  REQUIRE(function->body.size() == 4);
+
+  auto *a = dynamic_cast<VariableExprAST *>(function->body[0]);
+  auto *b = dynamic_cast<VariableExprAST *>(function->body[1]);
+  auto *assignment = dynamic_cast<VariableExprAST *>(function->body[2]);
+  REQUIRE(a != nullptr);
+  REQUIRE(b != nullptr);
+  REQUIRE(assignment != nullptr);
+  // same expression, same node
+  ExprAST *sumOfSquares = a->value;
+  REQUIRE(assignment->value == sumOfSquares);
+  REQUIRE(consFactory.isConsed(sumOfSquares));
+  auto *bin = dynamic_cast<BinaryExprAST *>(sumOfSquares);
+  REQUIRE(bin != nullptr);
+  REQUIRE(bin->lhs != bin->rhs);
+  auto *xx = dynamic_cast<BinaryExprAST *>(bin->lhs);
+  REQUIRE(xx->lhs == xx->rhs);
+
+  // a call is not pure, the sum containing it gets its own node
+  auto *withCall = dynamic_cast<BinaryExprAST *>(b->value);
+  REQUIRE(withCall != nullptr);
+  REQUIRE(withCall->lhs == sumOfSquares);
+  REQUIRE_FALSE(consFactory.isConsed(withCall));
+
+  // the assigned variable and the returned node are private copies
+  REQUIRE_FALSE(consFactory.isConsed(assignment));
+  ExprAST *ret = function->body[3];
+  REQUIRE(ret->flags.isReturn);
+  REQUIRE(ret != sumOfSquares);
+  REQUIRE_FALSE(sumOfSquares->flags.isReturn);
+  REQUIRE(dynamic_cast<BinaryExprAST *>(ret)->lhs == bin->lhs);
+  REQUIRE(consFactory.stats.consHits != 0);
+
+  // the same source without consing allocates more nodes
+  babycpp::memory::FactoryAST plainFactory;
+  lex.initFromString("float testFunc(float x, float y){ "
+                     "float a = x*x + y*y; float b = x*x + y*y + f(x); "
+                     "a = x*x + y*y; return x*x + y*y;}");
+  Parser plainParser(&lex, &plainFactory, &diagnosticParserTests);
+  lex.gettok();
+  REQUIRE(plainParser.parseStatement() != nullptr);
+  REQUIRE(plainFactory.stats.consHits == 0);
+  REQUIRE(plainFactory.allocator.getStats().bytesRequested >
+          consFactory.allocator.getStats().bytesRequested);
+}
+
+TEST_CASE("Testing split of top level statements", "[parser]") {
+  const std::string source{"extern float sin(float x);\n"
+                           "int a(int x){ if(x < 1){ return 1;} return x;}\n"
+                           "int b(int x){ return a(x) * 2;}\n"
+                           "int c(int x){ return b(x) + a(x);}\n"};
+  using babycpp::parser::SourceRange;
+  std::vector<SourceRange> ranges =
+      babycpp::parser::splitTopLevelStatements(source, 3);
+  REQUIRE(ranges.size() == 3);
+  REQUIRE(ranges.front().begin == 0);
+  REQUIRE(ranges.back().end == source.size());
+  bool contiguous = true;
+  for (size_t i = 1; i < ranges.size(); ++i) {
+    contiguous &= ranges[i].begin == ranges[i - 1].end;
+    // every cut is right after a top level ; or }
+    const char last = source[ranges[i].begin - 1];
+    contiguous &= last == ';' || last == '}';
+  }
+  REQUIRE(contiguous);
+  REQUIRE(ranges[0].line == 1);
+  REQUIRE(ranges[1].line > 1);
+
+  // more ranges than statements
+  REQUIRE(babycpp::parser::splitTopLevelStatements(source, 64).size() == 4);
+  REQUIRE(babycpp::parser::splitTopLevelStatements("", 4).size() == 1);
+
+  // parsing the ranges concurrently, ids end up in the given table
+  diagnosticParserTests.clear();
+  Lexer lex(&diagnosticParserTests);
+  auto workers = babycpp::parser::parseInParallel(source, 3, &lex.symbols);
+  REQUIRE(workers.size() == 3);
+  std::vector<ExprAST *> statements;
+  bool clean = true;
+  for (auto &worker : workers) {
+    clean &= worker->diagnostic.hasErrors() == 0;
+    statements.insert(statements.end(), worker->statements.begin(),
+                      worker->statements.end());
+  }
+  REQUIRE(clean);
+  REQUIRE(statements.size() == 4);
+  auto *c = dynamic_cast<FunctionAST *>(statements[3]);
+  REQUIRE(c != nullptr);
+  REQUIRE(lex.symbols.getName(c->proto->nameId) == "c");
+  REQUIRE(lex.symbols.getName(c->proto->args[0].nameId) == "x");
+  auto *sum = dynamic_cast<BinaryExprAST *>(c->body[0]);
+  auto *call = dynamic_cast<CallExprAST *>(sum->lhs);
+  REQUIRE(lex.symbols.getName(call->calleeId) == "b");
+}
+
+TEST_CASE("Testing parallel parsing with hash consing", "[parser]") {
+  // ids of the target table differ from the worker ones, a node remapped
+  // twice would end up with the wrong name
+  Lexer lex(&diagnosticParserTests);
+  lex.symbols.intern("first");
+  lex.symbols.intern("second");
+  lex.symbols.intern("third");
+  // a single worker parses several functions, the shared nodes of all but
+  // the last one are no longer in the cons table when remapping
+  llvm::StringRef source = "float f1(float qq, float y){ return qq*qq + y;}\n"
+                           "float f2(float qq, float z){ return qq*qq + z;}\n"
+                           "float f3(float w){ return w*w;}";
+  auto workers = babycpp::parser::parseInParallel(source, 1, &lex.symbols,
+                                                  /*hashConsing*/ true);
+  REQUIRE(workers.size() == 1);
+  REQUIRE(workers[0]->diagnostic.hasErrors() == 0);
+  REQUIRE(workers[0]->statements.size() == 3);
+
+  const char *names[] = {"qq", "qq", "w"};
+  for (int i = 0; i < 3; ++i) {
+    auto *function = dynamic_cast<FunctionAST *>(workers[0]->statements[i]);
+    REQUIRE(function != nullptr);
+    auto *body = function->body[0];
+    auto *square = dynamic_cast<BinaryExprAST *>(
+        i == 2 ? body : dynamic_cast<BinaryExprAST *>(body)->lhs);
+    REQUIRE(square != nullptr);
+    auto *lhs = dynamic_cast<VariableExprAST *>(square->lhs);
+    auto *rhs = dynamic_cast<VariableExprAST *>(square->rhs);
+    REQUIRE(lhs != nullptr);
+    REQUIRE(rhs != nullptr);
+    REQUIRE(lex.symbols.getName(lhs->nameId) == names[i]);
+    REQUIRE(lex.symbols.getName(rhs->nameId) == names[i]);
+  }
+}
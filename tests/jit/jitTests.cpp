@@ -9,6 +9,7 @@
 #include <codegen.h>
 #include <iostream>
 #include <jit.h>
+#include <limits>
 
 inline std::string getFile(const ::std::string &path) {
 
@@ -286,6 +287,49 @@ TEST_CASE("testing proper integer comparison jit", "[jit]") {
   REQUIRE(func(5, 2) == 2);
 }
 
+TEST_CASE("testing signed integer comparison jit", "[jit]") {
+  babycpp::jit::BabycppJIT jit;
+  Codegenerator gen;
+  gen.initFromString("int testFunc(int a, int b){ return (a < b) + (a <= b) * "
+                     "2 + (a > b) * 4 + (a >= b) * 8;}");
+  auto p = gen.parser.parseFunction();
+  REQUIRE(p != nullptr);
+
+  auto v = p->codegen(&gen);
+  REQUIRE(v != nullptr);
+
+  jit.addModule(gen.module);
+  auto symbol = jit.findSymbol("testFunc");
+  auto func = (int (*)(int, int))(intptr_t)llvm::cantFail(symbol.getAddress());
+  REQUIRE(func(-1, 2) == 3);
+  REQUIRE(func(2, -1) == 12);
+  REQUIRE(func(-3, -3) == 10);
+  REQUIRE(func(-5, -2) == 3);
+}
+
+TEST_CASE("testing ordered float comparison jit", "[jit]") {
+  babycpp::jit::BabycppJIT jit;
+  Codegenerator gen;
+  gen.initFromString("int testFunc(float a, float b){ int res = (a < b) + (a "
+                     "== b) * 2 + (a != b) * 4; return res;}");
+  auto p = gen.parser.parseFunction();
+  REQUIRE(p != nullptr);
+
+  auto v = p->codegen(&gen);
+  REQUIRE(v != nullptr);
+
+  jit.addModule(gen.module);
+  auto symbol = jit.findSymbol("testFunc");
+  auto func =
+      (int (*)(float, float))(intptr_t)llvm::cantFail(symbol.getAddress());
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  REQUIRE(func(-2.0f, 1.0f) == 5);
+  REQUIRE(func(-1.5f, -1.5f) == 2);
+  // only != holds when a NaN is involved
+  REQUIRE(func(nan, 1.0f) == 4);
+  REQUIRE(func(nan, nan) == 4);
+}
+
 TEST_CASE("testing set int pointer to null jit", "[jit]") {
   babycpp::jit::BabycppJIT jit;
   Codegenerator gen;
@@ -491,3 +535,169 @@ TEST_CASE("Testing pointer indexing", "[jit]") {
     REQUIRE(func(data.data(), i) == data[i]);
   }
 }
+
+TEST_CASE("Testing lazy jit compiles only called functions", "[jit]") {
+  babycpp::jit::JITOptions options;
+  options.lazy = true;
+  babycpp::jit::BabycppJIT jit(options);
+  Codegenerator gen;
+  std::string source;
+  for (int i = 0; i < 50; ++i) {
+    source += "float func" + std::to_string(i) + "(float x){ return x + " +
+              std::to_string(i) + ".0;}\n";
+  }
+  source += "float caller(float x){ return func3(x) * 2.0;}\n";
+  gen.initFromString(source);
+  gen.generateModuleContent();
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+
+  auto handle = jit.addModule(gen.module);
+  REQUIRE(handle != nullptr);
+  // nothing is compiled until a stub gets called
+  REQUIRE(jit.compiledFunctions == 0);
+
+  auto symbol = jit.findSymbol("caller");
+  auto func = (float (*)(float))(intptr_t)llvm::cantFail(symbol.getAddress());
+  REQUIRE(func != nullptr);
+  REQUIRE(func(1.0f) == Approx(8.0f));
+  // caller and the function it calls
+  REQUIRE(jit.compiledFunctions == 2);
+  // second call goes straight to the compiled code
+  REQUIRE(func(2.0f) == Approx(10.0f));
+  REQUIRE(jit.compiledFunctions == 2);
+
+  symbol = jit.findSymbol("func10");
+  auto other = (float (*)(float))(intptr_t)llvm::cantFail(symbol.getAddress());
+  REQUIRE(other(1.0f) == Approx(11.0f));
+  REQUIRE(jit.compiledFunctions == 3);
+  jit.removeModule(handle);
+}
+
+TEST_CASE("Testing optimized lazy jit", "[jit]") {
+  babycpp::jit::JITOptions options;
+  options.lazy = true;
+  options.level = babycpp::codegen::OptLevel::O2;
+  babycpp::jit::BabycppJIT jit(options);
+  Codegenerator gen;
+  gen.initFromString(" int testFunc(int a){"
+                     "int x = 0; "
+                     "for ( int i = 1; i < a+1 ; i= i+1){ "
+                     "x = x + i;}"
+                     " return x;}");
+  gen.generateModuleContent();
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+
+  jit.addModule(gen.module);
+  auto symbol = jit.findSymbol("testFunc");
+  auto func = (int (*)(int))(intptr_t)llvm::cantFail(symbol.getAddress());
+  auto sumN = [](int x) { return (x * (x + 1)) / 2; };
+  for (int i = 0; i < 30; ++i) {
+    REQUIRE(func(i) == sumN(i));
+  }
+  REQUIRE(jit.optimizer.stats.modulesOptimized > 0);
+}
+
+TEST_CASE("Testing jit with compile threads", "[jit]") {
+  babycpp::jit::JITOptions options;
+  options.compileThreads = 4;
+  options.level = babycpp::codegen::OptLevel::O2;
+  babycpp::jit::BabycppJIT jit(options);
+
+  const int moduleCount = 8;
+  std::vector<std::unique_ptr<Codegenerator>> gens;
+  std::vector<std::shared_ptr<llvm::Module>> modules;
+  for (int i = 0; i < moduleCount; ++i) {
+    gens.emplace_back(new Codegenerator);
+    const std::string id = std::to_string(i);
+    gens.back()->initFromString("int sum" + id +
+                                "(int a){ int x = " + id +
+                                "; for ( int i = 1; i < a+1 ; i= i+1){ "
+                                "x = x + i;} return x;}");
+    gens.back()->generateModuleContent();
+    REQUIRE(gens.back()->diagnostic.hasErrors() == 0);
+    modules.push_back(gens.back()->module);
+  }
+
+  auto handles = jit.addModules(modules);
+  REQUIRE(handles.size() == moduleCount);
+  // all compiled by the time addModules returns
+  REQUIRE(jit.compiledFunctions == moduleCount);
+  REQUIRE(jit.optimizer.stats.modulesOptimized == moduleCount);
+  for (int i = 0; i < moduleCount; ++i) {
+    REQUIRE(handles[i] != nullptr);
+    auto symbol = jit.findSymbol("sum" + std::to_string(i));
+    auto func = (int (*)(int))(intptr_t)llvm::cantFail(symbol.getAddress());
+    REQUIRE(func(10) == 55 + i);
+  }
+
+  // a new version of a module goes in once the old one is removed
+  jit.removeModule(handles[0]);
+  Codegenerator replacement;
+  replacement.initFromString("int sum0(int a){ return a * 2;}");
+  replacement.generateModuleContent();
+  REQUIRE(replacement.diagnostic.hasErrors() == 0);
+  handles[0] = jit.addModule(replacement.module);
+  REQUIRE(handles[0] != nullptr);
+  auto symbol = jit.findSymbol("sum0");
+  auto func = (int (*)(int))(intptr_t)llvm::cantFail(symbol.getAddress());
+  REQUIRE(func(4) == 8);
+
+  jit.removeModule(handles[1]);
+  REQUIRE(llvm::cantFail(jit.findSymbol("sum1").getAddress()) == 0);
+}
+
+TEST_CASE("Testing tiered jit", "[jit]") {
+  babycpp::jit::JITOptions options;
+  options.tiered = true;
+  options.hotThreshold = 10;
+  babycpp::jit::BabycppJIT jit(options);
+
+  Codegenerator gen;
+  gen.initFromString("int square(int a){ return a*a;}"
+                     "int sumSquares(int n){ int x = 0; "
+                     "for ( int i = 1; i < n+1 ; i= i+1){ "
+                     "x = x + square(i);} return x;}");
+  gen.generateModuleContent();
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+  auto handle = jit.addModule(gen.module);
+  REQUIRE(handle != nullptr);
+  REQUIRE(jit.hotFunctions == 0);
+
+  auto symbol = jit.findSymbol("sumSquares");
+  auto func = (int (*)(int))(intptr_t)llvm::cantFail(symbol.getAddress());
+  REQUIRE(func(3) == 14);
+  jit.waitForTiering();
+  REQUIRE(jit.hotFunctions == 0);
+
+  // square crosses the threshold, sumSquares does not
+  REQUIRE(func(20) == 2870);
+  jit.waitForTiering();
+  REQUIRE(jit.hotFunctions == 1);
+  REQUIRE(jit.optimizer.stats.modulesOptimized == 1);
+
+  // the pointer taken before the swap is the stub, it keeps working
+  REQUIRE(func(20) == 2870);
+  auto square = (int (*)(int))(intptr_t)llvm::cantFail(
+      jit.findSymbol("square").getAddress());
+  REQUIRE(square(7) == 49);
+
+  jit.removeModule(handle);
+  REQUIRE(llvm::cantFail(jit.findSymbol("sumSquares").getAddress()) == 0);
+}
+
+TEST_CASE("Testing tiered jit with unresolved symbols", "[jit]") {
+  babycpp::jit::JITOptions options;
+  options.tiered = true;
+  babycpp::jit::BabycppJIT jit(options);
+
+  Codegenerator gen;
+  gen.initFromString("extern float notDefinedAnywhere(float x);"
+                     "float caller(float x){ return notDefinedAnywhere(x);}");
+  gen.generateModuleContent();
+  REQUIRE(gen.diagnostic.hasErrors() == 0);
+  // the baseline can't be linked, the stub must not be handed out
+  auto handle = jit.addModule(gen.module);
+  REQUIRE(handle == nullptr);
+  REQUIRE(llvm::cantFail(jit.findSymbol("caller").getAddress()) == 0);
+  jit.waitForTiering();
+}
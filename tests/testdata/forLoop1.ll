@@ -9,8 +9,10 @@ entry:
   store i32 0, i32* %i
   %i2 = load i32, i32* %i
   %a3 = load i32, i32* %a1
-  %cmptmp = icmp ult i32 %i2, %a3
-  br i1 %cmptmp, label %loop, label %afterloop
+  %cmptmp = icmp slt i32 %i2, %a3
+  %booltmp = zext i1 %cmptmp to i32
+  %tobool = icmp ne i32 %booltmp, 0
+  br i1 %tobool, label %loop, label %afterloop
 
 loop:                                             ; preds = %loop, %entry
   %x4 = load i32, i32* %x
@@ -22,10 +24,12 @@ loop:                                             ; preds = %loop, %entry
   store i32 %addtmp7, i32* %i
   %i8 = load i32, i32* %i
   %a9 = load i32, i32* %a1
-  %cmptmp10 = icmp ult i32 %i8, %a9
-  br i1 %cmptmp10, label %loop, label %afterloop
+  %cmptmp10 = icmp slt i32 %i8, %a9
+  %booltmp11 = zext i1 %cmptmp10 to i32
+  %tobool12 = icmp ne i32 %booltmp11, 0
+  br i1 %tobool12, label %loop, label %afterloop
 
 afterloop:                                        ; preds = %loop, %entry
-  %x11 = load i32, i32* %x
-  ret i32 %x11
+  %x13 = load i32, i32* %x
+  ret i32 %x13
 }
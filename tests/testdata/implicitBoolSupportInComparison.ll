@@ -9,8 +9,9 @@ entry:
   store i32 0, i32* %res
   %a3 = load i32, i32* %a1
   %b4 = load i32, i32* %b2
-  %cmptmp = icmp ult i32 %a3, %b4
-  %ifcond = icmp ne i1 %cmptmp, false
+  %cmptmp = icmp slt i32 %a3, %b4
+  %booltmp = zext i1 %cmptmp to i32
+  %ifcond = icmp ne i32 %booltmp, 0
   br i1 %ifcond, label %then, label %else
 
 then:                                             ; preds = %entry